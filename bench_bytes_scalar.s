@@ -0,0 +1,51 @@
+; Packed-byte kernel benchmark, scalar version (run with z16_sim -q).
+; Same computation as bench_bytes_packed.s, one 8-bit lane at a time in
+; separate registers; it prints the same checksum.
+.org 0x0000
+.text
+start:
+    li   t0, 127            ; t0 = 255, the lane mask and saturation limit
+    addi t0, 127
+    addi t0, 1
+    li   s0, 0              ; s0, s1 = x, low and high lane
+    li   s1, 0
+    li   a0, 0              ; a0, a1 = checksum, low and high lane
+    li   a1, 0
+    li   t1, 125            ; sp = -1000, counts up to 0
+    li   sp, 3
+    sll  t1, sp
+    li   sp, 0
+    sub  sp, t1
+    li   ra, 24             ; loop - 2: jalr lands one instruction past its target
+loop:
+    addi s0, 37             ; next low sample
+    and  s0, t0
+    li   t1, 0
+    add  t1, s0
+    addi t1, 90             ; mix with saturation
+    bgeu t0, t1, low_ok
+    li   t1, 0
+    add  t1, t0
+low_ok:
+    add  a0, t1             ; checksum
+    and  a0, t0
+    addi s1, 41             ; same for the high lane
+    and  s1, t0
+    li   t1, 0
+    add  t1, s1
+    addi t1, 100
+    bgeu t0, t1, high_ok
+    li   t1, 0
+    add  t1, t0
+high_ok:
+    add  a1, t1
+    and  a1, t0
+    addi sp, 1
+    bz   sp, done
+    jalr ra, t1             ; back to loop (the link in t1 is not used)
+done:
+    li   t1, 8              ; checksum, high lane * 256 + low lane
+    sll  a1, t1
+    add  a0, a1
+    ecall 1
+    ecall 3
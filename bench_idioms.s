@@ -0,0 +1,44 @@
+; Copy and fill loop benchmark (run with z16_sim -q, with and without
+; --idioms). Each of 100 passes fills 8 KB at 0x4000 with the pass number
+; and copies it to 0x8000, one byte per iteration; --idioms replaces both
+; loops. The checksum adds the last byte loaded and the last byte stored in
+; every pass and prints 9900 either way.
+.org 0x0000
+.text
+start:
+    li   s1, 0              ; s1 = pass
+    li   sp, 0              ; sp = checksum
+pass:
+    li   a0, 64
+    slli a0, 8              ; a0 = 0x4000
+    li   s0, 32
+    slli s0, 8
+    add  s0, a0             ; s0 = 0x6000, end of the source
+fill:
+    sb   s1, 0(a0)
+    addi a0, 1
+    bne  a0, s0, fill
+    li   a1, 64
+    slli a1, 8              ; a1 = 0x4000
+    li   a0, 64
+    slli a0, 9              ; a0 = 0x8000
+copy:
+    lbu  t1, 0(a1)
+    sb   t1, 0(a0)
+    addi a1, 1
+    addi a0, 1
+    bne  a1, s0, copy
+    add  sp, t1             ; last byte loaded
+    li   t0, 1
+    sub  a0, t0
+    lbu  t0, 0(a0)          ; last byte stored
+    add  sp, t0
+    addi s1, 1
+    li   t0, 100
+    beq  s1, t0, done
+    j    pass
+done:
+    li   a0, 0
+    add  a0, sp
+    ecall 1                 ; print the checksum
+    ecall 3
@@ -0,0 +1,113 @@
+; Runtime library exercise (run with z16_sim -q; add --callgraph or --timing
+; to measure the routines). Calls each routine of z16rt.s once and prints
+; 59836, 7142, 6, 5432, 1, then the strings "54321" and "-12345", 32, 0 and
+; the copied and filled strings.
+.include "z16rt.inc"
+.org 0x0000
+.text
+start:
+    li   a0, 9                  ; 1234 * 5678 = 7006652 -> 59836 (low 16 bits)
+    slli a0, 7
+    addi a0, 82
+    li   a1, 44
+    slli a1, 7
+    addi a1, 46
+    call rt_mul
+    ecall SYS_PRINT_INT
+    li   a0, 97                 ; 50000 / 7 = 7142 r 6
+    slli a0, 7
+    addi a0, 84
+    slli a0, 2
+    li   a1, 7
+    call rt_divu
+    ecall SYS_PRINT_INT
+    li   a0, 0
+    add  a0, a1
+    ecall SYS_PRINT_INT
+    li   a0, 106                ; 54321 / 10 = 5432 r 1
+    slli a0, 7
+    addi a0, 12
+    slli a0, 2
+    addi a0, 1
+    call rt_divu10
+    ecall SYS_PRINT_INT
+    li   a0, 0
+    add  a0, a1
+    ecall SYS_PRINT_INT
+    li   a0, 106                ; "54321"
+    slli a0, 7
+    addi a0, 12
+    slli a0, 2
+    addi a0, 1
+    li   a1, %hi(number)
+    slli a1, 7
+    addi a1, %lo(number)
+    call rt_utoa
+    li   a0, %hi(number)
+    slli a0, 7
+    addi a0, %lo(number)
+    ecall SYS_PRINT_STRING
+    li   a1, 0                  ; "-12345": 0 - 12345
+    li   a0, 96
+    slli a0, 7
+    addi a0, 57
+    sub  a1, a0
+    li   a0, 0
+    add  a0, a1
+    li   a1, %hi(number)
+    slli a1, 7
+    addi a1, %lo(number)
+    call rt_itoa
+    li   a0, %hi(number)
+    slli a0, 7
+    addi a0, %lo(number)
+    ecall SYS_PRINT_STRING
+    li   a0, %hi(text)          ; strlen(text) = 32
+    slli a0, 7
+    addi a0, %lo(text)
+    call rt_strlen
+    ecall SYS_PRINT_INT
+    li   a0, %hi(copy)          ; copy text with its NUL, then compare: 0
+    slli a0, 7
+    addi a0, %lo(copy)
+    li   a1, %hi(text)
+    slli a1, 7
+    addi a1, %lo(text)
+    li   t1, 33
+    call rt_memcpy
+    li   a0, %hi(copy)
+    slli a0, 7
+    addi a0, %lo(copy)
+    li   a1, %hi(text)
+    slli a1, 7
+    addi a1, %lo(text)
+    call rt_strcmp
+    ecall SYS_PRINT_INT
+    li   a0, %hi(copy)
+    slli a0, 7
+    addi a0, %lo(copy)
+    ecall SYS_PRINT_STRING
+    li   a0, %hi(copy)          ; overwrite the first 20 bytes with '*'
+    slli a0, 7
+    addi a0, %lo(copy)
+    li   a1, 42
+    li   t1, 20
+    call rt_memset
+    li   a0, %hi(copy)
+    slli a0, 7
+    addi a0, %lo(copy)
+    ecall SYS_PRINT_STRING
+    ecall SYS_EXIT
+.include "z16rt.s"
+
+.data
+.org 0x3000
+number:
+    .space 8
+text:
+    ; "the quick brown fox jumps over a"
+    .byte 116, 104, 101, 32, 113, 117, 105, 99, 107, 32, 98
+    .byte 114, 111, 119, 110, 32, 102, 111, 120, 32, 106, 117
+    .byte 109, 112, 115, 32, 111, 118, 101, 114, 32, 97, 0
+copy:
+    .space 40
@@ -0,0 +1,563 @@
+/*
+ * Accelerator ecall (see z16accel.h for the guest's view).
+ *
+ * Spec syntax (comma separated, any order):
+ *   mode=<m>              native (default), reference, or check: run both on
+ *                         separate copies of the machine, keep the native
+ *                         result and report where they disagree
+ *   <kernel>=<base>:<w>   cost of one kernel, e.g. crc32=8:8
+ *
+ * The CRCs use the CPU's CRC instructions where it has them for the
+ * polynomial (ARMv8 for both, SSE4.2 for Castagnoli only) and slicing-by-8
+ * tables otherwise. Guest ranges may wrap past 0xFFFF; kernels that want
+ * contiguous bytes gather such ranges into the shared staging buffer first
+ * (z16range.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_ARM_CRC 1
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define HAVE_SSE42_CRC 1
+#endif
+
+#include "z16sim.h"
+#include "z16accel.h"
+#include "z16range.h"
+#include "z16spec.h"
+
+#define MODE_NATIVE    0
+#define MODE_REFERENCE 1
+#define MODE_CHECK     2
+
+#define CRC32_POLY  0xEDB88320u     // reflected IEEE 802.3
+#define CRC32C_POLY 0x82F63B78u     // reflected Castagnoli
+#define CRC16_POLY  0x1021u         // CCITT, MSB first
+
+typedef struct {
+    uint64_t calls;
+    uint64_t units;
+    uint64_t charged;
+    uint64_t mismatches;
+} AccelStats;
+
+static AccelKernel kernels[ACCEL_MAX_KERNELS];
+static AccelStats stats[ACCEL_MAX_KERNELS];
+static int mode = MODE_NATIVE;
+static int reportEnabled = 0;
+
+// -----------------------
+// Guest memory helpers
+// -----------------------
+
+static void observeRange(AccelMachine *m, uint16_t addr, uint32_t n, int isWrite) {
+    if (m->observe)
+        rangeObserve(m->observe, addr, n, isWrite);
+}
+
+static inline uint16_t loadWord(AccelMachine *m, uint16_t addr) {
+    return (uint16_t)(m->mem[addr] | m->mem[(uint16_t)(addr + 1)] << 8);
+}
+
+static inline void storeWord(AccelMachine *m, uint16_t addr, uint16_t value) {
+    m->mem[addr] = (uint8_t)value;
+    m->mem[(uint16_t)(addr + 1)] = (uint8_t)(value >> 8);
+}
+
+static uint32_t loadCrcState(AccelMachine *m, uint16_t addr) {
+    return loadWord(m, addr) | (uint32_t)loadWord(m, (uint16_t)(addr + 2)) << 16;
+}
+
+static void storeCrcState(AccelMachine *m, uint16_t addr, uint32_t crc) {
+    storeWord(m, addr, (uint16_t)crc);
+    storeWord(m, (uint16_t)(addr + 2), (uint16_t)(crc >> 16));
+    m->regs[REG_A0] = (uint16_t)crc;
+    m->regs[REG_A1] = (uint16_t)(crc >> 16);
+}
+
+// Element count of a word array, at most the whole of memory
+static inline uint32_t wordCount(AccelMachine *m) {
+    uint32_t n = m->regs[REG_T1];
+    return n < MEM_SIZE / 2 ? n : MEM_SIZE / 2;
+}
+
+// ceil(log2(n + 1)): probes of a binary search over n elements
+static inline uint32_t probes(uint32_t n) {
+    uint32_t bits = 0;
+    while (n) {
+        bits++;
+        n >>= 1;
+    }
+    return bits;
+}
+
+// -----------------------
+// CRC tables and instructions
+// -----------------------
+
+static uint32_t crcTable[2][8][256];     // [IEEE, Castagnoli], slicing-by-8
+static uint16_t crc16Table[256];
+static int tablesReady = 0;
+
+static void buildTables(void) {
+    const uint32_t polys[2] = {CRC32_POLY, CRC32C_POLY};
+    for (int p = 0; p < 2; p++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? (c >> 1) ^ polys[p] : c >> 1;
+            crcTable[p][0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+            for (int s = 1; s < 8; s++)
+                crcTable[p][s][i] = (crcTable[p][s - 1][i] >> 8) ^ crcTable[p][0][crcTable[p][s - 1][i] & 0xFF];
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t c = (uint16_t)(i << 8);
+        for (int k = 0; k < 8; k++)
+            c = c & 0x8000 ? (uint16_t)((c << 1) ^ CRC16_POLY) : (uint16_t)(c << 1);
+        crc16Table[i] = c;
+    }
+    tablesReady = 1;
+}
+
+// Raw (uninverted) CRC update over a host buffer
+static uint32_t crcSliced(int castagnoli, uint32_t crc, const unsigned char *p, uint32_t n) {
+    const uint32_t (*t)[256] = crcTable[castagnoli];
+    while (n >= 8) {
+        uint32_t lo = crc ^ (uint32_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)(p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        n -= 8;
+    }
+    while (n--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#if defined(HAVE_ARM_CRC)
+static uint32_t crcHardware(int castagnoli, uint32_t crc, const unsigned char *p, uint32_t n) {
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = castagnoli ? __crc32cd(crc, v) : __crc32d(crc, v);
+    }
+    for (; n > 0; p++, n--)
+        crc = castagnoli ? __crc32cb(crc, *p) : __crc32b(crc, *p);
+    return crc;
+}
+#elif defined(HAVE_SSE42_CRC)
+__attribute__((target("sse4.2")))
+static uint32_t crcCastagnoliSse42(uint32_t crc, const unsigned char *p, uint32_t n) {
+    uint64_t c = crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    for (; n > 0; p++, n--)
+        c = _mm_crc32_u8((uint32_t)c, *p);
+    return (uint32_t)c;
+}
+#endif
+
+static uint32_t crcUpdate(int castagnoli, uint32_t crc, const unsigned char *p, uint32_t n) {
+#if defined(HAVE_ARM_CRC)
+    return crcHardware(castagnoli, crc, p, n);
+#elif defined(HAVE_SSE42_CRC)
+    static int sse42 = -1;
+    if (sse42 < 0)
+        sse42 = __builtin_cpu_supports("sse4.2") != 0;
+    if (castagnoli && sse42)
+        return crcCastagnoliSse42(crc, p, n);
+#endif
+    return crcSliced(castagnoli, crc, p, n);
+}
+
+// -----------------------
+// Native kernels
+// -----------------------
+
+static uint64_t crc32Native(AccelMachine *m, int castagnoli) {
+    uint16_t addr = m->regs[REG_A0], state = m->regs[REG_A1];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, state, 4, 0);
+    observeRange(m, addr, n, 0);
+    observeRange(m, state, 4, 1);
+    uint32_t crc = ~loadCrcState(m, state);
+    crc = ~crcUpdate(castagnoli, crc, rangeGather(m->mem, addr, n), n);
+    storeCrcState(m, state, crc);
+    return n;
+}
+
+static uint64_t crc32IeeeNative(AccelMachine *m) { return crc32Native(m, 0); }
+static uint64_t crc32cNative(AccelMachine *m) { return crc32Native(m, 1); }
+
+static uint64_t crc16Native(AccelMachine *m) {
+    uint16_t addr = m->regs[REG_A0], crc = m->regs[REG_A1];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, addr, n, 0);
+    const unsigned char *p = rangeGather(m->mem, addr, n);
+    for (uint32_t i = 0; i < n; i++)
+        crc = (uint16_t)(crc << 8) ^ crc16Table[(crc >> 8) ^ p[i]];
+    m->regs[REG_A0] = crc;
+    return n;
+}
+
+static uint64_t inetSumNative(AccelMachine *m) {
+    uint16_t addr = m->regs[REG_A0];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, addr, n, 0);
+    const unsigned char *p = rangeGather(m->mem, addr, n);
+    // 32-bit words summed into 64 bits fold to the same ones' complement sum
+    uint64_t sum = m->regs[REG_A1];
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        sum += (uint32_t)p[i] << 24 | (uint32_t)p[i + 1] << 16 | (uint32_t)p[i + 2] << 8 | p[i + 3];
+    for (; i + 2 <= n; i += 2)
+        sum += (uint32_t)p[i] << 8 | p[i + 1];
+    if (i < n)
+        sum += (uint32_t)p[i] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    m->regs[REG_A0] = (uint16_t)sum;
+    return n;
+}
+
+// Two-pass LSD radix sort; signed keys sort with their sign bit flipped.
+static uint64_t sortNative(AccelMachine *m, int isSigned) {
+    static uint16_t keys[MEM_SIZE / 2], tmp[MEM_SIZE / 2];
+    uint16_t addr = m->regs[REG_A0];
+    uint32_t n = wordCount(m);
+    observeRange(m, addr, 2 * n, 0);
+    observeRange(m, addr, 2 * n, 1);
+    uint16_t flip = isSigned ? 0x8000 : 0;
+    const unsigned char *p = rangeGather(m->mem, addr, 2 * n);
+    for (uint32_t i = 0; i < n; i++)
+        keys[i] = (uint16_t)((p[2 * i] | p[2 * i + 1] << 8) ^ flip);
+    for (int shift = 0; shift < 16; shift += 8) {
+        uint32_t count[257] = {0};
+        const uint16_t *from = shift ? tmp : keys;
+        uint16_t *to = shift ? keys : tmp;
+        for (uint32_t i = 0; i < n; i++)
+            count[((from[i] >> shift) & 0xFF) + 1]++;
+        for (int d = 0; d < 256; d++)
+            count[d + 1] += count[d];
+        for (uint32_t i = 0; i < n; i++)
+            to[count[(from[i] >> shift) & 0xFF]++] = from[i];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint16_t v = keys[i] ^ flip;
+        rangeStaging[2 * i] = (uint8_t)v;
+        rangeStaging[2 * i + 1] = (uint8_t)(v >> 8);
+    }
+    rangeWrite(m->mem, addr, rangeStaging, 2 * n);
+    return (uint64_t)n * probes(n);
+}
+
+static uint64_t sortU16Native(AccelMachine *m) { return sortNative(m, 0); }
+static uint64_t sortS16Native(AccelMachine *m) { return sortNative(m, 1); }
+
+// Lower bound, so duplicates answer with their first index
+static uint64_t searchNative(AccelMachine *m, int isSigned) {
+    uint16_t addr = m->regs[REG_A0];
+    uint32_t n = wordCount(m);
+    uint16_t flip = isSigned ? 0x8000 : 0;
+    uint16_t key = m->regs[REG_A1] ^ flip;
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint16_t at = (uint16_t)(addr + 2 * mid);
+        observeRange(m, at, 2, 0);
+        if ((uint16_t)(loadWord(m, at) ^ flip) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    uint16_t found = 0xFFFF;
+    if (lo < n) {
+        uint16_t at = (uint16_t)(addr + 2 * lo);
+        observeRange(m, at, 2, 0);
+        if ((uint16_t)(loadWord(m, at) ^ flip) == key)
+            found = (uint16_t)lo;
+    }
+    m->regs[REG_A0] = found;
+    return probes(n);
+}
+
+static uint64_t searchU16Native(AccelMachine *m) { return searchNative(m, 0); }
+static uint64_t searchS16Native(AccelMachine *m) { return searchNative(m, 1); }
+
+// -----------------------
+// Reference kernels
+// -----------------------
+// One byte or element at a time through guest addresses, the way a Z16
+// routine would do it; kept obvious rather than fast.
+
+static uint64_t crc32Reference(AccelMachine *m, uint32_t poly) {
+    uint16_t addr = m->regs[REG_A0], state = m->regs[REG_A1];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, state, 4, 0);
+    observeRange(m, addr, n, 0);
+    observeRange(m, state, 4, 1);
+    uint32_t crc = ~loadCrcState(m, state);
+    for (uint32_t i = 0; i < n; i++) {
+        crc ^= m->mem[(uint16_t)(addr + i)];
+        for (int k = 0; k < 8; k++)
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+    }
+    storeCrcState(m, state, ~crc);
+    return n;
+}
+
+static uint64_t crc32IeeeReference(AccelMachine *m) { return crc32Reference(m, CRC32_POLY); }
+static uint64_t crc32cReference(AccelMachine *m) { return crc32Reference(m, CRC32C_POLY); }
+
+static uint64_t crc16Reference(AccelMachine *m) {
+    uint16_t addr = m->regs[REG_A0], crc = m->regs[REG_A1];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, addr, n, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        crc ^= (uint16_t)(m->mem[(uint16_t)(addr + i)] << 8);
+        for (int k = 0; k < 8; k++)
+            crc = crc & 0x8000 ? (uint16_t)((crc << 1) ^ CRC16_POLY) : (uint16_t)(crc << 1);
+    }
+    m->regs[REG_A0] = crc;
+    return n;
+}
+
+static uint64_t inetSumReference(AccelMachine *m) {
+    uint16_t addr = m->regs[REG_A0];
+    uint32_t n = m->regs[REG_T1];
+    observeRange(m, addr, n, 0);
+    uint32_t sum = m->regs[REG_A1];
+    for (uint32_t i = 0; i < n; i += 2) {
+        uint16_t word = (uint16_t)(m->mem[(uint16_t)(addr + i)] << 8);
+        if (i + 1 < n)
+            word |= m->mem[(uint16_t)(addr + i + 1)];
+        sum += word;
+        if (sum > 0xFFFF)           // end-around carry
+            sum = (sum & 0xFFFF) + 1;
+    }
+    m->regs[REG_A0] = (uint16_t)sum;
+    return n;
+}
+
+static inline int lessThan(uint16_t a, uint16_t b, int isSigned) {
+    return isSigned ? (int16_t)a < (int16_t)b : a < b;
+}
+
+// Insertion sort
+static uint64_t sortReference(AccelMachine *m, int isSigned) {
+    uint16_t addr = m->regs[REG_A0];
+    uint32_t n = wordCount(m);
+    observeRange(m, addr, 2 * n, 0);
+    observeRange(m, addr, 2 * n, 1);
+    for (uint32_t i = 1; i < n; i++) {
+        uint16_t v = loadWord(m, (uint16_t)(addr + 2 * i));
+        uint32_t j = i;
+        while (j > 0 && lessThan(v, loadWord(m, (uint16_t)(addr + 2 * (j - 1))), isSigned)) {
+            storeWord(m, (uint16_t)(addr + 2 * j), loadWord(m, (uint16_t)(addr + 2 * (j - 1))));
+            j--;
+        }
+        storeWord(m, (uint16_t)(addr + 2 * j), v);
+    }
+    return (uint64_t)n * probes(n);
+}
+
+static uint64_t sortU16Reference(AccelMachine *m) { return sortReference(m, 0); }
+static uint64_t sortS16Reference(AccelMachine *m) { return sortReference(m, 1); }
+
+// Linear scan: on an unsorted array it disagrees with the binary search,
+// which check mode then reports.
+static uint64_t searchReference(AccelMachine *m, int isSigned) {
+    uint16_t addr = m->regs[REG_A0], key = m->regs[REG_A1];
+    uint32_t n = wordCount(m);
+    uint16_t found = 0xFFFF;
+    for (uint32_t i = 0; i < n; i++) {
+        uint16_t at = (uint16_t)(addr + 2 * i);
+        observeRange(m, at, 2, 0);
+        uint16_t v = loadWord(m, at);
+        if (v == key) {
+            found = (uint16_t)i;
+            break;
+        }
+        if (!lessThan(v, key, isSigned))
+            break;
+    }
+    m->regs[REG_A0] = found;
+    return probes(n);
+}
+
+static uint64_t searchU16Reference(AccelMachine *m) { return searchReference(m, 0); }
+static uint64_t searchS16Reference(AccelMachine *m) { return searchReference(m, 1); }
+
+// -----------------------
+// Kernel table
+// -----------------------
+
+static const struct {
+    unsigned id;
+    AccelKernel kernel;
+} builtins[] = {
+    {ACCEL_CRC32,      {"crc32",    crc32IeeeNative, crc32IeeeReference, 8, 8}},
+    {ACCEL_CRC32C,     {"crc32c",   crc32cNative,    crc32cReference,    8, 8}},
+    {ACCEL_CRC16,      {"crc16",    crc16Native,     crc16Reference,     8, 4}},
+    {ACCEL_INET_SUM,   {"inetsum",  inetSumNative,   inetSumReference,   8, 16}},
+    {ACCEL_SORT_U16,   {"sortu16",  sortU16Native,   sortU16Reference,   16, 2}},
+    {ACCEL_SORT_S16,   {"sorts16",  sortS16Native,   sortS16Reference,   16, 2}},
+    {ACCEL_SEARCH_U16, {"searchu16", searchU16Native, searchU16Reference, 8, 1}},
+    {ACCEL_SEARCH_S16, {"searchs16", searchS16Native, searchS16Reference, 8, 1}},
+};
+
+static int builtinsReady = 0;
+
+static void registerBuiltins(void) {
+    builtinsReady = 1;
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+        if (!kernels[builtins[i].id].name)
+            kernels[builtins[i].id] = builtins[i].kernel;
+    if (!tablesReady)
+        buildTables();
+}
+
+int accelRegister(unsigned id, const AccelKernel *kernel) {
+    if (!builtinsReady)
+        registerBuiltins();
+    if (id >= ACCEL_MAX_KERNELS || !kernel->name || !kernel->native || !kernel->reference ||
+        kernel->width < 1) {
+        fprintf(stderr, "Error: bad accelerator kernel %u\n", id);
+        return -1;
+    }
+    kernels[id] = *kernel;
+    memset(&stats[id], 0, sizeof(stats[id]));
+    return 0;
+}
+
+static AccelKernel *findKernel(const char *name) {
+    for (int id = 0; id < ACCEL_MAX_KERNELS; id++)
+        if (kernels[id].name && strcmp(kernels[id].name, name) == 0)
+            return &kernels[id];
+    return NULL;
+}
+
+static int accelItem(const char *key, char *value) {
+    if (strcmp(key, "mode") == 0) {
+        if (strcmp(value, "native") == 0) mode = MODE_NATIVE;
+        else if (strcmp(value, "reference") == 0) mode = MODE_REFERENCE;
+        else if (strcmp(value, "check") == 0) mode = MODE_CHECK;
+        else return -1;
+        return 0;
+    }
+    AccelKernel *k = findKernel(key);
+    char *colon = strchr(value, ':');
+    if (!k || !colon)
+        return -1;
+    *colon = '\0';
+    uint64_t base, width;
+    if (specNumber(value, &base) != 0 || specNumber(colon + 1, &width) != 0 || width < 1)
+        return -1;
+    k->base = (uint32_t)base;
+    k->width = (uint32_t)width;
+    return 0;
+}
+
+int accelInit(const char *spec) {
+    if (!builtinsReady)
+        registerBuiltins();
+    int status = specParse(spec, "", "accelerator", accelItem);
+    if (status == 0)
+        reportEnabled = 1;
+    return status;
+}
+
+// -----------------------
+// Dispatch
+// -----------------------
+
+// Run the reference on a copy of the machine next to the native run and
+// report the first register or byte where the two disagree.
+static uint64_t runChecked(int id, AccelMachine *m) {
+    static uint16_t refRegs[8];
+    static unsigned char refMem[MEM_SIZE];
+    AccelKernel *k = &kernels[id];
+    memcpy(refRegs, m->regs, sizeof(refRegs));
+    memcpy(refMem, m->mem, MEM_SIZE);
+    AccelMachine copy = {refRegs, refMem, NULL};
+    k->reference(&copy);
+    uint64_t units = k->native(m);
+
+    for (int r = 0; r < 8; r++)
+        if (m->regs[r] != refRegs[r]) {
+            if (stats[id].mismatches++ == 0)
+                fprintf(stderr, "accel: %s at PC=0x%04X: %s is 0x%04X natively, 0x%04X in the reference\n",
+                        k->name, pc, regNames[r], m->regs[r], refRegs[r]);
+            return units;
+        }
+    if (memcmp(m->mem, refMem, MEM_SIZE) != 0) {
+        uint32_t a = 0;
+        while (m->mem[a] == refMem[a])
+            a++;
+        if (stats[id].mismatches++ == 0)
+            fprintf(stderr, "accel: %s at PC=0x%04X: byte 0x%04X is 0x%02X natively, 0x%02X in the reference\n",
+                    k->name, pc, a, m->mem[a], refMem[a]);
+    }
+    return units;
+}
+
+int64_t accelEcall(void (*observe)(uint16_t addr, int size, int isWrite)) {
+    if (!builtinsReady)
+        registerBuiltins();
+    unsigned id = regs[REG_T0];
+    if (id >= ACCEL_MAX_KERNELS || !kernels[id].name)
+        return -1;
+    AccelKernel *k = &kernels[id];
+    AccelMachine m = {regs, memory, observe};
+    uint64_t units;
+    if (mode == MODE_CHECK)
+        units = runChecked((int)id, &m);
+    else if (mode == MODE_REFERENCE)
+        units = k->reference(&m);
+    else
+        units = k->native(&m);
+
+    uint64_t cost = k->base + (units + k->width - 1) / k->width;
+    stats[id].calls++;
+    stats[id].units += units;
+    stats[id].charged += cost;
+    return cost > 1 ? (int64_t)(cost - 1) : 0;
+}
+
+int accelReference(AccelMachine *m) {
+    if (!builtinsReady)
+        registerBuiltins();
+    unsigned id = m->regs[REG_T0];
+    if (id >= ACCEL_MAX_KERNELS || !kernels[id].name)
+        return -1;
+    kernels[id].reference(m);
+    return 0;
+}
+
+void accelReport(void) {
+    if (!reportEnabled)
+        return;
+    static const char *modeNames[] = {"native", "reference", "check"};
+    fprintf(stderr, "accel: %s kernels\n", modeNames[mode]);
+    for (int id = 0; id < ACCEL_MAX_KERNELS; id++) {
+        if (!stats[id].calls)
+            continue;
+        fprintf(stderr, "  %-10s %10llu calls %12llu units %12llu instructions",
+                kernels[id].name, (unsigned long long)stats[id].calls,
+                (unsigned long long)stats[id].units, (unsigned long long)stats[id].charged);
+        if (mode == MODE_CHECK)
+            fprintf(stderr, " %llu mismatched", (unsigned long long)stats[id].mismatches);
+        fprintf(stderr, "\n");
+    }
+}
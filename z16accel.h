@@ -0,0 +1,76 @@
+/*
+ * Accelerator ecall (service 15) for the Z16 simulator: a table of native
+ * kernels over guest buffers, selected by t0.
+ *
+ * Every kernel has two implementations: a native one (table-driven or
+ * hardware CRC, radix sort, binary search) and a reference one written as
+ * the element-at-a-time loop a Z16 routine would run. The spec chooses
+ * which runs, or runs both and reports any disagreement; the co-simulation
+ * reference always uses the reference implementation.
+ *
+ * Each call counts as base + ceil(units / width) retired instructions,
+ * where a unit is a byte for the checksums, an element comparison for the
+ * sorts and a probe for the searches.
+ */
+#ifndef Z16ACCEL_H
+#define Z16ACCEL_H
+
+#include <stdint.h>
+
+// Built-in kernels; addresses in a0, lengths in t1 (bytes or elements)
+#define ACCEL_CRC32        0  // CRC-32 (IEEE) of [a0, a0+t1) continuing the
+                              // 4-byte value at a1 (0 to start), which is
+                              // updated; a0/a1 = low/high half of the result
+#define ACCEL_CRC32C       1  // same with the Castagnoli polynomial
+#define ACCEL_CRC16        2  // CRC-16/CCITT of [a0, a0+t1) from a1 (0xFFFF
+                              // to start); a0 = result
+#define ACCEL_INET_SUM     3  // ones' complement sum of big-endian 16-bit
+                              // words (RFC 1071) from a1; a0 = folded sum
+#define ACCEL_SORT_U16     4  // sort t1 unsigned little-endian words at a0
+#define ACCEL_SORT_S16     5  // same for signed words
+#define ACCEL_SEARCH_U16   6  // index of the first a1 among t1 sorted
+                              // unsigned words at a0, or 0xFFFF; a0 = index
+#define ACCEL_SEARCH_S16   7  // same for signed words
+
+#define ACCEL_MAX_KERNELS  64
+
+// The state a kernel works on: the simulator's, or the co-simulation
+// reference's. `observe` (may be NULL) is told about every range before it
+// is read or written.
+typedef struct {
+    uint16_t *regs;
+    unsigned char *mem;
+    void (*observe)(uint16_t addr, int size, int isWrite);
+} AccelMachine;
+
+// Run the kernel on the machine; returns the work units for the cost.
+typedef uint64_t (*AccelFunction)(AccelMachine *m);
+
+typedef struct {
+    const char *name;           // spec key and report label
+    AccelFunction native;
+    AccelFunction reference;
+    uint32_t base;              // instructions per call, the ecall included
+    uint32_t width;             // work units per further instruction
+} AccelKernel;
+
+// Install or replace kernel `id` (the kernel is copied). Returns 0 on
+// success.
+int accelRegister(unsigned id, const AccelKernel *kernel);
+
+// Parse a spec such as "mode=check,crc32=8:16" (or "default"). Returns 0 on
+// success.
+int accelInit(const char *spec);
+
+// Run kernel t0 on the simulator's state. Returns the instructions the
+// call counts as beyond the ecall itself, or -1 for an unknown kernel.
+int64_t accelEcall(void (*observe)(uint16_t addr, int size, int isWrite));
+
+// Run the reference implementation of kernel regs[t0] on another machine.
+// Returns 0, or -1 for an unknown kernel.
+int accelReference(AccelMachine *m);
+
+// Print per-kernel calls, work and disagreements to stderr.
+void accelReport(void);
+
+#endif // Z16ACCEL_H
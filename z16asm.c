@@ -34,9 +34,19 @@
  #include <ctype.h>
  #include <stdint.h>
 
+ #include "z16debug.h"
+ #include "z16image.h"
+
  #define MAX_LINE_LENGTH 256
  #define MAX_LABEL_LENGTH 64
  #define MAX_LINES 2048
+ #define MAX_SOURCE_FILES 64
+ #define MAX_INCLUDE_DEPTH 8
+ #define MAX_INCLUDE_DIRS 16
+ // Where .include looks last: the runtime library shipped with the assembler
+ #ifndef Z16_RUNTIME_DIR
+ #define Z16_RUNTIME_DIR "."
+ #endif
  // Total memory is 64KB
  #define MEM_SIZE 65536
 
@@ -140,7 +150,7 @@
  // Instruction Encoding Structures and Table
  // -----------------------
 
- typedef enum { INST_R, INST_I, INST_B, INST_L, INST_J, INST_U, INST_S } InstType;
+ typedef enum { INST_R, INST_I, INST_B, INST_L, INST_J, INST_U, INST_S, INST_CALL } InstType;
 
  typedef struct {
      char *mnemonic;    // stored in lower-case
@@ -162,8 +172,32 @@
      {"and",   INST_R, 0, 5, 0x0},
      {"xor",   INST_R, 0, 6, 0x4},
      {"mv",    INST_R, 0, 7, 0x8},
-     {"jr",    INST_R, 0, 7, 0x0},
+     {"jr",    INST_R, 0, 0, 0x4},
      {"jalr",  INST_R, 0, 0, 0x8},
+     // M extension (z16_sim --mext), funct3 2; see z16decode.h
+     {"mul",   INST_R, 0, 2, 0x1},
+     {"mulh",  INST_R, 0, 2, 0x2},
+     {"mulhu", INST_R, 0, 2, 0x3},
+     {"div",   INST_R, 0, 2, 0x4},
+     {"divu",  INST_R, 0, 2, 0x5},
+     {"rem",   INST_R, 0, 2, 0x6},
+     {"remu",  INST_R, 0, 2, 0x7},
+     // Packed bytes (z16_sim --simd), funct3 1; see z16decode.h
+     {"paddb",   INST_R, 0, 1, 0x1},
+     {"psubb",   INST_R, 0, 1, 0x2},
+     {"paddsb",  INST_R, 0, 1, 0x3},
+     {"psubsb",  INST_R, 0, 1, 0x4},
+     {"paddusb", INST_R, 0, 1, 0x5},
+     {"psubusb", INST_R, 0, 1, 0x6},
+     {"pminsb",  INST_R, 0, 1, 0x7},
+     {"pmaxsb",  INST_R, 0, 1, 0x8},
+     {"pminub",  INST_R, 0, 1, 0x9},
+     {"pmaxub",  INST_R, 0, 1, 0xA},
+     {"pcmpeqb", INST_R, 0, 1, 0xB},
+     {"pcmpltb", INST_R, 0, 1, 0xC},
+     {"pswapb",  INST_R, 0, 1, 0xD},
+     {"ppacklb", INST_R, 0, 1, 0xE},
+     {"ppackhb", INST_R, 0, 1, 0xF},
      {"addi",  INST_I, 1, 0, 0},
      {"slti",  INST_I, 1, 1, 0},
      {"sltui", INST_I, 1, 2, 0},
@@ -182,19 +216,29 @@
      {"bge",   INST_B, 2, 5, 0},
      {"bltu",  INST_B, 2, 6, 0},
      {"bgeu",  INST_B, 2, 7, 0},
-     {"lb",    INST_L, 3, 0, 0},
-     {"lw",    INST_L, 3, 2, 0},
-     {"lbu",   INST_L, 3, 4, 0},
+     {"lb",    INST_L, 4, 0, 0},
+     {"lw",    INST_L, 4, 1, 0},
+     {"lbu",   INST_L, 4, 4, 0},
      {"sb",    INST_L, 3, 0, 0},
-     {"sw",    INST_L, 3, 2, 0},
+     {"sw",    INST_L, 3, 1, 0},
      {"j",     INST_J, 5, 0, 0},
      {"jal",   INST_J, 5, 0, 0},
      {"lui",   INST_U, 6, 0, 0},
      {"auipc", INST_U, 6, 0, 0},
      {"ecall", INST_S, 7, 0, 0},
+     // "call <label>": li t0, %hi(label-2); slli t0, 7; addi t0, %lo(label-2);
+     // jalr t0, ra (JALR resumes 2 bytes past its target)
+     {"call",  INST_CALL, 0, 0, 0},
      {NULL, 0, 0, 0, 0} // end marker
  };
 
+ #define CALL_WORDS 4
+
+ // Machine words an instruction assembles to
+ int instructionWords(const char *mnemonic) {
+     return cmpIgnoreCase(mnemonic, "call") == 0 ? CALL_WORDS : 1;
+ }
+
  // Lookup instruction definition (case-insensitive).
  InstructionDef* lookupInstruction(const char *mnemonic) {
      for (int i = 0; instructionSet[i].mnemonic != NULL; i++) {
@@ -231,30 +275,54 @@
      return -1;
  }
 
- // Parse an immediate value. Supports decimal, octal, hex, binary, %hi(...) and %lo(...).
- int parseImmediate(const char *token) {
+ // Whether token names a register, which is never a symbol.
+ static int isRegisterName(const char *token) {
+     static const char *names[] = {"t0", "ra", "sp", "s0", "s1", "t1", "a0", "a1"};
+     if((token[0]=='x' || token[0]=='X') && token[1] >= '0' && token[1] <= '7' && token[2] == '\0')
+         return 1;
+     for(int i = 0; i < 8; i++)
+         if(cmpIgnoreCase(token, names[i]) == 0)
+             return 1;
+     return 0;
+ }
+
+ // Parse an immediate value. Supports decimal, octal, hex, binary, %hi(...) and %lo(...),
+ // and labels and .equ names, which are all defined by the time pass 2 encodes.
+ int parseImmediate(const char *token, int lineNo) {
      if(strncmp(token, "%hi(", 4)==0) {
          const char *p = token + 4;
          char numberStr[64];
          int i = 0;
-         while(*p && *p != ')') {
+         while(*p && *p != ')' && i < 63) {
              numberStr[i++] = *p++;
          }
          numberStr[i] = '\0';
-         int value = (int)strtol(numberStr, NULL, 0);
+         int value = parseImmediate(numberStr, lineNo);
          return value >> 7;
      }
      if(strncmp(token, "%lo(", 4)==0) {
          const char *p = token + 4;
          char numberStr[64];
          int i = 0;
-         while(*p && *p != ')') {
+         while(*p && *p != ')' && i < 63) {
              numberStr[i++] = *p++;
          }
          numberStr[i] = '\0';
-         int value = (int)strtol(numberStr, NULL, 0);
+         int value = parseImmediate(numberStr, lineNo);
          return value & 0x7F;
      }
+     if(isalpha((unsigned char)token[0]) || token[0] == '_') {
+         if(isRegisterName(token)) {
+             fprintf(stderr, "Error on line %d: expected immediate, found register '%s'\n", lineNo, token);
+             exit(1);
+         }
+         Symbol *sym = findSymbol(token);
+         if(!sym) {
+             fprintf(stderr, "Error on line %d: Undefined symbol '%s'\n", lineNo, token);
+             exit(1);
+         }
+         return sym->address;
+     }
      // Support binary constants with "0b" or "0B" prefix.
      if(token[0]=='0' && (token[1]=='b' || token[1]=='B'))
          return (int)strtol(token+2, NULL, 2);
@@ -268,6 +336,7 @@
  // Each code element’s size: for instructions and .word, 2 bytes; for .byte and .asciiz, 1 byte.
  typedef struct {
      int lineNo;                      // source line number
+     int file;                        // index in sourceFiles
      char original[MAX_LINE_LENGTH];  // original source text
      int address;                     // computed address
      Section section;                 // TEXT or DATA
@@ -277,11 +346,22 @@
      uint16_t *code;                  // array of code elements (each stored in 16 bits)
      int codeCount;                   // number of code elements
      int elementSize;                 // size in bytes for each code element (1 or 2)
+     int bank;                        // physical bank from .bank, or -1
  } Line;
 
  Line *lines[MAX_LINES];
  int lineCount = 0;
 
+ // The main source is file 0; .include adds the others in the order they
+ // are first read. Lines carry their file's index for the -g line table.
+ char *sourceFiles[MAX_SOURCE_FILES];
+ int sourceFileCount = 0;
+ int includeDepth = 0;
+
+ // Directories from -I, searched by .include after the including file's own
+ char *includeDirs[MAX_INCLUDE_DIRS];
+ int includeDirCount = 0;
+
  // -----------------------
  // Global Location Counters and Section Tracking
  // -----------------------
@@ -290,6 +370,16 @@
  int loc_data = 0;  // data section location counter (in bytes)
  Section currentSection = SECTION_NONE;
 
+ // Banked output (.banksize / .bank): a line in bank n is stored at physical
+ // address n * bankSize + (address mod bankSize) in the binary, to run when
+ // the simulator's MMU maps bank n over its address.
+ int bankSize = 4096;
+ int currentBank = -1;
+
+ // Entry point from .entry (a label or an address), kept in segmented images.
+ char *entryOperand = NULL;
+ int entryLineNo = 0;
+
  // -----------------------
  // Source Line Parsing Functions
  // -----------------------
@@ -298,6 +388,7 @@
      Line *l = (Line *)malloc(sizeof(Line));
      if(!l) { perror("malloc"); exit(1); }
      l->lineNo = lineNo;
+     l->file = 0;
      strncpy(l->original, src, MAX_LINE_LENGTH);
      l->address = 0;
      l->section = currentSection;
@@ -307,6 +398,7 @@
      l->code = NULL;
      l->codeCount = 0;
      l->elementSize = 0;
+     l->bank = currentBank;
      return l;
  }
 
@@ -361,12 +453,77 @@
  // Pass 1: Build Symbol Table and Assign Addresses
  // -----------------------
 
- void pass1(FILE *fp) {
+ void pass1(FILE *fp, int file);
+
+ // Open the file named by an .include line: relative to the including file,
+ // then in each -I directory, then in the runtime library directory.
+ static FILE *openInclude(const Line *line, char *path, size_t pathSize) {
+     char name[MAX_LINE_LENGTH];
+     const char *s = line->operands ? line->operands : "";
+     size_t len = strlen(s);
+     if(len >= 2 && s[0] == '"' && s[len-1] == '"') {
+         s++;
+         len -= 2;
+     }
+     if(len == 0 || len >= sizeof(name)) {
+         fprintf(stderr, "Error on line %d: .include needs a file name\n", line->lineNo);
+         exit(1);
+     }
+     memcpy(name, s, len);
+     name[len] = '\0';
+     if(name[0] == '/') {
+         snprintf(path, pathSize, "%s", name);
+         return fopen(path, "r");
+     }
+     const char *including = sourceFiles[line->file];
+     const char *slash = strrchr(including, '/');
+     if(slash)
+         snprintf(path, pathSize, "%.*s/%s", (int)(slash - including), including, name);
+     else
+         snprintf(path, pathSize, "%s", name);
+     FILE *fp = fopen(path, "r");
+     for (int i = 0; !fp && i <= includeDirCount; i++) {
+         snprintf(path, pathSize, "%s/%s", i < includeDirCount ? includeDirs[i] : Z16_RUNTIME_DIR, name);
+         fp = fopen(path, "r");
+     }
+     if(!fp) {
+         fprintf(stderr, "Error on line %d: cannot find include file '%s'\n", line->lineNo, name);
+         exit(1);
+     }
+     return fp;
+ }
+
+ // Read an included file's lines in place of the .include line.
+ static void includeFile(const Line *line) {
+     char path[512];
+     if(includeDepth == MAX_INCLUDE_DEPTH) {
+         fprintf(stderr, "Error on line %d: .include nested more than %d deep\n", line->lineNo, MAX_INCLUDE_DEPTH);
+         exit(1);
+     }
+     FILE *fp = openInclude(line, path, sizeof(path));
+     if(sourceFileCount == MAX_SOURCE_FILES) {
+         fprintf(stderr, "Error on line %d: more than %d source files\n", line->lineNo, MAX_SOURCE_FILES);
+         exit(1);
+     }
+     int file = sourceFileCount++;
+     sourceFiles[file] = strdup(path);
+     includeDepth++;
+     pass1(fp, file);
+     includeDepth--;
+     fclose(fp);
+ }
+
+ void pass1(FILE *fp, int file) {
      char srcLine[MAX_LINE_LENGTH];
      int currentLineNo = 0;
      while(fgets(srcLine, sizeof(srcLine), fp)) {
          currentLineNo++;
+         if(lineCount == MAX_LINES) {
+             fprintf(stderr, "Error: more than %d source lines\n", MAX_LINES);
+             exit(1);
+         }
          Line *line = newLine(currentLineNo, srcLine);
+         line->file = file;
          parseSourceLine(line);
          line->section = currentSection;
          if(currentSection == SECTION_TEXT)
@@ -394,6 +551,48 @@
                      loc_data = newOrg;
                      line->address = loc_data;
                  }
+             } else if(cmpIgnoreCase(line->mnemonic, ".banksize") == 0) {
+                 int size = line->operands ? (int)strtol(line->operands, NULL, 0) : 0;
+                 if(size < 1024 || size > 32768 || (size & (size - 1)) != 0) {
+                     fprintf(stderr, "Error on line %d: .banksize must be a power of two from 1024 to 32768\n", line->lineNo);
+                     exit(1);
+                 }
+                 bankSize = size;
+             } else if(cmpIgnoreCase(line->mnemonic, ".bank") == 0) {
+                 // ".bank <n>" starts physical bank n, a bare ".bank" returns to
+                 // unbanked output
+                 currentBank = line->operands ? (int)strtol(line->operands, NULL, 0) : -1;
+                 if(line->operands && (currentBank < 0 || (long)currentBank * bankSize >= 16L * 1024 * 1024)) {
+                     fprintf(stderr, "Error on line %d: bank %s is outside 16 MB of physical memory\n", line->lineNo, line->operands);
+                     exit(1);
+                 }
+             } else if(cmpIgnoreCase(line->mnemonic, ".include") == 0) {
+                 lines[lineCount++] = line;
+                 includeFile(line);
+                 continue;
+             } else if(cmpIgnoreCase(line->mnemonic, ".equ") == 0) {
+                 // ".equ name, value": a constant for immediates
+                 char *comma = line->operands ? strchr(line->operands, ',') : NULL;
+                 if(!comma) {
+                     fprintf(stderr, "Error on line %d: .equ needs a name and a value\n", line->lineNo);
+                     exit(1);
+                 }
+                 char name[MAX_LABEL_LENGTH], value[MAX_LINE_LENGTH];
+                 snprintf(name, sizeof(name), "%.*s", (int)(comma - line->operands), line->operands);
+                 snprintf(value, sizeof(value), "%s", comma + 1);
+                 trim(name);
+                 trim(value);
+                 if(addSymbol(name, parseImmediate(value, line->lineNo), SECTION_NONE) != 0) {
+                     fprintf(stderr, "Error on line %d: Duplicate symbol %s\n", line->lineNo, name);
+                     exit(1);
+                 }
+             } else if(cmpIgnoreCase(line->mnemonic, ".entry") == 0) {
+                 if(line->operands==NULL) {
+                     fprintf(stderr, "Error on line %d: .entry missing operand\n", line->lineNo);
+                     exit(1);
+                 }
+                 entryOperand = line->operands;
+                 entryLineNo = line->lineNo;
              } else if(cmpIgnoreCase(line->mnemonic, ".asciiz") == 0) {
                  if(line->operands==NULL) {
                      fprintf(stderr, "Error on line %d: .asciiz missing string operand\n", line->lineNo);
@@ -433,10 +632,10 @@
                  loc_data += spaceSize;
              }
          } else if(line->mnemonic) {
-             // For instructions, each produces 2 bytes.
+             // For instructions, each word is 2 bytes.
              if(currentSection==SECTION_TEXT) {
                  line->elementSize = 2;
-                 loc_text += 2;
+                 loc_text += 2 * instructionWords(line->mnemonic);
              }
          }
          lines[lineCount++] = line;
@@ -489,7 +688,7 @@
                  int idx = 0;
                  while(token) {
                      trim(token);
-                     int val = parseImmediate(token);
+                     int val = parseImmediate(token, line->lineNo);
                      line->code[idx++] = (uint16_t)(val & 0xFF);
                      token = strtok(NULL, ",");
                  }
@@ -504,7 +703,7 @@
                  int idx = 0;
                  while(token) {
                      trim(token);
-                     int val = parseImmediate(token);
+                     int val = parseImmediate(token, line->lineNo);
                      line->code[idx++] = (uint16_t)val;
                      token = strtok(NULL, ",");
                  }
@@ -576,17 +775,25 @@
                  }
                  int reg = parseRegister(token);
                  token = strtok(NULL, ", \t");
+                 // "addi rd, rd, imm" names the destination twice; any other
+                 // register in the immediate slot is an error.
+                 if(token && isRegisterName(token) && parseRegister(token) == reg) {
+                     char *next = strtok(NULL, ", \t");
+                     if(next)
+                         token = next;
+                 }
                  if(!token) {
                      fprintf(stderr, "Error on line %d: Expected immediate operand\n", line->lineNo);
                      exit(1);
                  }
-                 int imm = parseImmediate(token);
+                 int imm = parseImmediate(token, line->lineNo);
+                 // Shift type in imm[6:5] (1 SLLI, 2 SRLI, 3 SRAI), amount below it
                  if(cmpIgnoreCase(inst->mnemonic, "srli") == 0) {
-                     imm = (0x2 << 4) | (imm & 0xF);
+                     imm = (0x2 << 5) | (imm & 0xF);
                  } else if(cmpIgnoreCase(inst->mnemonic, "srai") == 0) {
-                     imm = (0x4 << 4) | (imm & 0xF);
+                     imm = (0x3 << 5) | (imm & 0xF);
                  } else if(cmpIgnoreCase(inst->mnemonic, "slli") == 0) {
-                     imm = (0x1 << 4) | (imm & 0xF);
+                     imm = (0x1 << 5) | (imm & 0xF);
                  }
                  machineWord |= ((imm & 0x7F) << 9);
                  machineWord |= ((reg & 0x7) << 6);
@@ -692,7 +899,7 @@
                          exit(1);
                      }
                      *parenOpen = '\0';
-                     int imm = parseImmediate(token);
+                     int imm = parseImmediate(token, line->lineNo);
                      char *regStr = parenOpen + 1;
                      *parenClose = '\0';
                      int rs = parseRegister(regStr);
@@ -722,7 +929,7 @@
                             exit(1);
                         }
                         *parenOpen = '\0';
-                        int imm = parseImmediate(token);
+                        int imm = parseImmediate(token, line->lineNo);
                         char *regStr = parenOpen + 1;
                         *parenClose = '\0';
                         int rs1 = parseRegister(regStr);
@@ -753,15 +960,21 @@
                  }
                  int currPC = line->address;
                  int targetPC = sym->address;
-                 int offset = (targetPC - currPC) >> 1;
-                 if(offset < -128 || offset > 127) {
+                 // The simulator lands on pc + 2 * offset + 2. The 9-bit offset
+                 // is I[9:4] in bits 9-14 and I[3:1] in bits 3-5; a negative one
+                 // only keeps its low 5 bits, so backward jumps reach 32 words.
+                 int offset = (targetPC - currPC - 2) >> 1;
+                 if(offset < -32 || offset > 255) {
                      fprintf(stderr, "Error on line %d: Jump offset out of range\n", line->lineNo);
                      exit(1);
                  }
                  int f = (cmpIgnoreCase(inst->mnemonic, "jal") == 0) ? 1 : 0;
                  machineWord |= (f & 0x1) << 15;
-                 machineWord |= ((offset & 0xFF) << 7);
-                 machineWord |= (inst->opcode & 0xF);
+                 machineWord |= ((offset >> 3) & 0x3F) << 9;
+                 if(f)
+                     machineWord |= (1 << 6);   // link in ra
+                 machineWord |= (offset & 0x7) << 3;
+                 machineWord |= (inst->opcode & 0x7);
              } else if(inst->type == INST_U) {
                  // U‑type: Format: f | imm[15:10] | rd | imm[9:7] | opcode.
                  char *ops = line->operands;
@@ -776,7 +989,7 @@
                      fprintf(stderr, "Error on line %d: Expected immediate for U‑type instruction\n", line->lineNo);
                      exit(1);
                  }
-                 int imm_val = parseImmediate(token);
+                 int imm_val = parseImmediate(token, line->lineNo);
                  int upper = (imm_val >> 3) & 0x3F;  // bits for imm[15:10]
                  int lower = imm_val & 0x7;          // bits for imm[9:7]
                  machineWord |= (upper << 9);
@@ -788,8 +1001,12 @@
 
                  int service_num = 0;
                  if (line->operands != NULL) {
-                     // Convert the operand string to an integer (e.g., "ecall 1" -> 1)
-                     service_num = atoi(line->operands);
+                     // Convert the operand string to an integer (e.g., "ecall 1" -> 1,
+                     // or an .equ name such as SYS_PRINT_INT)
+                     char service[MAX_LINE_LENGTH];
+                     snprintf(service, sizeof(service), "%s", line->operands);
+                     trim(service);
+                     service_num = parseImmediate(service, line->lineNo);
 
                      // Log the parsed service number for debugging
                      printf("Parsed ECALL service number: %d\n", service_num);
@@ -802,6 +1019,27 @@
 
                  // Encode the service number in bits [15:3] and opcode in [2:0]
                  machineWord = ((service_num & 0x1FF) << 3) | (inst->opcode & 0x7);
+             } else if (inst->type == INST_CALL) {
+                 char *token = line->operands ? strtok(line->operands, " \t") : NULL;
+                 Symbol *sym = token ? findSymbol(token) : NULL;
+                 if(!sym) {
+                     fprintf(stderr, "Error on line %d: call needs a defined label\n", line->lineNo);
+                     exit(1);
+                 }
+                 int target = sym->address - 2;
+                 if(target < 0 || target > 0x3FFF) {
+                     fprintf(stderr, "Error on line %d: call target '%s' is outside 0x0002-0x4001\n", line->lineNo, token);
+                     exit(1);
+                 }
+                 line->codeCount = CALL_WORDS;
+                 line->code = (uint16_t *)malloc(CALL_WORDS * sizeof(uint16_t));
+                 line->code[0] = (uint16_t)(((target >> 7) << 9) | (0x7 << 3) | 0x1);          // li t0
+                 line->code[1] = (uint16_t)((((0x1 << 5) | 7) << 9) | (0x3 << 3) | 0x1);       // slli t0, 7
+                 line->code[2] = (uint16_t)(((target & 0x7F) << 9) | 0x1);                     // addi t0
+                 line->code[3] = (uint16_t)((0x8 << 12) | (1 << 9));                           // jalr t0, ra
+                 loc_text += 2 * CALL_WORDS;
+                 line->elementSize = 2;
+                 continue;
              }
 
              line->codeCount = 1;
@@ -858,11 +1096,119 @@
  // Dump Binary: Write Memory Image to Output File
  // -----------------------
 
- void dumpBinary(const char *binFilename) {
-     int maxAddr = 0;
+ static void put16(FILE *fp, int v) {
+     fputc(v & 0xFF, fp);
+     fputc((v >> 8) & 0xFF, fp);
+ }
+
+ static void put32(FILE *fp, uint32_t v) {
+     put16(fp, (int)(v & 0xFFFF));
+     put16(fp, (int)(v >> 16));
+ }
+
+ // Where a line's first byte goes in the binary
+ static long physicalAddress(const Line *l) {
+     if(l->bank < 0)
+         return l->address;
+     return (long)l->bank * bankSize + (l->address & (bankSize - 1));
+ }
+
+ // Bytes of the image by what defines them, for the segmented format
+ enum { BYTE_NONE, BYTE_TEXT, BYTE_DATA, BYTE_SPACE };
+
+ static int segmentFlags(unsigned char kind) {
+     return kind == BYTE_TEXT ? IMAGE_SEG_TEXT : IMAGE_SEG_DATA;
+ }
+
+ static int resolveEntry(void) {
+     if(!entryOperand)
+         return 0;
+     Symbol *sym = findSymbol(entryOperand);
+     long value = sym ? sym->address : strtol(entryOperand, NULL, 0);
+     if(value < 0 || value > 0xFFFF) {
+         fprintf(stderr, "Error on line %d: .entry %s is outside the address space\n", entryLineNo, entryOperand);
+         exit(1);
+     }
+     return (int)value;
+ }
+
+ // Segments are runs of defined bytes with the same flags; a gap shorter than
+ // a segment record is stored as zeros instead of starting a new segment, and
+ // trailing .space bytes are zero-filled by the loader rather than stored.
+ static void writeSegmented(FILE *fp, const unsigned char *memoryImage, const unsigned char *kind, long size) {
+     long (*seg)[3] = NULL;  // start, file end, mem end
+     int count = 0, capacity = 0;
+     long a = 0;
+     while(a < size) {
+         if(kind[a] == BYTE_NONE) {
+             a++;
+             continue;
+         }
+         int flags = segmentFlags(kind[a]);
+         long start = a, fileEnd = a, memEnd = a;
+         while(a < size) {
+             if(kind[a] == BYTE_NONE) {
+                 long next = a;
+                 while(next < size && kind[next] == BYTE_NONE)
+                     next++;
+                 if(next == size || next - a >= IMAGE_SEGMENT_BYTES || segmentFlags(kind[next]) != flags)
+                     break;
+                 a = next;
+             }
+             if(segmentFlags(kind[a]) != flags)
+                 break;
+             if(kind[a] != BYTE_SPACE)
+                 fileEnd = a + 1;
+             memEnd = ++a;
+         }
+         if(count == capacity) {
+             capacity = capacity ? capacity * 2 : 16;
+             seg = realloc(seg, capacity * sizeof(*seg));
+             if(!seg) { perror("realloc"); exit(1); }
+         }
+         seg[count][0] = start;
+         seg[count][1] = fileEnd > start ? fileEnd : start;
+         seg[count][2] = memEnd;
+         count++;
+     }
+
+     fwrite(IMAGE_MAGIC, 1, 8, fp);
+     put16(fp, IMAGE_VERSION);
+     put16(fp, resolveEntry());
+     put32(fp, (uint32_t)count);
+     put32(fp, 0);
+     put32(fp, 0);
+     uint32_t offset = IMAGE_HEADER_BYTES + (uint32_t)count * IMAGE_SEGMENT_BYTES;
+     for (int i = 0; i < count; i++) {
+         uint32_t fileBytes = (uint32_t)(seg[i][1] - seg[i][0]);
+         put32(fp, (uint32_t)seg[i][0]);
+         put32(fp, fileBytes ? offset : 0);
+         put32(fp, fileBytes);
+         put32(fp, (uint32_t)(seg[i][2] - seg[i][0]));
+         put16(fp, segmentFlags(kind[seg[i][0]]));
+         put16(fp, 0);
+         offset += fileBytes;
+     }
+     for (int i = 0; i < count; i++)
+         fwrite(memoryImage + seg[i][0], 1, seg[i][1] - seg[i][0], fp);
+     free(seg);
+ }
+
+ // Writes a flat image (byte n at address n) or, with segmented set, the
+ // format in z16image.h.
+ void dumpBinary(const char *binFilename, int segmented) {
+     long maxAddr = 0;
      for (int i = 0; i < lineCount; i++) {
-         if (lines[i]->codeCount > 0) {
-             int endAddr = lines[i]->address + lines[i]->codeCount * lines[i]->elementSize;
+         Line *l = lines[i];
+         int size = l->codeCount * l->elementSize;
+         if (segmented && l->mnemonic && cmpIgnoreCase(l->mnemonic, ".space") == 0)
+             size = (int)strtol(l->operands, NULL, 0);
+         if (size > 0) {
+             if(l->bank >= 0 && l->address / bankSize != (l->address + size - 1) / bankSize) {
+                 fprintf(stderr, "Error on line %d: banked code crosses a %d-byte bank boundary\n", l->lineNo, bankSize);
+                 exit(1);
+             }
+             long endAddr = physicalAddress(l) + size;
              if(endAddr > maxAddr)
                  maxAddr = endAddr;
          }
@@ -871,7 +1217,8 @@
          maxAddr = 1;  // write at least one byte
 
      unsigned char *memoryImage = (unsigned char *)calloc(maxAddr, 1);
-     if(!memoryImage) {
+     unsigned char *kind = segmented ? (unsigned char *)calloc(maxAddr, 1) : NULL;
+     if(!memoryImage || (segmented && !kind)) {
           perror("calloc");
           exit(1);
      }
@@ -880,14 +1227,21 @@
           Line *l = lines[i];
           if(l->codeCount > 0 && (l->section == SECTION_TEXT || l->section == SECTION_DATA)) {
               for (int j = 0; j < l->codeCount; j++) {
-                  int addr = l->address + j * l->elementSize;
+                  long addr = physicalAddress(l) + j * l->elementSize;
                   if(l->elementSize == 1) {
                       memoryImage[addr] = l->code[j] & 0xFF;
                   } else if(l->elementSize == 2) {
                       memoryImage[addr] = l->code[j] & 0xFF;
                       memoryImage[addr+1] = (l->code[j] >> 8) & 0xFF;
                   }
+                  if(kind)
+                      memset(kind + addr, l->section == SECTION_TEXT ? BYTE_TEXT : BYTE_DATA, l->elementSize);
               }
+          } else if(kind && l->mnemonic && cmpIgnoreCase(l->mnemonic, ".space") == 0) {
+              long addr = physicalAddress(l);
+              for (long n = strtol(l->operands, NULL, 0); n > 0; n--, addr++)
+                  if(kind[addr] == BYTE_NONE)
+                      kind[addr] = BYTE_SPACE;
           }
      }
      FILE *fp = fopen(binFilename, "wb");
@@ -895,12 +1249,147 @@
           perror("Error opening binary file for writing");
           exit(1);
      }
-     fwrite(memoryImage, 1, maxAddr, fp);
+     if(segmented) {
+          writeSegmented(fp, memoryImage, kind, maxAddr);
+     } else {
+          if(entryOperand && resolveEntry() != 0)
+              fprintf(stderr, "Warning on line %d: a flat binary starts at address 0; use -s to keep .entry\n", entryLineNo);
+          fwrite(memoryImage, 1, maxAddr, fp);
+     }
      fclose(fp);
      free(memoryImage);
+     free(kind);
      printf("Binary file generated: %s\n", binFilename);
  }
 
+ // -----------------------
+ // Debug Line Table (.dbg, format in z16debug.h)
+ // -----------------------
+
+ typedef struct {
+     int address;
+     int size;
+     int lineNo;
+     int file;
+     int section;
+ } DebugLine;
+
+ typedef struct {
+     int address;
+     int section;
+     const char *name;
+ } DebugSymbol;
+
+ static int debugSection(Section sec) {
+     return (sec == SECTION_TEXT) ? DEBUG_SECTION_TEXT : DEBUG_SECTION_DATA;
+ }
+
+ // By address; at equal addresses text sorts last so lookups prefer code.
+ static int cmpDebugLine(const void *a, const void *b) {
+     const DebugLine *x = (const DebugLine *)a, *y = (const DebugLine *)b;
+     if (x->address != y->address)
+         return x->address - y->address;
+     return y->section - x->section;
+ }
+
+ static int cmpDebugSymbol(const void *a, const void *b) {
+     const DebugSymbol *x = (const DebugSymbol *)a, *y = (const DebugSymbol *)b;
+     if (x->address != y->address)
+         return x->address - y->address;
+     return y->section - x->section;
+ }
+
+ void writeDebugInfo(const char *binFilename) {
+     char dbgFilename[256];
+     strncpy(dbgFilename, binFilename, sizeof(dbgFilename) - 5);
+     dbgFilename[sizeof(dbgFilename) - 5] = '\0';
+     char *dot = strrchr(dbgFilename, '.');
+     char *slash = strrchr(dbgFilename, '/');
+     if (dot && (!slash || dot > slash))
+         strcpy(dot, ".dbg");
+     else
+         strcat(dbgFilename, ".dbg");
+
+     DebugLine *dl = (DebugLine *)malloc((lineCount ? lineCount : 1) * sizeof(DebugLine));
+     int nLines = 0;
+     int nSymbols = 0;
+     for (Symbol *cur = symbolTable; cur; cur = cur->next)
+         nSymbols++;
+     DebugSymbol *ds = (DebugSymbol *)malloc((nSymbols ? nSymbols : 1) * sizeof(DebugSymbol));
+     if (!dl || !ds) { perror("malloc"); exit(1); }
+
+     for (int i = 0; i < lineCount; i++) {
+         Line *l = lines[i];
+         // Banked lines share addresses with whatever else runs there
+         if (l->codeCount == 0 || (l->section != SECTION_TEXT && l->section != SECTION_DATA) || l->bank >= 0)
+             continue;
+         dl[nLines].address = l->address;
+         dl[nLines].size = l->codeCount * l->elementSize;
+         dl[nLines].lineNo = l->lineNo;
+         dl[nLines].file = l->file;
+         dl[nLines].section = debugSection(l->section);
+         nLines++;
+     }
+     // The string table holds the source names, then the symbol names.
+     uint32_t stringBytes = 0;
+     for (int i = 0; i < sourceFileCount; i++)
+         stringBytes += (uint32_t)strlen(sourceFiles[i]) + 1;
+     nSymbols = 0;
+     for (Symbol *cur = symbolTable; cur; cur = cur->next) {
+         if (cur->section != SECTION_TEXT && cur->section != SECTION_DATA)
+             continue;
+         ds[nSymbols].address = cur->address;
+         ds[nSymbols].section = debugSection(cur->section);
+         ds[nSymbols].name = cur->name;
+         nSymbols++;
+     }
+     qsort(dl, nLines, sizeof(DebugLine), cmpDebugLine);
+     qsort(ds, nSymbols, sizeof(DebugSymbol), cmpDebugSymbol);
+
+     FILE *fp = fopen(dbgFilename, "wb");
+     if (!fp) {
+         perror("Error opening debug info file for writing");
+         exit(1);
+     }
+     uint32_t nameOffset = stringBytes;
+     for (int i = 0; i < nSymbols; i++)
+         stringBytes += (uint32_t)strlen(ds[i].name) + 1;
+
+     fwrite(DEBUG_MAGIC, 1, 8, fp);
+     put16(fp, DEBUG_VERSION);
+     put16(fp, 0);
+     put32(fp, (uint32_t)sourceFileCount);
+     put32(fp, (uint32_t)nLines);
+     put32(fp, (uint32_t)nSymbols);
+     put32(fp, stringBytes);
+     put32(fp, 0);
+     for (int i = 0, offset = 0; i < sourceFileCount; i++) {
+         put32(fp, (uint32_t)offset);
+         offset += (int)strlen(sourceFiles[i]) + 1;
+     }
+     for (int i = 0; i < nLines; i++) {
+         put16(fp, dl[i].address);
+         put16(fp, dl[i].size);
+         put32(fp, (uint32_t)dl[i].lineNo);
+         put16(fp, dl[i].file);
+         put16(fp, dl[i].section);
+     }
+     for (int i = 0; i < nSymbols; i++) {
+         put16(fp, ds[i].address);
+         put16(fp, ds[i].section);
+         put32(fp, nameOffset);
+         nameOffset += (uint32_t)strlen(ds[i].name) + 1;
+     }
+     for (int i = 0; i < sourceFileCount; i++)
+         fwrite(sourceFiles[i], 1, strlen(sourceFiles[i]) + 1, fp);
+     for (int i = 0; i < nSymbols; i++)
+         fwrite(ds[i].name, 1, strlen(ds[i].name) + 1, fp);
+     fclose(fp);
+     free(dl);
+     free(ds);
+     printf("Debug info generated: %s\n", dbgFilename);
+ }
+
  // -----------------------
  // Verbose Dump: Symbol Table and Memory Usage
  // -----------------------
@@ -925,11 +1414,13 @@
  int main(int argc, char **argv) {
     int verbose = 0;
     int debugModeFlag = 0;
+    int debugInfoFlag = 0;
+    int segmentedFlag = 0;
     char *filename = NULL;
     char *binFilename = NULL;
 
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [-v] [-d] [-o <binary_file>] <sourcefile>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-v] [-d] [-g] [-s] [-I <dir>] [-o <binary_file>] <sourcefile>\n", argv[0]);
         exit(1);
     }
 
@@ -939,6 +1430,18 @@
             verbose = 1;
         else if (strcmp(argv[i], "-d") == 0)
             debugModeFlag = 1;
+        else if (strcmp(argv[i], "-g") == 0)
+            debugInfoFlag = 1;
+        else if (strcmp(argv[i], "-s") == 0)
+            segmentedFlag = 1;
+        else if (strcmp(argv[i], "-I") == 0) {
+            if (i + 1 < argc && includeDirCount < MAX_INCLUDE_DIRS) {
+                includeDirs[includeDirCount++] = argv[++i];
+            } else {
+                fprintf(stderr, "Error: -I requires a directory (at most %d)\n", MAX_INCLUDE_DIRS);
+                exit(1);
+            }
+        }
         else if (strcmp(argv[i], "-o") == 0) {
             if (i + 1 < argc) {
                 binFilename = argv[i + 1];
@@ -984,7 +1487,8 @@
     currentSection = SECTION_NONE;
     if (debugModeFlag)
         printf("Debug: Starting Pass 1\n");
-    pass1(fp);
+    sourceFiles[sourceFileCount++] = strdup(filename);
+    pass1(fp, 0);
     fclose(fp);
 
     if (debugModeFlag)
@@ -996,7 +1500,9 @@
         printf("Debug: Pass 2 complete\n");
 
     generateListing(filename);
-    dumpBinary(binFilename);
+    dumpBinary(binFilename, segmentedFlag);
+    if (debugInfoFlag)
+        writeDebugInfo(binFilename);
     if (verbose)
         dumpVerbose();
 
@@ -1008,6 +1514,8 @@
         symbolTable = symbolTable->next;
         free(temp);
     }
+    for (int i = 0; i < sourceFileCount; i++)
+        free(sourceFiles[i]);
     free(binFilename);
 
     return 0;
@@ -0,0 +1,170 @@
+/*
+ * Bulk memory ecall (see z16bulk.h for the guest's view).
+ *
+ * Cost spec syntax (comma separated, any order):
+ *   base=<n>    instructions charged per call, the ecall included (default 4)
+ *   width=<n>   bytes processed per further instruction (default 8)
+ *
+ * Guest ranges may wrap past 0xFFFF, so every routine works on pieces that
+ * end at the top of memory or at the end of the range, whichever is first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16bulk.h"
+#include "z16range.h"
+#include "z16spec.h"
+
+static uint32_t baseCost = 4;
+static uint32_t width = 8;
+
+static int bulkItem(const char *key, char *value) {
+    uint64_t v;
+    if (specNumber(value, &v) != 0)
+        return -1;
+    if (strcmp(key, "base") == 0) baseCost = (uint32_t)v;
+    else if (strcmp(key, "width") == 0) width = (uint32_t)v;
+    else return -1;
+    return 0;
+}
+
+int bulkInit(const char *spec) {
+    int status = specParse(spec, "", "bulk cost", bulkItem);
+    if (status == 0 && width < 1) {
+        fprintf(stderr, "Error: bulk cost needs width >= 1\n");
+        status = -1;
+    }
+    return status;
+}
+
+// Copy between ranges that do not overlap.
+static void copyDisjoint(uint16_t dst, uint16_t src, uint32_t n) {
+    while (n > 0) {
+        uint32_t c = rangePiece(dst, rangePiece(src, n));
+        memcpy(&memory[dst], &memory[src], c);
+        dst = (uint16_t)(dst + c);
+        src = (uint16_t)(src + c);
+        n -= c;
+    }
+}
+
+static void moveBytes(uint16_t dst, uint16_t src, uint32_t n) {
+    if (n == 0 || dst == src)
+        return;
+    if ((uint32_t)dst + n <= MEM_SIZE && (uint32_t)src + n <= MEM_SIZE) {
+        memmove(&memory[dst], &memory[src], n);
+        return;
+    }
+    rangeRead(memory, src, rangeStaging, n);
+    rangeWrite(memory, dst, rangeStaging, n);
+}
+
+// What a forward byte loop does: where the destination starts d bytes into
+// the source, the first d source bytes repeat through the destination. The
+// pattern written so far is itself a source, so the blocks double in size.
+static void copyForward(uint16_t dst, uint16_t src, uint32_t n) {
+    uint32_t d = (uint16_t)(dst - src);
+    if (n == 0 || d == 0)
+        return;
+    if (d >= n) {               // every source byte is read before it is written
+        moveBytes(dst, src, n);
+        return;
+    }
+    if (d + n > MEM_SIZE) {     // the destination wraps onto the source again
+        for (uint32_t i = 0; i < n; i++)
+            memory[(uint16_t)(dst + i)] = memory[(uint16_t)(src + i)];
+        return;
+    }
+    copyDisjoint(dst, src, d);
+    for (uint32_t done = d; done < n; ) {
+        uint32_t c = done + d < n - done ? done + d : n - done;
+        copyDisjoint((uint16_t)(dst + done), src, c);
+        done += c;
+    }
+}
+
+static void fillBytes(uint16_t dst, uint8_t value, uint32_t n) {
+    while (n > 0) {
+        uint32_t c = rangePiece(dst, n);
+        memset(&memory[dst], value, c);
+        dst = (uint16_t)(dst + c);
+        n -= c;
+    }
+}
+
+// Returns the first byte difference, and in *examined how far it looked.
+static uint16_t compareBytes(uint16_t a, uint16_t b, uint32_t n, uint32_t *examined) {
+    for (uint32_t done = 0; done < n; ) {
+        uint16_t pa = (uint16_t)(a + done), pb = (uint16_t)(b + done);
+        uint32_t c = rangePiece(pa, rangePiece(pb, n - done));
+        if (memcmp(&memory[pa], &memory[pb], c) != 0) {
+            uint32_t i = 0;
+            while (memory[pa + i] == memory[pb + i])
+                i++;
+            *examined = done + i + 1;
+            return (uint16_t)(memory[pa + i] - memory[pb + i]);
+        }
+        done += c;
+    }
+    *examined = n;
+    return 0;
+}
+
+static uint16_t stringLength(uint16_t addr, uint32_t *examined) {
+    for (uint32_t done = 0; done < MEM_SIZE; ) {
+        uint16_t p = (uint16_t)(addr + done);
+        uint32_t c = rangePiece(p, MEM_SIZE - done);
+        const unsigned char *nul = (const unsigned char *)memchr(&memory[p], 0, c);
+        if (nul) {
+            uint32_t len = done + (uint32_t)(nul - &memory[p]);
+            *examined = len + 1;
+            return (uint16_t)len;
+        }
+        done += c;
+    }
+    *examined = MEM_SIZE;
+    return 0xFFFF;
+}
+
+int64_t bulkEcall(BulkObserve observe) {
+    uint16_t a = regs[REG_A0], b = regs[REG_A1];
+    uint32_t n = regs[REG_T1];
+    uint32_t bytes = n;
+    switch (regs[REG_T0]) {
+        case BULK_COPY:
+        case BULK_MOVE:
+            if (observe) {
+                rangeObserve(observe, b, n, 0);
+                rangeObserve(observe, a, n, 1);
+            }
+            if (regs[REG_T0] == BULK_COPY)
+                copyForward(a, b, n);
+            else
+                moveBytes(a, b, n);
+            break;
+        case BULK_SET:
+            if (observe)
+                rangeObserve(observe, a, n, 1);
+            fillBytes(a, (uint8_t)b, n);
+            break;
+        case BULK_COMPARE:
+            regs[REG_A0] = compareBytes(a, b, n, &bytes);
+            if (observe) {
+                rangeObserve(observe, a, bytes, 0);
+                rangeObserve(observe, b, bytes, 0);
+            }
+            break;
+        case BULK_STRLEN:
+            regs[REG_A0] = stringLength(a, &bytes);
+            if (observe)
+                rangeObserve(observe, a, bytes, 0);
+            break;
+        default:
+            return -1;
+    }
+    uint64_t cost = baseCost + (bytes + width - 1) / width;
+    return cost > 1 ? (int64_t)(cost - 1) : 0;
+}
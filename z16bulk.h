@@ -0,0 +1,39 @@
+/*
+ * Bulk memory ecall (service 14) for the Z16 simulator: block copy, fill,
+ * compare and string length on guest memory, run with the host's C library
+ * routines instead of guest byte loops.
+ *
+ * t0 selects the operation; a0 and a1 are the addresses (a1 is the fill
+ * byte for BULK_SET) and t1 the length. Ranges wrap at the top of memory
+ * like every other guest address. Results, where there are any, come back
+ * in a0; other registers are preserved.
+ *
+ * Each call counts as base + ceil(bytes / width) retired instructions
+ * (the ecall included), and the timing model and call-graph profile are
+ * charged the same, so profiles stay comparable with code that loops.
+ */
+#ifndef Z16BULK_H
+#define Z16BULK_H
+
+#include <stdint.h>
+
+#define BULK_COPY    0  // copy t1 bytes a1 -> a0 like a forward byte loop
+                        // (overlap ahead of the source repeats the pattern)
+#define BULK_MOVE    1  // copy as if through a temporary buffer (memmove)
+#define BULK_SET     2  // fill t1 bytes at a0 with the low byte of a1
+#define BULK_COMPARE 3  // a0 = first difference a0[i] - a1[i] as bytes, or 0
+#define BULK_STRLEN  4  // a0 = length of the string at a0 (0xFFFF: no NUL)
+
+// Reports the bytes an operation reads or writes to the load/store
+// instrumentation; called before guest memory changes.
+typedef void (*BulkObserve)(uint16_t addr, int size, int isWrite);
+
+// Parse a cost spec such as "base=4,width=8" (or "default"). Returns 0 on
+// success.
+int bulkInit(const char *spec);
+
+// Run the operation selected by t0. Returns the number of instructions the
+// call counts as beyond the ecall itself, or -1 for an unknown operation.
+int64_t bulkEcall(BulkObserve observe);
+
+#endif // Z16BULK_H
@@ -0,0 +1,87 @@
+/*
+ * Memory bus (see z16bus.h for the address decode).
+ *
+ * The slow paths keep the interpreter's behaviour at the top of memory: a
+ * word access starting in the last three bytes reaches into the guard bytes
+ * after `memory` instead of wrapping to address 0.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16bus.h"
+
+typedef struct {
+    const char *name;
+    BusRead read;
+    BusWrite write;
+    void *ctx;
+} BusDevice;
+
+unsigned char *busRam[BUS_PAGES];
+static BusDevice devices[BUS_PAGES];
+
+void busInit(void) {
+    for (uint32_t p = 0; p < BUS_PAGES; p++) {
+        busRam[p] = &memory[p << BUS_PAGE_BITS];
+        memset(&devices[p], 0, sizeof(devices[p]));
+    }
+}
+
+int busMap(uint16_t base, uint32_t size, const char *name, BusRead read, BusWrite write, void *ctx) {
+    if (base % BUS_PAGE_SIZE != 0 || size == 0 || size % BUS_PAGE_SIZE != 0 ||
+        (uint32_t)base + size > MEM_SIZE) {
+        fprintf(stderr, "Error: %s must occupy whole %d-byte pages\n", name, BUS_PAGE_SIZE);
+        return -1;
+    }
+    uint32_t first = base >> BUS_PAGE_BITS, last = first + (size >> BUS_PAGE_BITS);
+    for (uint32_t p = first; p < last; p++)
+        if (devices[p].name) {
+            fprintf(stderr, "Error: %s overlaps %s at 0x%04X\n", name, devices[p].name,
+                    p << BUS_PAGE_BITS);
+            return -1;
+        }
+    for (uint32_t p = first; p < last; p++) {
+        devices[p] = (BusDevice){name, read, write, ctx};
+        busRam[p] = NULL;
+    }
+    return 0;
+}
+
+const char *busDevice(uint16_t addr) {
+    return devices[addr >> BUS_PAGE_BITS].name;
+}
+
+uint32_t busReadSlow(uint16_t addr, int size) {
+    BusDevice *d = &devices[addr >> BUS_PAGE_BITS];
+    if (d->name)
+        return d->read(d->ctx, addr, size);
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        uint32_t a = (uint32_t)addr + i;
+        uint8_t byte;
+        if (a >= MEM_SIZE || busRam[a >> BUS_PAGE_BITS])
+            byte = memory[a];
+        else
+            byte = (uint8_t)busReadSlow((uint16_t)a, 1);
+        value |= (uint32_t)byte << (8 * i);
+    }
+    return value;
+}
+
+void busWriteSlow(uint16_t addr, int size, uint32_t value) {
+    BusDevice *d = &devices[addr >> BUS_PAGE_BITS];
+    if (d->name) {
+        d->write(d->ctx, addr, size, value);
+        return;
+    }
+    for (int i = 0; i < size; i++) {
+        uint32_t a = (uint32_t)addr + i;
+        uint8_t byte = (uint8_t)(value >> (8 * i));
+        if (a >= MEM_SIZE || busRam[a >> BUS_PAGE_BITS])
+            memory[a] = byte;
+        else
+            busWriteSlow((uint16_t)a, 1, byte);
+    }
+}
@@ -0,0 +1,81 @@
+/*
+ * Memory bus of the Z16 simulator: routes guest loads and stores between
+ * RAM and memory-mapped devices.
+ *
+ * Address decode is a table with one entry per 256-byte page. A RAM page's
+ * entry points at its bytes in `memory`, so a RAM access is one table load
+ * and one indexed access; a device page's entry is NULL and the access goes
+ * to the device's callbacks instead. Devices claim whole pages with
+ * busMap() at startup; the interpreter does not change when one is added.
+ *
+ * Only the L/S instructions go through the bus. Instruction fetch, ecalls
+ * and the instrumentation read `memory` directly, so on a device page they
+ * see its backing RAM, which the device may use as register storage.
+ */
+#ifndef Z16BUS_H
+#define Z16BUS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+
+#define BUS_PAGE_BITS 8
+#define BUS_PAGE_SIZE (1 << BUS_PAGE_BITS)
+#define BUS_PAGES (MEM_SIZE >> BUS_PAGE_BITS)
+
+// A device access of `size` bytes (1 or 4) at addr, little-endian. An access
+// that starts on a device page goes to that device whole; bytes of a RAM
+// access that spill onto a device page reach it one at a time.
+typedef uint32_t (*BusRead)(void *ctx, uint16_t addr, int size);
+typedef void (*BusWrite)(void *ctx, uint16_t addr, int size, uint32_t value);
+
+// Host bytes of each RAM page; NULL where a device is mapped
+extern unsigned char *busRam[BUS_PAGES];
+
+// Map every page to RAM; call before any busMap().
+void busInit(void);
+
+// Give pages [base, base+size) to a device; both must be multiples of
+// BUS_PAGE_SIZE. Returns 0, or -1 if a page already belongs to a device.
+int busMap(uint16_t base, uint32_t size, const char *name, BusRead read, BusWrite write, void *ctx);
+
+// Name of the device at addr, or NULL for RAM
+const char *busDevice(uint16_t addr);
+
+// Accesses that touch a device page or the end of memory
+uint32_t busReadSlow(uint16_t addr, int size);
+void busWriteSlow(uint16_t addr, int size, uint32_t value);
+
+static inline uint8_t busLoad8(uint16_t addr) {
+    unsigned char *page = busRam[addr >> BUS_PAGE_BITS];
+    return page ? page[addr & (BUS_PAGE_SIZE - 1)] : (uint8_t)busReadSlow(addr, 1);
+}
+
+static inline uint32_t busLoad32(uint16_t addr) {
+    unsigned char *page = busRam[addr >> BUS_PAGE_BITS];
+    uint32_t offset = addr & (BUS_PAGE_SIZE - 1), value;
+    if (!page || offset > BUS_PAGE_SIZE - 4)
+        return busReadSlow(addr, 4);
+    memcpy(&value, page + offset, 4);
+    return value;
+}
+
+static inline void busStore8(uint16_t addr, uint8_t value) {
+    unsigned char *page = busRam[addr >> BUS_PAGE_BITS];
+    if (page)
+        page[addr & (BUS_PAGE_SIZE - 1)] = value;
+    else
+        busWriteSlow(addr, 1, value);
+}
+
+static inline void busStore32(uint16_t addr, uint32_t value) {
+    unsigned char *page = busRam[addr >> BUS_PAGE_BITS];
+    uint32_t offset = addr & (BUS_PAGE_SIZE - 1);
+    if (page && offset <= BUS_PAGE_SIZE - 4)
+        memcpy(page + offset, &value, 4);
+    else
+        busWriteSlow(addr, 4, value);
+}
+
+#endif // Z16BUS_H
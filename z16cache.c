@@ -0,0 +1,276 @@
+/*
+ * Configurable cache hierarchy model for the Z16 simulator.
+ *
+ * Every level keeps its tags, replacement state and dirty bits in flat arrays
+ * indexed by set * ways + way, allocated once by cacheInit(). A lookup is a
+ * shift, a mask and a scan over `ways` tags; nothing is allocated per access.
+ *
+ * Spec syntax (comma separated, any order):
+ *   l1i=<size>:<assoc>:<line>[:<policy>]   instruction cache
+ *   l1d=<size>:<assoc>:<line>[:<policy>]   data cache
+ *   l2=<size>:<assoc>:<line>[:<policy>]    unified second level
+ *   write=wb|wt                            write-back + allocate (default) or
+ *                                          write-through + no-write-allocate
+ * Sizes accept a k suffix; policy is lru (default), fifo or random. Levels
+ * that are not given are absent and accesses fall through to the next one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16cache.h"
+#include "z16debuginfo.h"
+#include "z16spec.h"
+
+#define LEVEL_L1I 0
+#define LEVEL_L1D 1
+#define LEVEL_L2  2
+#define NUM_LEVELS 3
+
+typedef enum { REPL_LRU, REPL_FIFO, REPL_RANDOM } ReplPolicy;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} PcCacheStats;
+
+typedef struct CacheLevel {
+    const char *name;
+    int present;
+    int size, assoc, lineSize;
+    ReplPolicy policy;
+    int lineShift;
+    int sets;
+    uint32_t setMask;
+    uint32_t *tags;      // line address + 1 (0 = invalid), [sets * assoc]
+    uint64_t *stamp;     // LRU: last use; FIFO: fill time
+    uint8_t *dirty;
+    struct CacheLevel *next;
+    uint64_t hits, misses, evictions, writebacks;
+    uint64_t readAccesses, writeAccesses;
+    PcCacheStats *pcStats; // [MEM_SIZE / 2]
+} CacheLevel;
+
+static CacheLevel levels[NUM_LEVELS] = {
+    { .name = "L1I" }, { .name = "L1D" }, { .name = "L2" },
+};
+static int writeBack = 1;
+static uint64_t accessClock = 0;
+static uint32_t randomState = 0x2545F491;
+
+static int log2Exact(int v) {
+    int s = 0;
+    while ((1 << s) < v) s++;
+    return ((1 << s) == v) ? s : -1;
+}
+
+static int parseLevel(CacheLevel *c, const char *params) {
+    char *p;
+    c->size = (int)specParseBytes(params, &p);
+    if (*p++ != ':') return -1;
+    c->assoc = (int)strtol(p, &p, 0);
+    if (*p++ != ':') return -1;
+    c->lineSize = (int)strtol(p, &p, 0);
+    c->policy = REPL_LRU;
+    if (*p == ':') {
+        p++;
+        if (strcmp(p, "lru") == 0) c->policy = REPL_LRU;
+        else if (strcmp(p, "fifo") == 0) c->policy = REPL_FIFO;
+        else if (strcmp(p, "random") == 0) c->policy = REPL_RANDOM;
+        else return -1;
+    } else if (*p) {
+        return -1;
+    }
+    c->lineShift = log2Exact(c->lineSize);
+    if (c->lineShift < 0 || c->assoc <= 0 || c->size <= 0 ||
+        c->size % (c->assoc * c->lineSize) != 0)
+        return -1;
+    c->sets = c->size / (c->assoc * c->lineSize);
+    if (log2Exact(c->sets) < 0)
+        return -1;
+    c->setMask = (uint32_t)c->sets - 1;
+    c->present = 1;
+    return 0;
+}
+
+static void allocateLevel(CacheLevel *c) {
+    int lines = c->sets * c->assoc;
+    c->tags = (uint32_t *)calloc(lines, sizeof(uint32_t));
+    c->stamp = (uint64_t *)calloc(lines, sizeof(uint64_t));
+    c->dirty = (uint8_t *)calloc(lines, 1);
+    c->pcStats = (PcCacheStats *)calloc(MEM_SIZE / 2, sizeof(PcCacheStats));
+    if (!c->tags || !c->stamp || !c->dirty || !c->pcStats) { perror("calloc"); exit(1); }
+}
+
+static int cacheItem(const char *key, char *value) {
+    if (strcmp(key, "l1i") == 0) return parseLevel(&levels[LEVEL_L1I], value);
+    if (strcmp(key, "l1d") == 0) return parseLevel(&levels[LEVEL_L1D], value);
+    if (strcmp(key, "l2") == 0) return parseLevel(&levels[LEVEL_L2], value);
+    if (strcmp(key, "write") == 0 && strcmp(value, "wb") == 0) writeBack = 1;
+    else if (strcmp(key, "write") == 0 && strcmp(value, "wt") == 0) writeBack = 0;
+    else return -1;
+    return 0;
+}
+
+int cacheInit(const char *spec) {
+    if (specParse(spec, "l1i=1k:2:16:lru,l1d=1k:2:16:lru,l2=8k:4:32:lru,write=wb", "cache",
+                  cacheItem) != 0)
+        return -1;
+
+    CacheLevel *l2 = levels[LEVEL_L2].present ? &levels[LEVEL_L2] : NULL;
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        if (!levels[i].present)
+            continue;
+        allocateLevel(&levels[i]);
+        levels[i].next = (i == LEVEL_L2) ? NULL : l2;
+    }
+    return 0;
+}
+
+static void accessLine(CacheLevel *c, uint32_t lineAddr, int isWrite, uint16_t instPc);
+
+// Forward an access to the level below `c` (memory when there is none).
+static void accessNext(CacheLevel *c, uint32_t byteAddr, int isWrite, uint16_t instPc) {
+    CacheLevel *n = c->next;
+    if (n)
+        accessLine(n, byteAddr >> n->lineShift, isWrite, instPc);
+}
+
+static void accessLine(CacheLevel *c, uint32_t lineAddr, int isWrite, uint16_t instPc) {
+    uint32_t set = lineAddr & c->setMask;
+    uint32_t *tags = &c->tags[set * c->assoc];
+    uint64_t *stamp = &c->stamp[set * c->assoc];
+    uint8_t *dirty = &c->dirty[set * c->assoc];
+    uint32_t key = lineAddr + 1;
+    PcCacheStats *ps = &c->pcStats[instPc >> 1];
+    accessClock++;
+    if (isWrite) c->writeAccesses++; else c->readAccesses++;
+
+    for (int w = 0; w < c->assoc; w++) {
+        if (tags[w] == key) {
+            c->hits++;
+            ps->hits++;
+            if (c->policy == REPL_LRU)
+                stamp[w] = accessClock;
+            if (isWrite) {
+                if (writeBack)
+                    dirty[w] = 1;
+                else
+                    accessNext(c, lineAddr << c->lineShift, 1, instPc);
+            }
+            return;
+        }
+    }
+
+    c->misses++;
+    ps->misses++;
+    if (isWrite && !writeBack) {
+        // No-write-allocate: the write goes straight down.
+        accessNext(c, lineAddr << c->lineShift, 1, instPc);
+        return;
+    }
+
+    int victim = -1;
+    for (int w = 0; w < c->assoc; w++) {
+        if (tags[w] == 0) { victim = w; break; }
+    }
+    if (victim < 0) {
+        if (c->policy == REPL_RANDOM) {
+            randomState ^= randomState << 13;
+            randomState ^= randomState >> 17;
+            randomState ^= randomState << 5;
+            victim = (int)(randomState % (uint32_t)c->assoc);
+        } else {
+            victim = 0;
+            for (int w = 1; w < c->assoc; w++) {
+                if (stamp[w] < stamp[victim]) victim = w;
+            }
+        }
+        c->evictions++;
+        ps->evictions++;
+        if (dirty[victim]) {
+            c->writebacks++;
+            accessNext(c, (tags[victim] - 1) << c->lineShift, 1, instPc);
+        }
+    }
+    accessNext(c, lineAddr << c->lineShift, 0, instPc);
+    tags[victim] = key;
+    stamp[victim] = accessClock;
+    dirty[victim] = (uint8_t)(isWrite && writeBack);
+}
+
+// Route an access to the first present level starting at `first`, splitting
+// it at line boundaries.
+static void accessRange(int first, uint16_t instPc, uint16_t addr, int size, int isWrite) {
+    CacheLevel *c = levels[first].present ? &levels[first] :
+                    (levels[LEVEL_L2].present ? &levels[LEVEL_L2] : NULL);
+    if (!c)
+        return;
+    uint32_t firstLine = (uint32_t)addr >> c->lineShift;
+    uint32_t lastLine = ((uint32_t)addr + size - 1) >> c->lineShift;
+    for (uint32_t line = firstLine; line <= lastLine; line++)
+        accessLine(c, line, isWrite, instPc);
+}
+
+void cacheFetch(uint16_t fetchPc) {
+    accessRange(LEVEL_L1I, fetchPc, fetchPc, 2, 0);
+}
+
+void cacheData(uint16_t instPc, uint16_t addr, int size, int isWrite) {
+    accessRange(LEVEL_L1D, instPc, addr, size, isWrite);
+}
+
+static const char *policyName(ReplPolicy p) {
+    return p == REPL_LRU ? "lru" : (p == REPL_FIFO ? "fifo" : "random");
+}
+
+void cacheReport(const char *statsFile) {
+    fprintf(stderr, "\n--- Cache Statistics (%s) ---\n",
+            writeBack ? "write-back, write-allocate" : "write-through, no-write-allocate");
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        CacheLevel *c = &levels[i];
+        if (!c->present)
+            continue;
+        uint64_t total = c->hits + c->misses;
+        fprintf(stderr, "%-4s %6d B %2d-way %3d B lines %-6s  accesses %llu (R %llu, W %llu)  "
+                "hits %llu  misses %llu (%.2f%%)  evictions %llu  writebacks %llu\n",
+                c->name, c->size, c->assoc, c->lineSize, policyName(c->policy),
+                (unsigned long long)total, (unsigned long long)c->readAccesses,
+                (unsigned long long)c->writeAccesses, (unsigned long long)c->hits,
+                (unsigned long long)c->misses, total ? 100.0 * c->misses / total : 0.0,
+                (unsigned long long)c->evictions, (unsigned long long)c->writebacks);
+    }
+
+    if (statsFile) {
+        FILE *fp = fopen(statsFile, "w");
+        if (!fp) {
+            perror("Error opening cache statistics file");
+        } else {
+            fprintf(fp, "# pc     level hits       misses     evictions  [source]\n");
+            char where[96];
+            for (int slot = 0; slot < MEM_SIZE / 2; slot++) {
+                for (int i = 0; i < NUM_LEVELS; i++) {
+                    if (!levels[i].present)
+                        continue;
+                    PcCacheStats *ps = &levels[i].pcStats[slot];
+                    if (ps->hits || ps->misses)
+                        fprintf(fp, "0x%04X  %-5s %-10u %-10u %-10u %s\n", slot << 1,
+                                levels[i].name, ps->hits, ps->misses, ps->evictions,
+                                debugLocation((uint16_t)(slot << 1), where, sizeof(where)));
+                }
+            }
+            fclose(fp);
+            fprintf(stderr, "Cache statistics file generated: %s\n", statsFile);
+        }
+    }
+
+    for (int i = 0; i < NUM_LEVELS; i++) {
+        free(levels[i].tags);
+        free(levels[i].stamp);
+        free(levels[i].dirty);
+        free(levels[i].pcStats);
+    }
+}
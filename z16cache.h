@@ -0,0 +1,28 @@
+/*
+ * Configurable cache hierarchy model for the Z16 simulator.
+ *
+ * Split L1 instruction/data caches backed by an optional unified L2. Each
+ * level has its own size, associativity, line size and replacement policy;
+ * the write policy (write-back/write-allocate or write-through/no-allocate)
+ * applies to the whole hierarchy. The model only counts events, it does not
+ * hold data: memory[] stays the single source of truth.
+ */
+#ifndef Z16CACHE_H
+#define Z16CACHE_H
+
+#include <stdint.h>
+
+// Parse a spec such as "l1i=1024:2:16:lru,l1d=2048:4:16:lru,l2=16384:8:32:lru,write=wb"
+// (or "default") and allocate the tag arrays. Returns 0 on success.
+int cacheInit(const char *spec);
+
+// Instruction fetch of the 16-bit word at `fetchPc`.
+void cacheFetch(uint16_t fetchPc);
+
+// Data access of `size` bytes at `addr` by the instruction at `instPc`.
+void cacheData(uint16_t instPc, uint16_t addr, int size, int isWrite);
+
+// Print per-level totals to stderr and, if `statsFile` is set, per-PC counts.
+void cacheReport(const char *statsFile);
+
+#endif // Z16CACHE_H
@@ -0,0 +1,571 @@
+/*
+ * Static control-flow graph recovery for Z16 memory images (see z16cfg.h).
+ *
+ * 1. Recursive disassembly: a worklist of leader addresses; each is decoded
+ *    sequentially until a block-ending instruction, whose static targets
+ *    become new leaders. Every instruction is decoded once.
+ * 2. Blocks are cut at leaders and block-ending instructions in one sweep
+ *    over the address space.
+ * 3. Dominators with the iterative algorithm of Cooper, Harvey and Kennedy
+ *    over reverse postorder, from a virtual root above all entries.
+ * 4. Natural loops from back edges (u -> h where h dominates u); loops with
+ *    the same header are merged and nesting follows from containment.
+ *
+ * All per-address tables are flat arrays over the 32K instruction slots, so
+ * a full 64 KB image is processed in a few milliseconds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16decode.h"
+#include "z16cfg.h"
+
+#define SLOTS (65536 / 2)
+#define NOT_A_TERMINATOR (-1)
+
+static void *xcalloc(size_t count, size_t size) {
+    void *p = calloc(count ? count : 1, size);
+    if (!p) { perror("calloc"); exit(1); }
+    return p;
+}
+
+static uint16_t fetch(const unsigned char *image, size_t size, uint16_t addr) {
+    if ((size_t)addr + 1 >= size)
+        return 0x0000; // outside the image: the simulator sees zeroed memory
+    return (uint16_t)(image[addr] | (image[addr + 1] << 8));
+}
+
+// How `inst` ends a block, or NOT_A_TERMINATOR.
+static int classify(uint16_t inst) {
+    InstInfo info;
+    decodeOperands(inst, &info);
+    switch (info.kind) {
+        case KIND_INVALID:
+            return CFG_END_HALT;
+        case KIND_BRANCH:
+            return CFG_END_BRANCH;
+        case KIND_JUMP:
+            return ((inst >> 15) & 0x1) ? CFG_END_CALL : CFG_END_JUMP;
+        case KIND_JUMP_REG:
+            if (info.dstMask)
+                return CFG_END_CALL;                    // JALR
+            return (((inst >> 6) & 0x7) == REG_RA) ? CFG_END_RETURN : CFG_END_INDIRECT;
+        case KIND_ECALL:
+            return (((inst >> 3) & 0xF) == ECALL_EXIT) ? CFG_END_EXIT : NOT_A_TERMINATOR;
+        default:
+            return NOT_A_TERMINATOR;
+    }
+}
+
+typedef struct {
+    uint16_t *items;
+    int count, capacity;
+} Worklist;
+
+static void push(Worklist *w, uint16_t addr) {
+    if (w->count == w->capacity) {
+        w->capacity = w->capacity ? w->capacity * 2 : 256;
+        w->items = (uint16_t *)realloc(w->items, w->capacity * sizeof(uint16_t));
+        if (!w->items) { perror("realloc"); exit(1); }
+    }
+    w->items[w->count++] = addr;
+}
+
+// Mark `addr` as a block leader and queue it if it has not been decoded.
+static void addLeader(Worklist *w, uint8_t *leader, const uint8_t *decoded, uint16_t addr) {
+    if (addr & 1)
+        return; // the fetch path only ever sees even targets from static code
+    leader[addr >> 1] = 1;
+    if (!decoded[addr >> 1])
+        push(w, addr);
+}
+
+static void discover(const unsigned char *image, size_t size, const uint16_t *entries, int entryCount,
+                     uint8_t *decoded, uint8_t *leader, uint8_t *entry) {
+    Worklist w = { NULL, 0, 0 };
+    for (int i = 0; i < entryCount; i++) {
+        entry[entries[i] >> 1] = 1;
+        addLeader(&w, leader, decoded, entries[i]);
+    }
+    while (w.count > 0) {
+        uint16_t addr = w.items[--w.count];
+        for (;;) {
+            if (decoded[addr >> 1])
+                break;              // joined code decoded earlier
+            decoded[addr >> 1] = 1;
+            uint16_t inst = fetch(image, size, addr);
+            int end = classify(inst);
+            uint16_t target;
+            if (end == NOT_A_TERMINATOR) {
+                addr = (uint16_t)(addr + 2); // pc wraps like the simulator's
+                continue;
+            }
+            if (end == CFG_END_BRANCH || end == CFG_END_JUMP) {
+                decodeTarget(inst, addr, &target);
+                addLeader(&w, leader, decoded, target);
+            }
+            if (end == CFG_END_BRANCH)
+                addLeader(&w, leader, decoded, (uint16_t)(addr + 2));
+            if (end == CFG_END_CALL) {
+                if (decodeTarget(inst, addr, &target)) {
+                    entry[target >> 1] = 1;
+                    addLeader(&w, leader, decoded, target);
+                }
+                addLeader(&w, leader, decoded, decodeReturnPoint(inst, addr));
+            }
+            break;
+        }
+    }
+    free(w.items);
+}
+
+static void buildBlocks(Cfg *cfg, const uint8_t *decoded, const uint8_t *leader, const uint8_t *entry) {
+    int capacity = 0; // at most one block per instruction
+    for (int s = 0; s < SLOTS; s++)
+        capacity += decoded[s];
+    cfg->blocks = (CfgBlock *)xcalloc(capacity, sizeof(CfgBlock));
+
+    CfgBlock *cur = NULL;
+    for (int s = 0; s < SLOTS; s++) {
+        if (!decoded[s]) {
+            cur = NULL;
+            continue;
+        }
+        uint16_t addr = (uint16_t)(s << 1);
+        if (!cur || leader[s]) {
+            cur = &cfg->blocks[cfg->blockCount++];
+            cur->start = addr;
+            cur->count = 0;
+            cur->end = CFG_END_FALL;
+            cur->isEntry = entry[s];
+            cur->callee = 0xFFFF;
+        }
+        cur->last = addr;
+        cur->count++;
+        cfg->blockOf[s] = cfg->blockCount - 1;
+        cfg->instructionCount++;
+        int end = classify(fetch(cfg->image, cfg->imageSize, addr));
+        if (end != NOT_A_TERMINATOR) {
+            cur->end = (CfgEnd)end;
+            cur = NULL;
+        }
+    }
+}
+
+static void linkBlocks(Cfg *cfg) {
+    for (int b = 0; b < cfg->blockCount; b++) {
+        CfgBlock *blk = &cfg->blocks[b];
+        uint16_t inst = fetch(cfg->image, cfg->imageSize, blk->last);
+        uint16_t target;
+        blk->succ[0] = blk->succ[1] = -1;
+        switch (blk->end) {
+            case CFG_END_FALL:
+                blk->succ[0] = cfgBlockAt(cfg, (uint16_t)(blk->last + 2));
+                break;
+            case CFG_END_BRANCH:
+                decodeTarget(inst, blk->last, &target);
+                blk->succ[0] = cfgBlockAt(cfg, target);
+                blk->succ[1] = cfgBlockAt(cfg, (uint16_t)(blk->last + 2));
+                break;
+            case CFG_END_JUMP:
+                decodeTarget(inst, blk->last, &target);
+                blk->succ[0] = cfgBlockAt(cfg, target);
+                break;
+            case CFG_END_CALL:
+                if (decodeTarget(inst, blk->last, &target))
+                    blk->callee = target;
+                blk->succ[0] = cfgBlockAt(cfg, decodeReturnPoint(inst, blk->last));
+                break;
+            default:
+                break;
+        }
+        if (blk->succ[1] == blk->succ[0])
+            blk->succ[1] = -1; // branch to the next instruction
+        cfg->edgeCount += (blk->succ[0] >= 0) + (blk->succ[1] >= 0);
+    }
+}
+
+// Postorder numbering from the virtual root (index blockCount).
+static void postorder(const Cfg *cfg, int *order, int *number) {
+    int n = cfg->blockCount;
+    int *stack = (int *)xcalloc(n + 1, sizeof(int));
+    int *nextSucc = (int *)xcalloc(n + 1, sizeof(int));
+    uint8_t *seen = (uint8_t *)xcalloc(n + 1, 1);
+    int count = 0, top = 0;
+    stack[top++] = n;
+    seen[n] = 1;
+    int rootNext = 0; // next entry block the root visits
+    while (top > 0) {
+        int b = stack[top - 1];
+        int child = -1;
+        if (b == n) {
+            while (rootNext < n && child < 0) {
+                if (cfg->blocks[rootNext].isEntry && !seen[rootNext])
+                    child = rootNext;
+                rootNext++;
+            }
+        } else {
+            while (nextSucc[b] < 2 && child < 0) {
+                int s = cfg->blocks[b].succ[nextSucc[b]++];
+                if (s >= 0 && !seen[s])
+                    child = s;
+            }
+        }
+        if (child >= 0) {
+            seen[child] = 1;
+            stack[top++] = child;
+        } else {
+            number[b] = count;
+            order[count++] = b;
+            top--;
+        }
+    }
+    // Blocks only reachable through indirect jumps stay unnumbered (-1).
+    free(stack);
+    free(nextSucc);
+    free(seen);
+}
+
+static void computeDominators(Cfg *cfg) {
+    int n = cfg->blockCount;
+    int *order = (int *)xcalloc(n + 1, sizeof(int));
+    int *number = (int *)xcalloc(n + 1, sizeof(int));
+    int *idom = (int *)xcalloc(n + 1, sizeof(int));
+    for (int b = 0; b <= n; b++) {
+        number[b] = -1;
+        idom[b] = -1;
+    }
+    postorder(cfg, order, number);
+
+    // Predecessor lists in CSR form; the root precedes every entry.
+    int *predStart = (int *)xcalloc(n + 2, sizeof(int));
+    int *preds = (int *)xcalloc(cfg->edgeCount + n + 1, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        for (int k = 0; k < 2; k++)
+            if (cfg->blocks[b].succ[k] >= 0) predStart[cfg->blocks[b].succ[k] + 1]++;
+        if (cfg->blocks[b].isEntry) predStart[b + 1]++;
+    }
+    for (int b = 0; b <= n; b++)
+        predStart[b + 1] += predStart[b];
+    int *fill = (int *)xcalloc(n + 1, sizeof(int));
+    for (int b = 0; b < n; b++) {
+        for (int k = 0; k < 2; k++) {
+            int s = cfg->blocks[b].succ[k];
+            if (s >= 0) preds[predStart[s] + fill[s]++] = b;
+        }
+        if (cfg->blocks[b].isEntry) preds[predStart[b] + fill[b]++] = n;
+    }
+
+    idom[n] = n;
+    int changed = 1;
+    int total = number[n] + 1;  // numbered blocks, the root last
+    while (changed) {
+        changed = 0;
+        for (int i = total - 2; i >= 0; i--) { // reverse postorder, root excluded
+            int b = order[i];
+            int newIdom = -1;
+            for (int p = predStart[b]; p < predStart[b + 1]; p++) {
+                int q = preds[p];
+                if (number[q] < 0 || idom[q] < 0)
+                    continue;
+                if (newIdom < 0) {
+                    newIdom = q;
+                    continue;
+                }
+                int x = q, y = newIdom;
+                while (x != y) {
+                    while (number[x] < number[y]) x = idom[x];
+                    while (number[y] < number[x]) y = idom[y];
+                }
+                newIdom = x;
+            }
+            if (newIdom != idom[b]) {
+                idom[b] = newIdom;
+                changed = 1;
+            }
+        }
+    }
+    for (int b = 0; b < n; b++)
+        cfg->blocks[b].idom = (idom[b] == n) ? -1 : idom[b];
+
+    free(order);
+    free(number);
+    free(idom);
+    free(predStart);
+    free(preds);
+    free(fill);
+}
+
+typedef struct {
+    int header;
+    int blockCount;
+    int backEdges;
+    int *members;
+} LoopBuild;
+
+static int compareLoopSize(const void *a, const void *b) {
+    const LoopBuild *x = (const LoopBuild *)a, *y = (const LoopBuild *)b;
+    if (x->blockCount != y->blockCount)
+        return y->blockCount - x->blockCount; // outermost first
+    return x->header - y->header;
+}
+
+static int compareHeader(const void *a, const void *b) {
+    const CfgLoop *x = (const CfgLoop *)a, *y = (const CfgLoop *)b;
+    return x->header - y->header;
+}
+
+static void findLoops(Cfg *cfg) {
+    int n = cfg->blockCount;
+    int *loopAt = (int *)xcalloc(n, sizeof(int));  // LoopBuild index + 1 by header
+    LoopBuild *builds = (LoopBuild *)xcalloc(n, sizeof(LoopBuild));
+    int buildCount = 0;
+    int *mark = (int *)xcalloc(n, sizeof(int));
+    int *stack = (int *)xcalloc(n, sizeof(int));
+
+    // Reverse edges for the body walk.
+    int *predStart = (int *)xcalloc(n + 1, sizeof(int));
+    int *preds = (int *)xcalloc(cfg->edgeCount, sizeof(int));
+    int *predCount = (int *)xcalloc(n, sizeof(int));
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++)
+            if (cfg->blocks[b].succ[k] >= 0) predStart[cfg->blocks[b].succ[k] + 1]++;
+    for (int b = 0; b < n; b++)
+        predStart[b + 1] += predStart[b];
+    for (int b = 0; b < n; b++)
+        for (int k = 0; k < 2; k++) {
+            int s = cfg->blocks[b].succ[k];
+            if (s >= 0) preds[predStart[s] + predCount[s]++] = b;
+        }
+
+    int stamp = 0;
+    for (int u = 0; u < n; u++) {
+        for (int k = 0; k < 2; k++) {
+            int h = cfg->blocks[u].succ[k];
+            if (h < 0 || !cfgDominates(cfg, h, u))
+                continue;
+            LoopBuild *lb;
+            if (loopAt[h] == 0) {
+                lb = &builds[buildCount++];
+                lb->header = h;
+                lb->members = (int *)xcalloc(n, sizeof(int));
+                lb->members[lb->blockCount++] = h;
+                loopAt[h] = buildCount;
+            }
+            lb = &builds[loopAt[h] - 1];
+            lb->backEdges++;
+            // Body: everything that reaches u without passing through h.
+            stamp++;
+            for (int m = 0; m < lb->blockCount; m++)
+                mark[lb->members[m]] = stamp;
+            int top = 0;
+            if (mark[u] != stamp) {
+                mark[u] = stamp;
+                lb->members[lb->blockCount++] = u;
+                stack[top++] = u;
+            }
+            while (top > 0) {
+                int x = stack[--top];
+                for (int p = predStart[x]; p < predStart[x + 1]; p++) {
+                    int y = preds[p];
+                    if (mark[y] != stamp) {
+                        mark[y] = stamp;
+                        lb->members[lb->blockCount++] = y;
+                        stack[top++] = y;
+                    }
+                }
+            }
+        }
+    }
+
+    // Outermost first: later (smaller) loops overwrite, leaving the
+    // innermost loop in each block; a header's owner before its own loop is
+    // assigned is the enclosing loop.
+    qsort(builds, buildCount, sizeof(LoopBuild), compareLoopSize);
+    cfg->loops = (CfgLoop *)xcalloc(buildCount, sizeof(CfgLoop));
+    cfg->loopCount = buildCount;
+    int *parentBuild = (int *)xcalloc(buildCount, sizeof(int));
+    int *owner = (int *)xcalloc(n, sizeof(int));
+    for (int b = 0; b < n; b++)
+        owner[b] = -1;
+    for (int i = 0; i < buildCount; i++) {
+        parentBuild[i] = owner[builds[i].header];
+        for (int m = 0; m < builds[i].blockCount; m++)
+            owner[builds[i].members[m]] = i;
+    }
+    // Publish sorted by header address, remapping indices.
+    int *rank = (int *)xcalloc(buildCount, sizeof(int));
+    for (int i = 0; i < buildCount; i++) {
+        cfg->loops[i].header = builds[i].header;
+        cfg->loops[i].blockCount = builds[i].blockCount;
+        cfg->loops[i].backEdges = builds[i].backEdges;
+        cfg->loops[i].parent = i; // temporarily: the build index
+    }
+    qsort(cfg->loops, buildCount, sizeof(CfgLoop), compareHeader);
+    for (int i = 0; i < buildCount; i++)
+        rank[cfg->loops[i].parent] = i;
+    for (int i = 0; i < buildCount; i++) {
+        int build = cfg->loops[i].parent;
+        cfg->loops[i].parent = parentBuild[build] >= 0 ? rank[parentBuild[build]] : -1;
+    }
+    for (int i = 0; i < buildCount; i++) {
+        int depth = 1;
+        for (int p = cfg->loops[i].parent; p >= 0; p = cfg->loops[p].parent)
+            depth++;
+        cfg->loops[i].depth = depth;
+    }
+    for (int b = 0; b < n; b++)
+        cfg->blocks[b].loop = owner[b] >= 0 ? rank[owner[b]] : -1;
+
+    for (int i = 0; i < buildCount; i++)
+        free(builds[i].members);
+    free(builds);
+    free(loopAt);
+    free(mark);
+    free(stack);
+    free(predStart);
+    free(preds);
+    free(predCount);
+    free(parentBuild);
+    free(owner);
+    free(rank);
+}
+
+Cfg *cfgBuild(const unsigned char *image, size_t size, const uint16_t *entries, int entryCount) {
+    Cfg *cfg = (Cfg *)xcalloc(1, sizeof(Cfg));
+    cfg->image = image;
+    cfg->imageSize = size > 65536 ? 65536 : size;
+    cfg->blockOf = (int *)xcalloc(SLOTS, sizeof(int));
+    for (int s = 0; s < SLOTS; s++)
+        cfg->blockOf[s] = -1;
+
+    uint8_t *decoded = (uint8_t *)xcalloc(SLOTS, 1);
+    uint8_t *leader = (uint8_t *)xcalloc(SLOTS, 1);
+    uint8_t *entry = (uint8_t *)xcalloc(SLOTS, 1);
+    discover(cfg->image, cfg->imageSize, entries, entryCount, decoded, leader, entry);
+    buildBlocks(cfg, decoded, leader, entry);
+    linkBlocks(cfg);
+    computeDominators(cfg);
+    findLoops(cfg);
+    free(decoded);
+    free(leader);
+    free(entry);
+    return cfg;
+}
+
+void cfgFree(Cfg *cfg) {
+    if (!cfg)
+        return;
+    free(cfg->blocks);
+    free(cfg->loops);
+    free(cfg->blockOf);
+    free(cfg);
+}
+
+int cfgBlockAt(const Cfg *cfg, uint16_t pc) {
+    return (pc & 1) ? -1 : cfg->blockOf[pc >> 1];
+}
+
+int cfgDominates(const Cfg *cfg, int a, int b) {
+    for (int x = b; x >= 0; x = cfg->blocks[x].idom) {
+        if (x == a)
+            return 1;
+    }
+    return 0;
+}
+
+static const char *endNames[] = {
+    "fall", "branch", "jump", "call", "indirect", "return", "exit", "halt",
+};
+
+static const char *blockName(const Cfg *cfg, int b, CfgNamer name, char *buf, size_t size) {
+    const char *n = name ? name(cfg->blocks[b].start, buf, size) : NULL;
+    if (!n) {
+        snprintf(buf, size, "0x%04X", cfg->blocks[b].start);
+        n = buf;
+    }
+    return n;
+}
+
+// Write `s` with the characters DOT and JSON strings cannot hold escaped.
+static void writeEscaped(FILE *fp, const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', fp);
+        fputc(*s, fp);
+    }
+}
+
+void cfgWriteDot(const Cfg *cfg, FILE *fp, CfgNamer name) {
+    char buf[128], disasm[128];
+    fprintf(fp, "digraph z16cfg {\n  node [shape=box fontname=\"monospace\" fontsize=10];\n");
+    for (int b = 0; b < cfg->blockCount; b++) {
+        const CfgBlock *blk = &cfg->blocks[b];
+        int isHeader = blk->loop >= 0 && cfg->loops[blk->loop].header == b;
+        fprintf(fp, "  b%d [label=\"", b);
+        writeEscaped(fp, blockName(cfg, b, name, buf, sizeof(buf)));
+        if (blk->loop >= 0)
+            fprintf(fp, "  (loop depth %d)", cfg->loops[blk->loop].depth);
+        fprintf(fp, "\\l");
+        for (uint32_t a = blk->start; a <= blk->last; a += 2) {
+            uint16_t inst = fetch(cfg->image, cfg->imageSize, (uint16_t)a);
+            disassemble(inst, (uint16_t)a, disasm, sizeof(disasm));
+            fprintf(fp, "0x%04X: %04X  ", a, inst);
+            writeEscaped(fp, disasm);
+            fprintf(fp, "\\l");
+        }
+        fprintf(fp, "\"%s%s];\n", blk->isEntry ? " penwidth=2" : "",
+                isHeader ? " style=filled fillcolor=\"#ffe9b3\"" : "");
+    }
+    for (int b = 0; b < cfg->blockCount; b++) {
+        const CfgBlock *blk = &cfg->blocks[b];
+        for (int k = 0; k < 2; k++) {
+            int s = blk->succ[k];
+            if (s < 0)
+                continue;
+            const char *label = blk->end == CFG_END_BRANCH ? (k == 0 ? "T" : "F")
+                              : blk->end == CFG_END_CALL ? "ret" : "";
+            int back = cfgDominates(cfg, s, b);
+            fprintf(fp, "  b%d -> b%d [label=\"%s\"%s%s];\n", b, s, label,
+                    back ? " color=red" : "", blk->end == CFG_END_CALL ? " style=dashed" : "");
+        }
+        if (blk->end == CFG_END_CALL && blk->callee != 0xFFFF && cfgBlockAt(cfg, blk->callee) >= 0)
+            fprintf(fp, "  b%d -> b%d [style=dotted color=blue label=\"call\"];\n", b,
+                    cfgBlockAt(cfg, blk->callee));
+    }
+    fprintf(fp, "}\n");
+}
+
+void cfgWriteJson(const Cfg *cfg, FILE *fp, CfgNamer name) {
+    char buf[128];
+    fprintf(fp, "{\n  \"instructions\": %d,\n  \"blocks\": [\n", cfg->instructionCount);
+    for (int b = 0; b < cfg->blockCount; b++) {
+        const CfgBlock *blk = &cfg->blocks[b];
+        fprintf(fp, "    {\"id\": %d, \"name\": \"", b);
+        writeEscaped(fp, blockName(cfg, b, name, buf, sizeof(buf)));
+        fprintf(fp, "\", \"start\": %u, \"last\": %u, \"count\": %u, \"end\": \"%s\", \"entry\": %s, "
+                "\"succ\": [", blk->start, blk->last, blk->count, endNames[blk->end],
+                blk->isEntry ? "true" : "false");
+        int first = 1;
+        for (int k = 0; k < 2; k++) {
+            if (blk->succ[k] < 0)
+                continue;
+            fprintf(fp, "%s%d", first ? "" : ", ", blk->succ[k]);
+            first = 0;
+        }
+        fprintf(fp, "], \"idom\": %d, \"loop\": %d", blk->idom, blk->loop);
+        if (blk->end == CFG_END_CALL && blk->callee != 0xFFFF)
+            fprintf(fp, ", \"callee\": %u", blk->callee);
+        fprintf(fp, "}%s\n", b + 1 < cfg->blockCount ? "," : "");
+    }
+    fprintf(fp, "  ],\n  \"loops\": [\n");
+    for (int i = 0; i < cfg->loopCount; i++) {
+        const CfgLoop *l = &cfg->loops[i];
+        fprintf(fp, "    {\"id\": %d, \"header\": %d, \"parent\": %d, \"depth\": %d, "
+                "\"blocks\": %d, \"backEdges\": %d}%s\n", i, l->header, l->parent, l->depth,
+                l->blockCount, l->backEdges, i + 1 < cfg->loopCount ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
@@ -0,0 +1,93 @@
+/*
+ * Static control-flow graph recovery for Z16 memory images.
+ *
+ * Starting from a set of entry points, a worklist-driven recursive
+ * disassembly (decoding through z16decode.c, i.e. with the simulator's own
+ * field layout and branch arithmetic) finds every statically reachable
+ * instruction. The instructions are split into basic blocks, then immediate
+ * dominators and natural loops are computed. Calls do not link caller and
+ * callee blocks: a JAL/JALR block falls through to its return point and its
+ * target becomes another entry, so each function is its own region of the
+ * graph.
+ *
+ * Usage:
+ *   Cfg *cfg = cfgBuild(memory, MEM_SIZE, entries, entryCount);
+ *   int b = cfgBlockAt(cfg, pc);
+ *   cfgWriteDot(cfg, stdout, NULL);
+ *   cfgFree(cfg);
+ */
+#ifndef Z16CFG_H
+#define Z16CFG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// How a basic block ends
+typedef enum {
+    CFG_END_FALL,       // runs into the next block (a leader follows)
+    CFG_END_BRANCH,     // conditional branch: taken and fall-through edges
+    CFG_END_JUMP,       // J: one edge
+    CFG_END_CALL,       // JAL/JALR: edge to the return point, callee is an entry
+    CFG_END_INDIRECT,   // JR through a register other than ra: no known edges
+    CFG_END_RETURN,     // JR ra
+    CFG_END_EXIT,       // ecall 3
+    CFG_END_HALT        // invalid encoding or 0x0000: the simulator stops
+} CfgEnd;
+
+typedef struct {
+    uint16_t start;     // address of the first instruction
+    uint16_t last;      // address of the last instruction
+    uint16_t count;     // instructions in the block
+    CfgEnd end;
+    int succ[2];        // successor blocks, -1 if absent; succ[0] is taken/target
+    uint16_t callee;    // JAL target for CFG_END_CALL (0xFFFF if indirect)
+    int isEntry;        // entry point or call target
+    int idom;           // immediate dominator, -1 for entries and unreachable blocks
+    int loop;           // innermost natural loop, -1 if none
+} CfgBlock;
+
+typedef struct {
+    int header;         // block index of the loop header
+    int parent;         // enclosing loop, -1 if outermost
+    int depth;          // 1 for outermost loops
+    int blockCount;     // blocks in the loop, including nested loops
+    int backEdges;      // latches branching back to the header
+} CfgLoop;
+
+typedef struct {
+    const unsigned char *image; // the caller's image, used by the dumps
+    size_t imageSize;
+    CfgBlock *blocks;   // sorted by start address
+    int blockCount;
+    CfgLoop *loops;
+    int loopCount;
+    int edgeCount;
+    int instructionCount;
+    int *blockOf;       // [65536 / 2] block containing each even address, -1 if none
+} Cfg;
+
+// Recover the CFG of `image` (`size` bytes, at most 64 KB, from address 0)
+// reachable from `entries`. The image must outlive the Cfg. Exits on
+// allocation failure; never fails otherwise.
+Cfg *cfgBuild(const unsigned char *image, size_t size, const uint16_t *entries, int entryCount);
+
+void cfgFree(Cfg *cfg);
+
+// Block holding the instruction at `pc`, or -1.
+int cfgBlockAt(const Cfg *cfg, uint16_t pc);
+
+// Non-zero if block `a` dominates block `b`.
+int cfgDominates(const Cfg *cfg, int a, int b);
+
+// Name blocks in dumps; `name` returns a label for an address or NULL.
+typedef const char *(*CfgNamer)(uint16_t addr, char *buf, size_t bufSize);
+
+// Graphviz dump: one node per block with its disassembly, edges labelled by
+// kind, loop headers and latches highlighted.
+void cfgWriteDot(const Cfg *cfg, FILE *fp, CfgNamer name);
+
+// JSON dump of blocks, edges, dominators and loops.
+void cfgWriteJson(const Cfg *cfg, FILE *fp, CfgNamer name);
+
+#endif // Z16CFG_H
@@ -0,0 +1,122 @@
+/*
+ * z16cfg: dump the static control-flow graph of a Z16 machine code file
+ * (library: z16cfg.c).
+ *
+ * Usage:
+ *   z16cfg [-e <entry>]... [--json] [--mext] [--simd] [-o <output_file>] [--debug-info <dbg_file>]
+ *          <machine_code_file>
+ *
+ * The image's entry point (address 0 for a flat .bin) is the entry unless
+ * -e is given. Blocks are named by label when
+ * a debug table (z16asm -g) is found next to the image or named explicitly.
+ * Writes Graphviz DOT by default; a summary goes to stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "z16cfg.h"
+#include "z16decode.h"
+#include "z16debuginfo.h"
+#include "z16image.h"
+
+#define MEM_SIZE 65536
+#define MAX_ENTRIES 256
+
+static unsigned char image[MEM_SIZE];
+
+static const char *labelName(uint16_t addr, char *buf, size_t bufSize) {
+    uint16_t offset;
+    const char *label = debugSymbol(addr, &offset);
+    if (!label)
+        return NULL;
+    if (offset == 0)
+        snprintf(buf, bufSize, "%s", label);
+    else
+        snprintf(buf, bufSize, "%s+0x%X", label, offset);
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    char *filename = NULL;
+    char *outFilename = NULL;
+    char *debugInfoFile = NULL;
+    int json = 0;
+    uint16_t entries[MAX_ENTRIES];
+    int entryCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            if (entryCount == MAX_ENTRIES) {
+                fprintf(stderr, "Error: at most %d entry points\n", MAX_ENTRIES);
+                exit(1);
+            }
+            entries[entryCount++] = (uint16_t)strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "--json") == 0)
+            json = 1;
+        else if (strcmp(argv[i], "--mext") == 0)
+            decodeMulDiv = 1;   // mul/div do not end a block
+        else if (strcmp(argv[i], "--simd") == 0)
+            decodePackedSimd = 1;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outFilename = argv[++i];
+        else if (strcmp(argv[i], "--debug-info") == 0 && i + 1 < argc)
+            debugInfoFile = argv[++i];
+        else if (filename == NULL)
+            filename = argv[i];
+    }
+    if (filename == NULL) {
+        fprintf(stderr, "Usage: %s [-e <entry>]... [--json] [--mext] [--simd] [-o <output_file>] [--debug-info <dbg_file>]\n"
+                "          <machine_code_file>\n", argv[0]);
+        exit(1);
+    }
+
+    uint16_t imageEntry;
+    uint32_t imageEnd;
+    if (imageLoad(filename, image, 0, MEM_SIZE, &imageEntry, &imageEnd) != 0)
+        exit(1);
+    size_t n = imageEnd < MEM_SIZE ? imageEnd : MEM_SIZE;
+    if (debugInfoFile) {
+        if (debugInfoOpen(debugInfoFile, 0) != 0)
+            exit(1);
+    } else {
+        char dbgPath[512];
+        debugInfoPathFor(filename, dbgPath, sizeof(dbgPath));
+        debugInfoOpen(dbgPath, 1);
+    }
+    if (entryCount == 0)
+        entries[entryCount++] = imageEntry;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    // Memory beyond the file reads as zero in the simulator, so analyse the
+    // whole 64 KB.
+    Cfg *cfg = cfgBuild(image, MEM_SIZE, entries, entryCount);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    FILE *out = stdout;
+    if (outFilename && !(out = fopen(outFilename, "w"))) {
+        perror("Error opening output file");
+        exit(1);
+    }
+    if (json)
+        cfgWriteJson(cfg, out, debugInfoLoaded() ? labelName : NULL);
+    else
+        cfgWriteDot(cfg, out, debugInfoLoaded() ? labelName : NULL);
+    if (out != stdout)
+        fclose(out);
+
+    int functions = 0;
+    for (int b = 0; b < cfg->blockCount; b++)
+        functions += cfg->blocks[b].isEntry;
+    fprintf(stderr, "%s: %zu bytes, %d instructions, %d blocks, %d edges, %d entries/functions, "
+            "%d loops (%.2f ms)\n", filename, n, cfg->instructionCount, cfg->blockCount,
+            cfg->edgeCount, functions, cfg->loopCount,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    cfgFree(cfg);
+    debugInfoClose();
+    return 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * Console device of the Z16 simulator.
+ *
+ * Spec syntax (comma separated, any order):
+ *   flush=line|size|exit  when the writer is woken: at every newline, when a
+ *                         quarter of the ring is waiting, or only when the
+ *                         ring is full and at exit (default: line on a
+ *                         terminal, size otherwise)
+ *   buffer=<bytes>        ring size, a power of two; k and m suffixes
+ *                         (default 256k)
+ *
+ * The ring is indexed by free-running 64-bit positions. Only the simulating
+ * thread advances head and only the writer advances tail, so each side
+ * needs nothing more than acquire/release ordering on the other's counter.
+ * flushMark tells the writer how far output is wanted now; it sleeps on a
+ * condition variable while flushMark <= tail. The writerIdle and
+ * producerWaiting flags let each side skip the mutex unless the other is
+ * actually asleep.
+ *
+ * Input: bytes handed to the guest and consoleWait() results are recorded
+ * from consoleMark() on, so that a replay sees exactly the same input
+ * without touching standard input.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "z16sim.h"
+#include "z16console.h"
+#include "z16spec.h"
+
+typedef enum {
+    FLUSH_LINE,
+    FLUSH_SIZE,
+    FLUSH_EXIT
+} FlushPolicy;
+
+static FlushPolicy policy = FLUSH_SIZE;
+static size_t capacity = 256 * 1024;
+static int running = 0;            // writer thread started and not yet joined; stdio otherwise
+static int suppressed = 0;
+
+static char *ring = NULL;
+static uint64_t head = 0;          // simulator thread's copy of its position
+static uint64_t lastRequest = 0;   // head at the last size-policy wake-up
+static _Atomic uint64_t publishedHead;
+static _Atomic uint64_t tail;
+static _Atomic uint64_t flushMark;
+static _Atomic int writerIdle;
+static _Atomic int producerWaiting;
+static int closing = 0;
+
+static unsigned char inBuf[64 * 1024];
+static size_t inLen = 0, inPos = 0;
+static int inEnd = 0;              // standard input is exhausted
+
+// Record for replays (see consoleMark)
+static int recording = 0;
+static int replaying = 0;
+static unsigned char *recordBytes = NULL;
+static size_t recordLen = 0, recordCap = 0, replayPos = 0;
+static uint8_t *recordEvents = NULL;
+static size_t eventLen = 0, eventCap = 0, eventPos = 0;
+
+static pthread_t writerThread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wakeCond = PTHREAD_COND_INITIALIZER;   // writer sleeps here
+static pthread_cond_t spaceCond = PTHREAD_COND_INITIALIZER;  // simulator sleeps here
+
+// -----------------------
+// Writer thread
+// -----------------------
+
+static void drain(void) {
+    uint64_t end = atomic_load_explicit(&publishedHead, memory_order_acquire);
+    uint64_t pos = atomic_load_explicit(&tail, memory_order_relaxed);
+    while (pos < end) {
+        size_t offset = (size_t)(pos & (capacity - 1));
+        size_t n = (size_t)(end - pos);
+        if (n > capacity - offset)
+            n = capacity - offset;
+        ssize_t written = write(STDOUT_FILENO, ring + offset, n);
+        if (written < 0 && errno == EINTR)
+            continue;
+        // Output that cannot be written is dropped rather than blocking the
+        // guest forever.
+        pos += written > 0 ? (uint64_t)written : n;
+        atomic_store(&tail, pos);
+        if (atomic_load(&producerWaiting)) {
+            pthread_mutex_lock(&lock);
+            pthread_cond_broadcast(&spaceCond);
+            pthread_mutex_unlock(&lock);
+        }
+    }
+}
+
+static void *writerMain(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        atomic_store(&writerIdle, 1);
+        while (atomic_load(&flushMark) <= atomic_load(&tail) && !closing)
+            pthread_cond_wait(&wakeCond, &lock);
+        atomic_store(&writerIdle, 0);
+        int last = closing;
+        pthread_mutex_unlock(&lock);
+        drain();
+        if (last)
+            return NULL;
+    }
+}
+
+// -----------------------
+// Simulator side
+// -----------------------
+
+static void requestFlush(void) {
+    atomic_store(&flushMark, head);
+    if (atomic_load(&writerIdle)) {
+        pthread_mutex_lock(&lock);
+        pthread_cond_signal(&wakeCond);
+        pthread_mutex_unlock(&lock);
+    }
+}
+
+// Block until the writer has consumed everything up to `position`.
+static void waitForTail(uint64_t position) {
+    if (atomic_load(&tail) >= position)
+        return;
+    requestFlush();
+    pthread_mutex_lock(&lock);
+    atomic_store(&producerWaiting, 1);
+    while (atomic_load(&tail) < position)
+        pthread_cond_wait(&spaceCond, &lock);
+    atomic_store(&producerWaiting, 0);
+    pthread_mutex_unlock(&lock);
+}
+
+static int consoleItem(const char *key, char *value) {
+    if (strcmp(key, "flush") == 0) {
+        if (strcmp(value, "line") == 0) policy = FLUSH_LINE;
+        else if (strcmp(value, "size") == 0) policy = FLUSH_SIZE;
+        else if (strcmp(value, "exit") == 0) policy = FLUSH_EXIT;
+        else return -1;
+        return 0;
+    }
+    uint64_t bytes;
+    if (strcmp(key, "buffer") != 0 || specBytes(value, &bytes) != 0)
+        return -1;
+    capacity = (size_t)bytes;
+    return 0;
+}
+
+int consoleInit(const char *spec, int synchronous) {
+    policy = isatty(STDOUT_FILENO) ? FLUSH_LINE : FLUSH_SIZE;
+    int status = specParse(spec, "", "console", consoleItem);
+    if (status == 0 && (capacity < 4096 || (capacity & (capacity - 1)) != 0)) {
+        fprintf(stderr, "Error: console buffer must be a power of two of at least 4k\n");
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+
+    if (synchronous)
+        return 0;
+    ring = (char *)malloc(capacity);
+    if (!ring) {
+        perror("malloc");
+        exit(1);
+    }
+    if (pthread_create(&writerThread, NULL, writerMain, NULL) != 0) {
+        fprintf(stderr, "Error: cannot start the console writer thread\n");
+        return -1;
+    }
+    running = 1;
+    atexit(consoleClose);
+    return 0;
+}
+
+void consoleWrite(const char *data, size_t len) {
+    if (suppressed || len == 0)
+        return;
+    if (!running) {
+        fwrite(data, 1, len, stdout);
+        return;
+    }
+    const char *p = data;
+    size_t left = len;
+    while (left > 0) {
+        uint64_t used = head - atomic_load_explicit(&tail, memory_order_acquire);
+        if (used == capacity) {
+            waitForTail(head - capacity + 1);
+            continue;
+        }
+        size_t offset = (size_t)(head & (capacity - 1));
+        size_t n = capacity - (size_t)used;
+        if (n > capacity - offset)
+            n = capacity - offset;
+        if (n > left)
+            n = left;
+        memcpy(ring + offset, p, n);
+        head += n;
+        atomic_store_explicit(&publishedHead, head, memory_order_release);
+        p += n;
+        left -= n;
+    }
+    if (policy == FLUSH_LINE) {
+        if (memchr(data, '\n', len))
+            requestFlush();
+    } else if (policy == FLUSH_SIZE) {
+        if (head - lastRequest >= capacity / 4) {
+            lastRequest = head;
+            requestFlush();
+        }
+    }
+}
+
+void consoleWriteNumber(const char *prefix, uint32_t value) {
+    static const char pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char buf[96];
+    size_t len = strlen(prefix);
+    if (len > sizeof(buf) - 12)
+        len = sizeof(buf) - 12;
+    memcpy(buf, prefix, len);
+    char digits[10];
+    int n = 0;
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        digits[n++] = pairs[pair + 1];
+        digits[n++] = pairs[pair];
+    }
+    if (value >= 10) {
+        digits[n++] = pairs[value * 2 + 1];
+        digits[n++] = pairs[value * 2];
+    } else {
+        digits[n++] = (char)('0' + value);
+    }
+    while (n > 0)
+        buf[len++] = digits[--n];
+    buf[len++] = '\n';
+    consoleWrite(buf, len);
+}
+
+void consoleWriteString(const char *prefix, uint16_t addr) {
+    const char *s = (const char *)&memory[addr];
+    size_t limit = MEM_SIZE - addr;
+    const char *nul = (const char *)memchr(s, 0, limit);
+    consoleWrite(prefix, strlen(prefix));
+    consoleWrite(s, nul ? (size_t)(nul - s) : limit);
+    consoleWrite("\n", 1);
+}
+
+// -----------------------
+// Input
+// -----------------------
+
+static void *growRecord(void *buf, size_t *cap, size_t need) {
+    if (need <= *cap)
+        return buf;
+    size_t newCap = *cap ? *cap * 2 : 4096;
+    while (newCap < need)
+        newCap *= 2;
+    buf = realloc(buf, newCap);
+    if (!buf) {
+        perror("malloc");
+        exit(1);
+    }
+    *cap = newCap;
+    return buf;
+}
+
+// Make the next input byte available; blocks. Returns 0 at end of input.
+static int inputReady(void) {
+    if (replaying)
+        return replayPos < recordLen;
+    if (inPos < inLen)
+        return 1;
+    if (inEnd)
+        return 0;
+    consoleFlush();     // the prompt must be visible before we sleep
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, inBuf, sizeof(inBuf));
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        inEnd = 1;
+        return 0;
+    }
+    inLen = (size_t)n;
+    inPos = 0;
+    return 1;
+}
+
+static int peekByte(void) {
+    if (!inputReady())
+        return -1;
+    return replaying ? recordBytes[replayPos] : inBuf[inPos];
+}
+
+static void consumeBytes(unsigned char *dst, size_t n) {
+    if (replaying) {
+        memcpy(dst, recordBytes + replayPos, n);
+        replayPos += n;
+        return;
+    }
+    memcpy(dst, inBuf + inPos, n);
+    inPos += n;
+    if (recording) {
+        recordBytes = (unsigned char *)growRecord(recordBytes, &recordCap, recordLen + n);
+        memcpy(recordBytes + recordLen, dst, n);
+        recordLen += n;
+    }
+}
+
+// Bytes that can be taken without blocking (at least 1 after inputReady)
+static size_t bytesAvailable(void) {
+    return replaying ? recordLen - replayPos : inLen - inPos;
+}
+
+int consoleReadNumber(uint16_t *value) {
+    int c;
+    unsigned char b;
+    while ((c = peekByte()) == ' ' || c == '\t' || c == '\n' || c == '\r')
+        consumeBytes(&b, 1);
+    int negative = c == '-';
+    if (negative) {
+        consumeBytes(&b, 1);
+        c = peekByte();
+    }
+    if (c < '0' || c > '9') {
+        if (c >= 0)
+            consumeBytes(&b, 1);
+        *value = 0;
+        return 0;
+    }
+    uint16_t v = 0;
+    while (c >= '0' && c <= '9') {
+        consumeBytes(&b, 1);
+        v = (uint16_t)(v * 10 + (c - '0'));
+        c = peekByte();
+    }
+    *value = negative ? (uint16_t)-v : v;
+    return 1;
+}
+
+int consoleReadLine(uint16_t addr, uint32_t size) {
+    unsigned char *dst = &memory[addr];
+    if (size == 0)
+        return 0;
+    if (peekByte() < 0) {
+        *dst = 0;
+        return -1;
+    }
+    uint32_t len = 0;
+    while (len + 1 < size && inputReady()) {
+        const unsigned char *src = replaying ? recordBytes + replayPos : inBuf + inPos;
+        size_t n = bytesAvailable();
+        if (n > size - 1 - len)
+            n = size - 1 - len;
+        const unsigned char *newline = (const unsigned char *)memchr(src, '\n', n);
+        if (newline) {
+            size_t take = (size_t)(newline - src);
+            consumeBytes(dst + len, take);
+            len += (uint32_t)take;
+            unsigned char b;
+            consumeBytes(&b, 1);
+            break;
+        }
+        consumeBytes(dst + len, n);
+        len += (uint32_t)n;
+    }
+    dst[len] = 0;
+    return (int)len;
+}
+
+uint32_t consoleReadBytes(uint16_t addr, uint32_t count) {
+    uint32_t done = 0;
+    while (done < count && inputReady()) {
+        size_t n = bytesAvailable();
+        if (n > count - done)
+            n = count - done;
+        consumeBytes(&memory[addr + done], n);
+        done += (uint32_t)n;
+    }
+    return done;
+}
+
+int consoleWait(uint32_t timeoutMs) {
+    if (replaying)
+        return eventPos < eventLen ? recordEvents[eventPos++] : CONSOLE_EVENT_TIMER;
+    int event = CONSOLE_EVENT_INPUT;
+    if (inPos == inLen && !inEnd) {
+        consoleFlush();
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+        int r;
+        do {
+            r = poll(&pfd, 1, timeoutMs ? (int)timeoutMs : -1);
+        } while (r < 0 && errno == EINTR);
+        event = r > 0 ? CONSOLE_EVENT_INPUT : CONSOLE_EVENT_TIMER;
+    }
+    if (recording) {
+        recordEvents = (uint8_t *)growRecord(recordEvents, &eventCap, eventLen + 1);
+        recordEvents[eventLen++] = (uint8_t)event;
+    }
+    return event;
+}
+
+void consoleMark(void) {
+    recording = 1;
+    recordLen = 0;
+    eventLen = 0;
+}
+
+// -----------------------
+// Control
+// -----------------------
+
+void consoleFlush(void) {
+    if (running)
+        waitForTail(head);
+    else
+        fflush(stdout);
+}
+
+void consoleSuppress(int on) {
+    if (on)
+        consoleFlush();
+    suppressed = on;
+    replaying = on && recording;
+    replayPos = 0;
+    eventPos = 0;
+}
+
+void consoleClose(void) {
+    if (!running) {
+        fflush(stdout);
+        return;
+    }
+    atomic_store(&flushMark, head);
+    pthread_mutex_lock(&lock);
+    closing = 1;
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writerThread, NULL);
+    running = 0;
+    free(ring);
+    ring = NULL;
+    fflush(stdout);     // the simulator's own messages follow the guest's output
+}
@@ -0,0 +1,71 @@
+/*
+ * Console device of the Z16 simulator: the I/O behind the ecall services.
+ *
+ * Guest output is appended to a single-producer ring buffer without locks
+ * or system calls; a writer thread drains it to standard output with large
+ * write() calls. When the flush policy asks for it (every newline, a
+ * quarter of the ring, or only when the ring is full) the simulating thread
+ * wakes the writer, taking a mutex only if the writer is asleep.
+ *
+ * While the text trace is on, output goes through stdio instead so that it
+ * stays in order with the trace lines.
+ *
+ * Input comes from a buffered reader on standard input. Reads and
+ * consoleWait() block in read() or poll(), so a guest waiting for input
+ * costs no host CPU; pending output is flushed before blocking.
+ */
+#ifndef Z16CONSOLE_H
+#define Z16CONSOLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parse a spec such as "flush=line,buffer=256k" (or "default") and start
+// the writer unless `synchronous`. Returns 0 on success.
+int consoleInit(const char *spec, int synchronous);
+
+// Append guest output.
+void consoleWrite(const char *data, size_t len);
+
+// Append `prefix`, the decimal value and a newline as one write.
+void consoleWriteNumber(const char *prefix, uint32_t value);
+
+// Append `prefix`, the NUL-terminated guest string at `addr` (cut at the
+// top of memory) and a newline.
+void consoleWriteString(const char *prefix, uint16_t addr);
+
+// Read a decimal integer (optionally negative, truncated to 16 bits) after
+// any white space. Returns 0 at end of input or if something else follows;
+// the offending character is consumed.
+int consoleReadNumber(uint16_t *value);
+
+// Read a line into guest memory at addr: at most size - 1 bytes and a NUL;
+// the newline is consumed but not stored, and a longer line is continued by
+// the next call. Returns the length, or -1 at end of input.
+int consoleReadLine(uint16_t addr, uint32_t size);
+
+// Read up to count bytes into guest memory at addr, fewer only at end of
+// input. Returns the number read.
+uint32_t consoleReadBytes(uint16_t addr, uint32_t count);
+
+#define CONSOLE_EVENT_INPUT 1   // input available, or end of input
+#define CONSOLE_EVENT_TIMER 2   // the timeout passed
+
+// Sleep until input is available or timeoutMs pass (0: no limit).
+int consoleWait(uint32_t timeoutMs);
+
+// Wait until everything appended so far has been written.
+void consoleFlush(void);
+
+// Start recording what the input calls return, discarding the previous
+// record (co-simulation checkpoints).
+void consoleMark(void);
+
+// While on, flush once and then drop all output, and answer input calls
+// again from the record since consoleMark() (co-simulation replay).
+void consoleSuppress(int on);
+
+// Flush and stop the writer. Safe to call more than once.
+void consoleClose(void);
+
+#endif // Z16CONSOLE_H
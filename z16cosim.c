@@ -0,0 +1,631 @@
+/*
+ * Lockstep differential co-simulation for the Z16 simulator.
+ *
+ * Spec syntax (comma separated, any order):
+ *   interval=<n>  instructions between checkpoints (default 65536); a
+ *                 divergence is replayed from at most this far back
+ *
+ * The reference interpreter below implements the semantics of z16sim.c's
+ * executeInstruction, quirks included (unsigned I-type immediates,
+ * zero-extended SRA and signed compares, 4-byte SW/LW, halting on invalid
+ * encodings), but on its own state and with every address wrapped to
+ * 16 bits. Where z16sim.c relies on undefined C behaviour it is defined
+ * here: shift counts of 32 or more give 0, and accesses running past 0xFFFF
+ * wrap to address 0 instead of overrunning the memory array. The engine
+ * under test is reported as divergent when it does otherwise. Input ecalls
+ * are the exception: their results (a0, a1 and the buffer) are copied from
+ * the engine, and the console replays the same input on a rollback.
+ *
+ * Memory hash: the sum over all bytes of mix(address, value), kept per page.
+ * A store subtracts the old bytes' terms and adds the new ones. The engine's
+ * side is maintained from its reported stores (cosimAccess), so a store the
+ * engine makes without reporting it would escape the hash; checkpoints
+ * therefore compare the full memories before accepting the state.
+ *
+ * Registers are compared directly: eight words cost less to compare than
+ * any hash would cost to maintain.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "z16sim.h"
+#include "z16cosim.h"
+#include "z16debuginfo.h"
+#include "z16console.h"
+#include "z16bulk.h"
+#include "z16accel.h"
+#include "z16spec.h"
+
+#define PAGE_BITS 8
+#define PAGE_COUNT (MEM_SIZE >> PAGE_BITS)
+#define MAX_PENDING_STORES 4
+#define MAX_REPORTED_BYTES 8
+
+typedef struct {
+    uint64_t page[PAGE_COUNT];
+    uint64_t total;
+} MemHash;
+
+typedef struct {
+    uint16_t regs[8];
+    uint16_t pc;
+    unsigned char mem[MEM_SIZE];
+} RefState;
+
+static uint64_t checkpointInterval = 65536;
+static CosimStep engineStep = NULL;
+
+static RefState ref;
+static MemHash refHash, engineHash;
+static uint8_t dirty[PAGE_COUNT];        // pages the reference wrote since the last checkpoint
+
+static RefState checkpointState;         // last state both engines agreed on
+static uint64_t checkpointStep = 0;
+
+static uint64_t steps = 0;
+static uint64_t comparisons = 0;
+static uint64_t checkpoints = 0;
+static int diverged = 0;
+
+static uint16_t pendingAddr[MAX_PENDING_STORES];
+static uint32_t pendingSize[MAX_PENDING_STORES];
+static int pendingCount = 0;
+
+// -----------------------
+// Memory hashing
+// -----------------------
+
+static inline uint64_t byteTerm(uint16_t addr, uint8_t value) {
+    uint64_t x = (((uint64_t)addr << 8) | value) + 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline void hashRemove(MemHash *h, uint16_t addr, uint8_t value) {
+    uint64_t t = byteTerm(addr, value);
+    h->page[addr >> PAGE_BITS] -= t;
+    h->total -= t;
+}
+
+static inline void hashAdd(MemHash *h, uint16_t addr, uint8_t value) {
+    uint64_t t = byteTerm(addr, value);
+    h->page[addr >> PAGE_BITS] += t;
+    h->total += t;
+}
+
+static void hashImage(MemHash *h, const unsigned char *mem) {
+    memset(h, 0, sizeof(*h));
+    for (uint32_t a = 0; a < MEM_SIZE; a++)
+        hashAdd(h, (uint16_t)a, mem[a]);
+}
+
+// -----------------------
+// Reference interpreter
+// -----------------------
+
+static inline uint8_t refLoad(uint16_t addr) {
+    return ref.mem[addr];
+}
+
+static inline void refStore(uint16_t addr, uint8_t value) {
+    hashRemove(&refHash, addr, ref.mem[addr]);
+    hashAdd(&refHash, addr, value);
+    ref.mem[addr] = value;
+    dirty[addr >> PAGE_BITS] = 1;
+}
+
+static inline uint16_t shiftLeft(uint16_t value, uint16_t count) {
+    return count < 32 ? (uint16_t)((uint32_t)value << count) : 0;
+}
+
+static inline uint16_t shiftRight(uint16_t value, uint16_t count) {
+    return count < 32 ? (uint16_t)(value >> count) : 0;
+}
+
+#define REF_HALTED 0
+#define REF_RUNNING 1
+#define REF_INPUT 2     // an input ecall: results come from the engine
+
+static uint8_t inputService;   // service of the last REF_INPUT step
+
+// Bulk memory ecall as the byte loops it replaces, so the engine's
+// vectorised pieces are checked against them.
+static void refBulk(void) {
+    static uint8_t staging[MEM_SIZE];
+    uint16_t *r = ref.regs;
+    uint16_t a = r[REG_A0], b = r[REG_A1];
+    uint32_t n = r[REG_T1];
+    switch (r[REG_T0]) {
+    case BULK_COPY:
+        for (uint32_t i = 0; i < n; i++)
+            refStore((uint16_t)(a + i), refLoad((uint16_t)(b + i)));
+        break;
+    case BULK_MOVE:
+        for (uint32_t i = 0; i < n; i++)
+            staging[i] = refLoad((uint16_t)(b + i));
+        for (uint32_t i = 0; i < n; i++)
+            refStore((uint16_t)(a + i), staging[i]);
+        break;
+    case BULK_SET:
+        for (uint32_t i = 0; i < n; i++)
+            refStore((uint16_t)(a + i), (uint8_t)b);
+        break;
+    case BULK_COMPARE:
+        r[REG_A0] = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            uint8_t x = refLoad((uint16_t)(a + i)), y = refLoad((uint16_t)(b + i));
+            if (x != y) {
+                r[REG_A0] = (uint16_t)(x - y);
+                break;
+            }
+        }
+        break;
+    case BULK_STRLEN:
+        r[REG_A0] = 0xFFFF;
+        for (uint32_t i = 0; i < MEM_SIZE; i++)
+            if (refLoad((uint16_t)(a + i)) == 0) {
+                r[REG_A0] = (uint16_t)i;
+                break;
+            }
+        break;
+    }
+}
+
+// Pages an accelerator kernel announced writes to; their hash terms are
+// dropped before the kernel runs and recomputed after.
+static uint8_t accelPages[PAGE_COUNT];
+
+static void refAccelObserve(uint16_t addr, int size, int isWrite) {
+    if (!isWrite || size <= 0)
+        return;
+    for (uint32_t p = addr >> PAGE_BITS; p <= (uint32_t)(addr + size - 1) >> PAGE_BITS; p++)
+        if (!accelPages[p]) {
+            accelPages[p] = dirty[p] = 1;
+            refHash.total -= refHash.page[p];
+            refHash.page[p] = 0;
+        }
+}
+
+// Accelerator ecall through the kernels' reference implementations, so the
+// engine's native kernels are checked against them.
+static void refAccel(void) {
+    AccelMachine m = {ref.regs, ref.mem, refAccelObserve};
+    accelReference(&m);
+    for (uint32_t p = 0; p < PAGE_COUNT; p++)
+        if (accelPages[p]) {
+            accelPages[p] = 0;
+            for (uint32_t a = p << PAGE_BITS; a < (p + 1) << PAGE_BITS; a++)
+                hashAdd(&refHash, (uint16_t)a, ref.mem[a]);
+        }
+}
+
+// Execute one instruction; returns REF_HALTED when the simulator would halt
+// (pc is then left on the halting instruction).
+// Packed-byte operations one lane at a time, independently of the SWAR code
+// in z16simd.h.
+static uint16_t refPacked(uint8_t op, uint16_t a, uint16_t b) {
+    if (op == SIMD_SWAPB)
+        return (uint16_t)(b >> 8 | b << 8);
+    if (op == SIMD_PACKLB)
+        return (uint16_t)((a & 0xFF) | (b & 0xFF) << 8);
+    if (op == SIMD_PACKHB)
+        return (uint16_t)(a >> 8 | (b & 0xFF00));
+    uint16_t result = 0;
+    for (int lane = 0; lane < 2; lane++) {
+        int ua = (a >> (8 * lane)) & 0xFF, ub = (b >> (8 * lane)) & 0xFF;
+        int sa = (int8_t)ua, sb = (int8_t)ub, v;
+        switch (op) {
+        case SIMD_ADDB: v = ua + ub; break;
+        case SIMD_SUBB: v = ua - ub; break;
+        case SIMD_ADDSB: v = sa + sb; v = v > 127 ? 127 : v < -128 ? -128 : v; break;
+        case SIMD_SUBSB: v = sa - sb; v = v > 127 ? 127 : v < -128 ? -128 : v; break;
+        case SIMD_ADDUSB: v = ua + ub > 255 ? 255 : ua + ub; break;
+        case SIMD_SUBUSB: v = ua < ub ? 0 : ua - ub; break;
+        case SIMD_MINSB: v = sa < sb ? sa : sb; break;
+        case SIMD_MAXSB: v = sa > sb ? sa : sb; break;
+        case SIMD_MINUB: v = ua < ub ? ua : ub; break;
+        case SIMD_MAXUB: v = ua > ub ? ua : ub; break;
+        case SIMD_CMPEQB: v = ua == ub ? 0xFF : 0; break;
+        default: v = sa < sb ? 0xFF : 0; break; // SIMD_CMPLTB
+        }
+        result |= (uint16_t)((v & 0xFF) << (8 * lane));
+    }
+    return result;
+}
+
+static int refStep(void) {
+    uint16_t inst = (uint16_t)(refLoad(ref.pc) | (refLoad((uint16_t)(ref.pc + 1)) << 8));
+    uint16_t *r = ref.regs;
+    if (inst == 0x0000)
+        return 0;
+
+    uint8_t funct3 = (inst >> 3) & 0x7;
+    uint8_t f6 = (inst >> 6) & 0x7;     // rs1 / rd
+    uint8_t f9 = (inst >> 9) & 0x7;     // rs2
+    uint8_t imm4 = (inst >> 12) & 0xF;
+
+    switch (inst & 0x7) {
+    case 0x0: // R-type
+        switch (funct3) {
+        case 0x0:
+            switch (imm4) {
+            case 0x0: r[f6] += r[f9]; break;
+            case 0x1: r[f6] -= r[f9]; break;
+            case 0x4: ref.pc = r[f6]; break;
+            case 0x8: r[f9] = ref.pc; ref.pc = r[f6]; break;
+            default: return 0;
+            }
+            break;
+        case 0x3:
+            switch (imm4) {
+            case 0x2: r[f6] = shiftLeft(r[f6], r[f9]); break;
+            case 0x4:
+            case 0x8: r[f6] = shiftRight(r[f6], r[f9]); break; // SRA of a zero-extended value
+            default: return 0;
+            }
+            break;
+        case SIMD_FUNCT3:
+            if (!decodePackedSimd || imm4 == 0)
+                return 0;
+            r[f6] = refPacked(imm4, r[f6], r[f9]);
+            break;
+        case MULDIV_FUNCT3: {
+            if (!decodeMulDiv)
+                return 0;
+            int32_t a = (int16_t)r[f6], b = (int16_t)r[f9];
+            uint32_t ua = r[f6], ub = r[f9];
+            switch (imm4) {
+            case MULDIV_MUL: r[f6] = (uint16_t)(ua * ub); break;
+            case MULDIV_MULH: r[f6] = (uint16_t)((uint32_t)(a * b) >> 16); break;
+            case MULDIV_MULHU: r[f6] = (uint16_t)(ua * ub >> 16); break;
+            case MULDIV_DIV: r[f6] = b ? (uint16_t)(a / b) : 0xFFFF; break;
+            case MULDIV_DIVU: r[f6] = ub ? (uint16_t)(ua / ub) : 0xFFFF; break;
+            case MULDIV_REM: r[f6] = b ? (uint16_t)(a % b) : (uint16_t)ua; break;
+            case MULDIV_REMU: r[f6] = ub ? (uint16_t)(ua % ub) : (uint16_t)ua; break;
+            default: return 0;
+            }
+            break;
+        }
+        case 0x4: r[f6] |= r[f9]; break;
+        case 0x5: r[f6] &= r[f9]; break;
+        case 0x6: r[f6] ^= r[f9]; break;
+        case 0x7: r[f6] = r[f6] < r[f9]; break;
+        default: return 0;
+        }
+        break;
+
+    case 0x1: { // I-type, unsigned 7-bit immediate
+        uint16_t imm7 = (inst >> 9) & 0x7F;
+        switch (funct3) {
+        case 0x0: r[f6] += imm7; break;
+        case 0x1:
+        case 0x2: r[f6] = r[f6] < imm7; break;
+        case 0x3:
+            switch ((imm7 >> 5) & 0x3) {
+            case 0x1: r[f6] = shiftLeft(r[f6], imm7 & 0x1F); break;
+            case 0x2:
+            case 0x3: r[f6] = shiftRight(r[f6], imm7 & 0x1F); break;
+            default: return 0;
+            }
+            break;
+        case 0x4: r[f6] |= imm7; break;
+        case 0x5: r[f6] &= imm7; break;
+        case 0x6: r[f6] ^= imm7; break;
+        case 0x7: r[f6] = imm7; break;
+        }
+        break;
+    }
+
+    case 0x2: { // branches; signed compares see zero-extended registers
+        int8_t offset = (int8_t)(imm4 << 1);
+        if (imm4 & 0x8) offset |= (int8_t)0xF0;
+        int taken = 0;
+        switch (funct3) {
+        case 0x0: taken = r[f6] == r[f9]; break;
+        case 0x1: taken = r[f6] != r[f9]; break;
+        case 0x2: taken = r[f6] == 0; break;
+        case 0x3: taken = r[f6] != 0; break;
+        case 0x4:
+        case 0x6: taken = r[f6] < r[f9]; break;
+        case 0x5:
+        case 0x7: taken = r[f6] >= r[f9]; break;
+        }
+        if (taken)
+            ref.pc = (uint16_t)(ref.pc + offset);
+        break;
+    }
+
+    case 0x3: { // stores; the "sign extension" only sets bits 4-7
+        uint16_t addr = (uint16_t)(r[f6] + (imm4 & 0x8 ? imm4 | 0xF0 : imm4));
+        if (funct3 == 0x0) {
+            refStore(addr, (uint8_t)r[f9]);
+        } else if (funct3 == 0x1) {
+            refStore(addr, (uint8_t)r[f9]);
+            refStore((uint16_t)(addr + 1), (uint8_t)(r[f9] >> 8));
+            refStore((uint16_t)(addr + 2), 0);
+            refStore((uint16_t)(addr + 3), 0);
+        } else {
+            return 0;
+        }
+        break;
+    }
+
+    case 0x4: { // loads: rd in bits 6-8, base in bits 9-11
+        uint16_t addr = (uint16_t)(r[f9] + (imm4 & 0x8 ? imm4 | 0xF0 : imm4));
+        if (funct3 == 0x0)
+            r[f6] = (uint16_t)(int8_t)refLoad(addr);
+        else if (funct3 == 0x1)
+            r[f6] = (uint16_t)(refLoad(addr) | (refLoad((uint16_t)(addr + 1)) << 8));
+        else if (funct3 == 0x4)
+            r[f6] = refLoad(addr);
+        else
+            return 0;
+        break;
+    }
+
+    case 0x5: { // J / JAL
+        int32_t offset = (int32_t)((((inst >> 9) & 0x3F) << 3) | funct3);
+        if (offset & 0x100)
+            offset |= (int32_t)0xFFFFFFE0;
+        uint16_t target = (uint16_t)(ref.pc + offset * 2);
+        if (inst & 0x8000)
+            r[f6] = (uint16_t)(ref.pc + 4);
+        ref.pc = target;
+        break;
+    }
+
+    case 0x6: { // JLUI / AUIPC: only I[9:7] survives the shift by 12
+        uint16_t upper = (uint16_t)(funct3 << 12);
+        r[f6] = (inst & 0x8000) ? (uint16_t)(ref.pc + upper) : upper;
+        break;
+    }
+
+    case 0x7: { // ecall: exit halts, input services change a0/a1/memory
+        uint8_t service = (inst >> 3) & 0xF;
+        if (service == ECALL_EXIT)
+            return REF_HALTED;
+        if (service == ECALL_BULK)
+            refBulk();
+        if (service == ECALL_ACCEL)
+            refAccel();
+        if (service >= ECALL_READ_INT && service <= ECALL_WAIT) {
+            inputService = service;
+            ref.pc = (uint16_t)(ref.pc + 2);
+            return REF_INPUT;
+        }
+        break;
+    }
+    }
+    ref.pc = (uint16_t)(ref.pc + 2);
+    return 1;
+}
+
+// Input cannot be predicted: take what the engine read. The reference still
+// holds the ecall arguments, so it knows which bytes may have changed.
+static void importInput(void) {
+    uint16_t *r = ref.regs;
+    if (inputService == ECALL_READ_LINE || inputService == ECALL_READ_BYTES) {
+        uint32_t size = r[REG_A1];
+        if (size > (uint32_t)MEM_SIZE - r[REG_A0])
+            size = MEM_SIZE - r[REG_A0];
+        for (uint32_t i = 0; i < size; i++) {
+            uint16_t a = (uint16_t)(r[REG_A0] + i);
+            if (ref.mem[a] != memory[a])
+                refStore(a, memory[a]);
+        }
+    }
+    r[REG_A0] = regs[REG_A0];
+    if (inputService == ECALL_READ_INT)
+        r[REG_A1] = regs[REG_A1];
+}
+
+// -----------------------
+// Co-simulation
+// -----------------------
+
+static int cosimItem(const char *key, char *value) {
+    if (strcmp(key, "interval") != 0)
+        return -1;
+    checkpointInterval = strtoull(value, NULL, 0);
+    return 0;
+}
+
+int cosimInit(const char *spec, CosimStep step) {
+    int status = specParse(spec, "interval=65536", "co-simulation", cosimItem);
+    if (status == 0 && checkpointInterval < 1) {
+        fprintf(stderr, "Error: co-simulation needs interval >= 1\n");
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+
+    engineStep = step;
+    memcpy(ref.regs, regs, sizeof(ref.regs));
+    ref.pc = pc;
+    memcpy(ref.mem, memory, MEM_SIZE);
+    hashImage(&refHash, ref.mem);
+    engineHash = refHash;
+    checkpointState = ref;
+    consoleMark();
+    return 0;
+}
+
+void cosimAccess(uint16_t addr, int size, int isWrite) {
+    if (!isWrite || pendingCount == MAX_PENDING_STORES)
+        return;
+    for (int i = 0; i < size; i++) {
+        uint16_t a = (uint16_t)(addr + i);
+        hashRemove(&engineHash, a, memory[a]);
+    }
+    pendingAddr[pendingCount] = addr;
+    pendingSize[pendingCount] = (uint32_t)size;
+    pendingCount++;
+}
+
+// Fold the bytes the engine just stored into its hash.
+static void settleStores(void) {
+    for (int p = 0; p < pendingCount; p++)
+        for (uint32_t i = 0; i < pendingSize[p]; i++) {
+            uint16_t a = (uint16_t)(pendingAddr[p] + i);
+            hashAdd(&engineHash, a, memory[a]);
+        }
+    pendingCount = 0;
+}
+
+static int statesEqual(int engineRunning, int refRunning) {
+    return engineRunning == refRunning && pc == ref.pc &&
+           memcmp(regs, ref.regs, sizeof(ref.regs)) == 0;
+}
+
+// Accept the current state as a rollback point if the memories really
+// agree, copying only the pages written since the previous checkpoint.
+static int takeCheckpoint(void) {
+    if (memcmp(memory, ref.mem, MEM_SIZE) != 0)
+        return 0;
+    for (int p = 0; p < PAGE_COUNT; p++)
+        if (dirty[p]) {
+            memcpy(&checkpointState.mem[p << PAGE_BITS], &ref.mem[p << PAGE_BITS], 1 << PAGE_BITS);
+            dirty[p] = 0;
+        }
+    memcpy(checkpointState.regs, ref.regs, sizeof(ref.regs));
+    checkpointState.pc = ref.pc;
+    checkpointStep = steps;
+    checkpoints++;
+    consoleMark();
+    return 1;
+}
+
+static void printDifferences(int engineRunning, int refRunning) {
+    fprintf(stderr, "  %-12s %10s %10s\n", "", "engine", "reference");
+    if (engineRunning != refRunning)
+        fprintf(stderr, "  %-12s %10s %10s\n", "halted", engineRunning ? "no" : "yes", refRunning ? "no" : "yes");
+    if (pc != ref.pc)
+        fprintf(stderr, "  %-12s     0x%04X     0x%04X\n", "pc", pc, ref.pc);
+    for (int i = 0; i < 8; i++)
+        if (regs[i] != ref.regs[i])
+            fprintf(stderr, "  %-12s %10u %10u\n", regNames[i], regs[i], ref.regs[i]);
+    int shown = 0;
+    for (uint32_t a = 0; a < MEM_SIZE && shown < MAX_REPORTED_BYTES; a++)
+        if (memory[a] != ref.mem[a]) {
+            char label[24];
+            snprintf(label, sizeof(label), "mem[0x%04X]", a);
+            fprintf(stderr, "  %-12s       0x%02X       0x%02X\n", label, memory[a], ref.mem[a]);
+            shown++;
+        }
+}
+
+// Roll both engines back to the checkpoint and step them together, comparing
+// everything after each instruction, up to the step where the mismatch was
+// seen. Program output is discarded meanwhile.
+static void replay(uint64_t seenAt) {
+    consoleSuppress(1);
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (savedStdout >= 0 && devNull >= 0)
+        dup2(devNull, STDOUT_FILENO);
+    if (devNull >= 0)
+        close(devNull);
+    int savedTrace = traceEnabled;
+    traceEnabled = 0;
+
+    memcpy(memory, checkpointState.mem, MEM_SIZE);
+    memcpy(regs, checkpointState.regs, sizeof(regs));
+    pc = checkpointState.pc;
+    ref = checkpointState;
+
+    uint64_t step = checkpointStep;
+    uint16_t instPc = pc, inst = 0;
+    int engineRunning = 1, refRunning = 1, found = 0;
+    while (step < seenAt && !found) {
+        instPc = pc;
+        inst = (uint16_t)(memory[pc] | (memory[(uint16_t)(pc + 1)] << 8));
+        engineRunning = engineStep();
+        refRunning = refStep();
+        if (refRunning == REF_INPUT) {
+            importInput();
+            refRunning = REF_RUNNING;
+        }
+        step++;
+        found = !statesEqual(engineRunning, refRunning) || memcmp(memory, ref.mem, MEM_SIZE) != 0;
+        if (!engineRunning && !found)
+            break;
+    }
+
+    fflush(stdout);
+    consoleSuppress(0);
+    traceEnabled = savedTrace;
+    if (savedStdout >= 0) {
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+
+    if (!found) {
+        fprintf(stderr, "cosim: replay from instruction %llu did not reproduce the divergence "
+                "(is the engine deterministic?)\n", (unsigned long long)checkpointStep);
+        return;
+    }
+    char text[128], name[96], where[96];
+    disassemble(inst, instPc, text, sizeof(text));
+    fprintf(stderr, "cosim: first divergent instruction is #%llu at 0x%04X", (unsigned long long)step, instPc);
+    if (debugInfoLoaded())
+        fprintf(stderr, " %s %s", debugName(instPc, name, sizeof(name)), debugLocation(instPc, where, sizeof(where)));
+    fprintf(stderr, "\n    %s\n", text);
+    printDifferences(engineRunning, refRunning);
+}
+
+static void reportDivergence(uint16_t instPc, int engineRunning, int refRunning) {
+    diverged = 1;
+    fprintf(stderr, "cosim: engines disagree after instruction %llu (block ending at 0x%04X)",
+            (unsigned long long)steps, instPc);
+    if (engineHash.total != refHash.total) {
+        fprintf(stderr, "; memory pages differ:");
+        for (int p = 0; p < PAGE_COUNT; p++)
+            if (engineHash.page[p] != refHash.page[p])
+                fprintf(stderr, " 0x%02X", p);
+    } else if (!statesEqual(engineRunning, refRunning)) {
+        fprintf(stderr, "; registers or pc differ");
+    } else {
+        fprintf(stderr, "; memory differs outside the engine's reported stores");
+    }
+    fprintf(stderr, "\n");
+    replay(steps);
+}
+
+int cosimInstruction(uint16_t instPc, int running) {
+    if (pendingCount)
+        settleStores();
+    int refRunning = refStep();
+    if (refRunning == REF_INPUT) {
+        importInput();
+        refRunning = REF_RUNNING;
+    }
+    steps++;
+    if (running && refRunning && pc == (uint16_t)(instPc + 2))
+        return 1;   // not a block boundary
+
+    comparisons++;
+    if (!statesEqual(running, refRunning) || engineHash.total != refHash.total ||
+        (steps - checkpointStep >= checkpointInterval && !takeCheckpoint())) {
+        reportDivergence(instPc, running, refRunning);
+        return 0;
+    }
+    return 1;
+}
+
+int cosimReport(void) {
+    if (!diverged && memcmp(memory, ref.mem, MEM_SIZE) != 0) {
+        // The last block was compared by hash only; give unreported stores
+        // one more chance to show up.
+        reportDivergence(pc, 1, 1);
+    }
+    fprintf(stderr, "cosim: %llu instructions, %llu block comparisons, %llu checkpoints: %s\n",
+            (unsigned long long)steps, (unsigned long long)comparisons, (unsigned long long)checkpoints,
+            diverged ? "DIVERGED" : "engine matches the reference");
+    return diverged;
+}
@@ -0,0 +1,38 @@
+/*
+ * Lockstep differential co-simulation for the Z16 simulator.
+ *
+ * A self-contained reference interpreter with its own registers and memory
+ * runs one instruction for every instruction the simulator's engine
+ * retires. Both sides keep an incrementally updated hash of memory, one per
+ * 256-byte page plus their sum, so the states are compared in O(1) at every
+ * block boundary (taken control transfer or halt) rather than byte by byte.
+ * Checkpoints of the agreed state are taken periodically; on a mismatch
+ * both engines are rolled back to the last one and replayed instruction by
+ * instruction, with full state comparison and program output suppressed,
+ * to name the first instruction on which they differ.
+ */
+#ifndef Z16COSIM_H
+#define Z16COSIM_H
+
+#include <stdint.h>
+
+// Re-executes one instruction of the engine under test at the current pc,
+// without instrumentation. Returns 0 when the engine halts.
+typedef int (*CosimStep)(void);
+
+// Parse a spec such as "interval=65536" (or "default") and copy the loaded
+// memory image and registers. Returns 0 on success.
+int cosimInit(const char *spec, CosimStep step);
+
+// Record a data access of the instruction being executed; must be called
+// before a store modifies memory.
+void cosimAccess(uint16_t addr, int size, int isWrite);
+
+// Step the reference after the engine retired the instruction at instPc.
+// Returns 0 if the engines have diverged (the run should stop).
+int cosimInstruction(uint16_t instPc, int running);
+
+// Print the verdict to stderr. Returns 0 if the engines agreed throughout.
+int cosimReport(void);
+
+#endif // Z16COSIM_H
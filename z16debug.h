@@ -0,0 +1,48 @@
+/*
+ * Z16 debug line table (.dbg), written by z16asm -g and read by the
+ * simulator and the trace decoder through z16debuginfo.c.
+ *
+ * All integers are little-endian; every table is sorted by address so a
+ * reader can map the file and binary-search it in place.
+ *
+ *   Header (32 bytes)
+ *     "Z16DEBUG"         magic
+ *     u16 version        DEBUG_VERSION
+ *     u16 reserved
+ *     u32 fileCount
+ *     u32 lineCount
+ *     u32 symbolCount
+ *     u32 stringBytes
+ *     u32 reserved
+ *
+ *   Files   fileCount x { u32 nameOffset }
+ *   Lines   lineCount x { u16 address, u16 size, u32 lineNo, u16 file, u16 section }
+ *           one entry per source line that emits code or data
+ *   Symbols symbolCount x { u16 address, u16 section, u32 nameOffset }
+ *   Strings stringBytes of NUL-terminated names, offsets relative to the
+ *           start of the string table
+ */
+#ifndef Z16DEBUG_H
+#define Z16DEBUG_H
+
+#include <stdint.h>
+
+#define DEBUG_MAGIC          "Z16DEBUG"
+#define DEBUG_VERSION        1
+#define DEBUG_HEADER_BYTES   32
+#define DEBUG_FILE_BYTES     4
+#define DEBUG_LINE_BYTES     12
+#define DEBUG_SYMBOL_BYTES   8
+
+#define DEBUG_SECTION_TEXT   1
+#define DEBUG_SECTION_DATA   2
+
+static inline uint16_t debugGet16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t debugGet32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif // Z16DEBUG_H
@@ -0,0 +1,185 @@
+/*
+ * Read-only access to a Z16 debug line table (format: z16debug.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "z16debug.h"
+#include "z16debuginfo.h"
+
+static const unsigned char *image = NULL;
+static size_t imageBytes = 0;
+static uint32_t fileCount = 0, lineCount = 0, symbolCount = 0, stringBytes = 0;
+static const unsigned char *files = NULL;
+static const unsigned char *lines = NULL;
+static const unsigned char *symbols = NULL;
+static const char *strings = NULL;
+
+static const char *stringAt(uint32_t offset) {
+    return offset < stringBytes ? strings + offset : "?";
+}
+
+int debugInfoOpen(const char *path, int quiet) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (!quiet)
+            perror("Error opening debug info");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < DEBUG_HEADER_BYTES) {
+        close(fd);
+        if (!quiet)
+            fprintf(stderr, "Error: %s is not a Z16 debug table\n", path);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        if (!quiet)
+            perror("Error mapping debug info");
+        return -1;
+    }
+    const unsigned char *h = (const unsigned char *)map;
+    uint32_t nFiles = debugGet32(&h[12]), nLines = debugGet32(&h[16]);
+    uint32_t nSymbols = debugGet32(&h[20]), nStrings = debugGet32(&h[24]);
+    uint64_t expected = DEBUG_HEADER_BYTES + (uint64_t)nFiles * DEBUG_FILE_BYTES +
+                        (uint64_t)nLines * DEBUG_LINE_BYTES +
+                        (uint64_t)nSymbols * DEBUG_SYMBOL_BYTES + nStrings;
+    if (memcmp(h, DEBUG_MAGIC, 8) != 0 || debugGet16(&h[8]) != DEBUG_VERSION ||
+        expected > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        if (!quiet)
+            fprintf(stderr, "Error: %s is not a Z16 debug table (or has the wrong version)\n", path);
+        return -1;
+    }
+
+    debugInfoClose();
+    image = h;
+    imageBytes = (size_t)st.st_size;
+    fileCount = nFiles;
+    lineCount = nLines;
+    symbolCount = nSymbols;
+    stringBytes = nStrings;
+    files = image + DEBUG_HEADER_BYTES;
+    lines = files + (size_t)fileCount * DEBUG_FILE_BYTES;
+    symbols = lines + (size_t)lineCount * DEBUG_LINE_BYTES;
+    strings = (const char *)(symbols + (size_t)symbolCount * DEBUG_SYMBOL_BYTES);
+    return 0;
+}
+
+void debugInfoPathFor(const char *binFilename, char *buf, size_t bufSize) {
+    snprintf(buf, bufSize, "%s", binFilename);
+    char *dot = strrchr(buf, '.');
+    char *slash = strrchr(buf, '/');
+    if (dot && (!slash || dot > slash))
+        *dot = '\0';
+    size_t len = strlen(buf);
+    snprintf(buf + len, bufSize - len, ".dbg");
+}
+
+int debugInfoLoaded(void) {
+    return image != NULL;
+}
+
+// Index of the last entry whose address is <= addr, or -1.
+static long lastAtOrBelow(const unsigned char *table, uint32_t count, size_t entryBytes, uint16_t addr) {
+    long lo = 0, hi = (long)count - 1, found = -1;
+    while (lo <= hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (debugGet16(table + (size_t)mid * entryBytes) <= addr) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+// Line entry covering addr, or NULL.
+static const unsigned char *lineEntry(uint16_t addr) {
+    if (!image)
+        return NULL;
+    long i = lastAtOrBelow(lines, lineCount, DEBUG_LINE_BYTES, addr);
+    if (i < 0)
+        return NULL;
+    const unsigned char *e = lines + (size_t)i * DEBUG_LINE_BYTES;
+    if ((uint32_t)addr >= (uint32_t)debugGet16(e) + debugGet16(e + 2))
+        return NULL; // in a gap between lines
+    return e;
+}
+
+const char *debugLine(uint16_t addr, uint32_t *lineNo) {
+    const unsigned char *e = lineEntry(addr);
+    if (!e || debugGet16(e + 8) >= fileCount)
+        return NULL;
+    if (lineNo)
+        *lineNo = debugGet32(e + 4);
+    return stringAt(debugGet32(files + (size_t)debugGet16(e + 8) * DEBUG_FILE_BYTES));
+}
+
+const char *debugSymbol(uint16_t addr, uint16_t *offset) {
+    if (!image)
+        return NULL;
+    // Prefer a label of the section that holds addr: text and data may
+    // interleave in the address space.
+    const unsigned char *e = lineEntry(addr);
+    uint16_t section = e ? debugGet16(e + 10) : 0;
+    for (long i = lastAtOrBelow(symbols, symbolCount, DEBUG_SYMBOL_BYTES, addr); i >= 0; i--) {
+        const unsigned char *sym = symbols + (size_t)i * DEBUG_SYMBOL_BYTES;
+        if (section == 0 || debugGet16(sym + 2) == section) {
+            if (offset)
+                *offset = (uint16_t)(addr - debugGet16(sym));
+            return stringAt(debugGet32(sym + 4));
+        }
+    }
+    return NULL;
+}
+
+int debugSymbolAddress(const char *name, uint16_t *addr) {
+    for (uint32_t i = 0; i < symbolCount; i++) {
+        const unsigned char *sym = symbols + (size_t)i * DEBUG_SYMBOL_BYTES;
+        if (strcmp(stringAt(debugGet32(sym + 4)), name) == 0) {
+            *addr = debugGet16(sym);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *debugLocation(uint16_t addr, char *buf, size_t bufSize) {
+    uint32_t lineNo;
+    const char *file = debugLine(addr, &lineNo);
+    if (file)
+        snprintf(buf, bufSize, "%s:%u", file, lineNo);
+    else if (bufSize > 0)
+        buf[0] = '\0';
+    return buf;
+}
+
+const char *debugName(uint16_t addr, char *buf, size_t bufSize) {
+    uint16_t offset;
+    const char *label = debugSymbol(addr, &offset);
+    if (label && offset == 0)
+        snprintf(buf, bufSize, "%s", label);
+    else if (label)
+        snprintf(buf, bufSize, "%s+0x%X", label, offset);
+    else
+        snprintf(buf, bufSize, "0x%04X", addr);
+    return buf;
+}
+
+void debugInfoClose(void) {
+    if (image)
+        munmap((void *)image, imageBytes);
+    image = NULL;
+    imageBytes = 0;
+    fileCount = lineCount = symbolCount = stringBytes = 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Read-only access to a Z16 debug line table (format: z16debug.h).
+ *
+ * The file is mapped, not parsed: lookups binary-search the sorted tables
+ * in place. Every query returns "nothing" while no table is loaded, so
+ * callers need no checks of their own.
+ */
+#ifndef Z16DEBUGINFO_H
+#define Z16DEBUGINFO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Map `path`. Returns 0 on success, -1 (after printing why unless `quiet`)
+// if the file is missing or not a debug table.
+int debugInfoOpen(const char *path, int quiet);
+
+// Derive "<dir>/<name>.dbg" from a machine code file name.
+void debugInfoPathFor(const char *binFilename, char *buf, size_t bufSize);
+
+int debugInfoLoaded(void);
+
+// Source file and line of the code or data at `addr`; NULL if unknown.
+const char *debugLine(uint16_t addr, uint32_t *lineNo);
+
+// Nearest label at or below `addr` in the same section; NULL if none.
+const char *debugSymbol(uint16_t addr, uint16_t *offset);
+
+// Address of the label `name` (as written by the assembler: lower case).
+// Returns 1 if found.
+int debugSymbolAddress(const char *name, uint16_t *addr);
+
+// "file:line" for `addr`, or an empty string. Returns `buf`.
+const char *debugLocation(uint16_t addr, char *buf, size_t bufSize);
+
+// "label", "label+0x6" or "0x1234" for `addr`. Returns `buf`.
+const char *debugName(uint16_t addr, char *buf, size_t bufSize);
+
+void debugInfoClose(void);
+
+#endif // Z16DEBUGINFO_H
@@ -0,0 +1,238 @@
+/*
+ * Instruction decoding shared by the Z16 simulator and the static tools:
+ * disassembly, register footprint and control-flow targets. Nothing here
+ * touches simulator state, so tools link z16decode.c without z16sim.c.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#include "z16decode.h"
+
+// Register names
+const char *regNames[8] = {"t0", "ra", "sp", "s0", "s1", "t1", "a0", "a1"};
+
+int decodeMulDiv = 0;
+int decodePackedSimd = 0;
+
+static const char *mulDivNames[8] = {NULL, "mul", "mulh", "mulhu", "div", "divu", "rem", "remu"};
+static const char *simdNames[16] = {
+    NULL, "paddb", "psubb", "paddsb", "psubsb", "paddusb", "psubusb", "pminsb",
+    "pmaxsb", "pminub", "pmaxub", "pcmpeqb", "pcmpltb", "pswapb", "ppacklb", "ppackhb",
+};
+
+// Function to disassemble instructions
+void disassemble(uint16_t inst, uint16_t pc, char *buf, size_t bufSize) {
+    uint8_t opcode = inst & 0x7;
+
+    switch (opcode) {
+        case 0x0: { // R-Type
+            uint8_t funct4 = (inst >> 12) & 0xF;
+            uint8_t rs2 = (inst >> 9) & 0x7;
+            uint8_t rs1 = (inst >> 6) & 0x7;
+            uint8_t funct3 = (inst >> 3) & 0x7;
+            if (funct3 == MULDIV_FUNCT3 && funct4 >= MULDIV_MUL && funct4 <= MULDIV_REMU)
+                snprintf(buf, bufSize, "%s %s, %s", mulDivNames[funct4], regNames[rs1], regNames[rs2]);
+            else if (funct3 == SIMD_FUNCT3 && funct4 != 0)
+                snprintf(buf, bufSize, "%s %s, %s", simdNames[funct4], regNames[rs1], regNames[rs2]);
+            else
+                snprintf(buf, bufSize, "R-Type (%X) %s, %s", funct4, regNames[rs1], regNames[rs2]);
+            break;
+        }
+        case 0x1: { // I-Type
+            uint16_t imm = (inst >> 9) & 0x7F; // 7-bit immediate
+            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 6-8)
+            uint8_t funct3 = (inst >> 3) & 0x7; // funct3 (bits 3-5)
+            snprintf(buf, bufSize, "I-Type imm: %d, rs1: %s", imm, regNames[rs1]);
+            break;
+        }
+        case 0x2: { // B-Type (Branch)
+            int16_t imm = ((inst >> 12) & 0xF) | ((inst >> 1) & 0xE);
+            if (imm & 0x10) imm |= 0xFFE0;  // Sign-extend if necessary
+            uint8_t rs2 = (inst >> 9) & 0x7;
+            uint8_t rs1 = (inst >> 6) & 0x7;
+            snprintf(buf, bufSize, "B-Type offset: %d, %s, %s", imm, regNames[rs1], regNames[rs2]);
+            break;
+        }
+        case 0x3: { // S-Type (Store)
+            uint8_t imm = (inst >> 12) & 0xF;  // Immediate (bits 12-15)
+            uint8_t rs2 = (inst >> 9) & 0x7;   // rs2 (bits 9-11)
+            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 6-8)
+            snprintf(buf, bufSize, "S-Type Store %s -> [%s + %d]", regNames[rs2], regNames[rs1], imm);
+            break;
+        }
+        case 0x4: { // L-Type (Load)
+            uint8_t imm = (inst >> 12) & 0xF;  // Immediate (bits 12-15)
+            uint8_t rd = (inst >> 9) & 0x7;    // rd (bits 6-8)
+            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 3-5)
+            snprintf(buf, bufSize, "L-Type Load %s <- [%s + %d]", regNames[rd], regNames[rs1], imm);
+            break;
+        }
+        case 0x5: { // J-Type (Jump)
+            uint16_t imm = ((inst >> 4) & 0x3F) | ((inst >> 1) & 0xE);
+            uint8_t rd = (inst >> 9) & 0x7;    // rd (bits 6-8)
+            snprintf(buf, bufSize, "J-Type Jump to %d", imm);
+            break;
+        }
+        case 0x6: { // U-Type (Upper Immediate)
+            uint8_t imm = (inst >> 10) & 0x7;   // I[9:7] (bits 9-7)
+            uint8_t rd = (inst >> 9) & 0x7;     // rd (bits 6-8)
+            snprintf(buf, bufSize, "U-Type LUI/AUIPC %s = %d", regNames[rd], imm);
+            break;
+        }
+        case 0x7: { // System Instructions (e.g., ECALL)
+            snprintf(buf, bufSize, "ecall");
+            break;
+        }
+
+        default:
+            snprintf(buf, bufSize, "Unknown Instruction");
+    }
+}
+
+// Register and control-flow footprint used by the timing and dependency
+// models. Mirrors the field extraction in executeInstruction(), including
+// which encodings make it stop.
+void decodeOperands(uint16_t inst, InstInfo *info) {
+    uint8_t opcode = inst & 0x7;
+    uint8_t funct3 = (inst >> 3) & 0x7;
+    uint8_t f6 = (inst >> 6) & 0x7;   // rs1 / rd field (bits 6-8)
+    uint8_t f9 = (inst >> 9) & 0x7;   // rs2 field (bits 9-11)
+
+    info->kind = KIND_ALU;
+    info->srcMask = 0;
+    info->dstMask = 0;
+    if (inst == 0x0000) {
+        info->kind = KIND_INVALID;
+        return;
+    }
+    switch (opcode) {
+        case 0x0: { // R-Type: rs1 op= rs2
+            uint8_t funct4 = (inst >> 12) & 0xF;
+            if (funct3 == 0x0 && funct4 == 0x4) {        // JR
+                info->kind = KIND_JUMP_REG;
+                info->srcMask = 1 << f6;
+            } else if (funct3 == 0x0 && funct4 == 0x8) { // JALR: link in rs2
+                info->kind = KIND_JUMP_REG;
+                info->srcMask = 1 << f6;
+                info->dstMask = 1 << f9;
+            } else if (funct3 == MULDIV_FUNCT3 && decodeMulDiv && funct4 >= MULDIV_MUL && funct4 <= MULDIV_REMU) {
+                info->kind = funct4 <= MULDIV_MULHU ? KIND_MUL : KIND_DIV;
+                info->srcMask = (1 << f6) | (1 << f9);
+                info->dstMask = 1 << f6;
+            } else if (funct3 == SIMD_FUNCT3 && decodePackedSimd && funct4 != 0) {
+                info->srcMask = (funct4 == SIMD_SWAPB) ? (1 << f9) : ((1 << f6) | (1 << f9));
+                info->dstMask = 1 << f6;
+            } else if (funct3 == 0x1 || funct3 == 0x2 ||
+                       (funct3 == 0x0 && funct4 != 0x0 && funct4 != 0x1) ||
+                       (funct3 == 0x3 && funct4 != 0x2 && funct4 != 0x4 && funct4 != 0x8)) {
+                info->kind = KIND_INVALID;   // executeInstruction() halts on these
+            } else {
+                info->srcMask = (1 << f6) | (1 << f9);
+                info->dstMask = 1 << f6;
+            }
+            break;
+        }
+        case 0x1: // I-Type: rs1 op= imm (LI only writes)
+            if (funct3 == 0x3 && ((inst >> 14) & 0x3) == 0) { // shift type 0
+                info->kind = KIND_INVALID;
+                break;
+            }
+            info->srcMask = (funct3 == 0x7) ? 0 : (1 << f6);
+            info->dstMask = 1 << f6;
+            break;
+        case 0x2: // Branch: BZ/BNZ compare rs1 only
+            info->kind = KIND_BRANCH;
+            info->srcMask = (funct3 == 0x2 || funct3 == 0x3) ? (1 << f6) : ((1 << f6) | (1 << f9));
+            break;
+        case 0x3: // Store: base rs1, data rs2
+            if (funct3 > 0x1) {
+                info->kind = KIND_INVALID;
+                break;
+            }
+            info->kind = KIND_STORE;
+            info->srcMask = (1 << f6) | (1 << f9);
+            break;
+        case 0x4: // Load: rd in bits 6-8, base in bits 9-11
+            if (funct3 != 0x0 && funct3 != 0x1 && funct3 != 0x4) {
+                info->kind = KIND_INVALID;
+                break;
+            }
+            info->kind = KIND_LOAD;
+            info->srcMask = 1 << f9;
+            info->dstMask = 1 << f6;
+            break;
+        case 0x5: // J/JAL
+            info->kind = KIND_JUMP;
+            if ((inst >> 15) & 0x1)
+                info->dstMask = 1 << f6;
+            break;
+        case 0x6: // U-Type
+            info->dstMask = 1 << f6;
+            break;
+        case 0x7: { // ECALL: the registers depend on the service
+            static const uint8_t srcMasks[16] = {
+                [ECALL_PRINT_INT] = 1 << REG_A0,
+                [ECALL_EXIT] = 1 << REG_A0,
+                [ECALL_HEAP] = 1 << REG_A0 | 1 << REG_A1 | 1 << REG_T0,
+                [ECALL_PRINT_STRING] = 1 << REG_A0,
+                [ECALL_READ_LINE] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_READ_BYTES] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_WAIT] = 1 << REG_A0,
+                [ECALL_STREAM_READ] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_STREAM_WRITE] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_STREAM_NEXT] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_STREAM_CLOSE] = 1 << REG_A0,
+                [ECALL_BULK] = 1 << REG_A0 | 1 << REG_A1 | 1 << REG_T0 | 1 << REG_T1,
+                [ECALL_ACCEL] = 1 << REG_A0 | 1 << REG_A1 | 1 << REG_T0 | 1 << REG_T1,
+            };
+            static const uint8_t dstMasks[16] = {
+                [ECALL_READ_INT] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_HEAP] = 1 << REG_A0,
+                [ECALL_READ_LINE] = 1 << REG_A0,
+                [ECALL_READ_BYTES] = 1 << REG_A0,
+                [ECALL_WAIT] = 1 << REG_A0,
+                [ECALL_STREAM_READ] = 1 << REG_A0,
+                [ECALL_STREAM_WRITE] = 1 << REG_A0,
+                [ECALL_STREAM_NEXT] = 1 << REG_A0 | 1 << REG_A1,
+                [ECALL_STREAM_CLOSE] = 1 << REG_A0,
+                [ECALL_BULK] = 1 << REG_A0,
+                [ECALL_ACCEL] = 1 << REG_A0 | 1 << REG_A1,
+            };
+            uint8_t service = (inst >> 3) & 0xF;
+            info->kind = KIND_ECALL;
+            info->srcMask = srcMasks[service];
+            info->dstMask = dstMasks[service];
+            break;
+        }
+    }
+}
+
+// Static successor of a PC-relative branch or J/JAL, computed exactly as
+// executeInstruction() does, including the final pc += 2 it applies to every
+// instruction.
+int decodeTarget(uint16_t inst, uint16_t pc, uint16_t *target) {
+    uint8_t opcode = inst & 0x7;
+    if (opcode == 0x2) {
+        uint8_t imm4_1 = (inst >> 12) & 0xF;
+        int8_t offset = imm4_1 << 1;
+        if (imm4_1 & 0x8) offset |= 0xF0;
+        *target = (uint16_t)(pc + offset + 2);
+        return 1;
+    }
+    if (opcode == 0x5) {
+        uint8_t I_3_1 = (inst >> 3) & 0x7;
+        uint8_t I_9_4 = (inst >> 9) & 0x3F;
+        int32_t offset = ((int32_t)I_9_4 << 3) | I_3_1;
+        if (offset & 0x100)
+            offset |= 0xFFFFFFE0;
+        *target = (uint16_t)(pc + offset * 2 + 2);
+        return 1;
+    }
+    return 0;
+}
+
+// Address a JAL/JALR callee returns to with "jr ra": JAL links pc+4 and the
+// return adds 2 more; JALR links its own pc.
+uint16_t decodeReturnPoint(uint16_t inst, uint16_t pc) {
+    return (uint16_t)(pc + ((inst & 0x7) == 0x5 ? 6 : 2));
+}
@@ -0,0 +1,111 @@
+/*
+ * Instruction decoding shared by the Z16 simulator and the static tools
+ * (z16decode.c).
+ */
+#ifndef Z16DECODE_H
+#define Z16DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Register numbers with a fixed role in the calling convention
+#define REG_T0 0 // operation selector of multi-operation ecalls
+#define REG_RA 1 // return address
+#define REG_SP 2 // stack pointer
+#define REG_T1 5 // length argument of bulk ecalls
+#define REG_A0 6 // first argument / return value
+#define REG_A1 7 // second argument
+
+// ecall services (bits 3-6 of the instruction); arguments and results in
+// a0/a1
+#define ECALL_PRINT_INT     1   // print a0
+#define ECALL_EXIT          3
+#define ECALL_HEAP          4   // heap operation t0 on a0, a1 (see z16heap.h)
+#define ECALL_PRINT_STRING  5   // print the NUL-terminated string at a0
+#define ECALL_READ_INT      6   // a0 = number read, a1 = 1 (0 at end of input)
+#define ECALL_READ_LINE     7   // line into [a0, a0+a1); a0 = length or 0xFFFF at end
+#define ECALL_READ_BYTES    8   // up to a1 bytes to a0; a0 = bytes read
+#define ECALL_WAIT          9   // sleep until input or a0 ms pass (0 = no limit);
+                                // a0 = 1 input, 2 timeout
+#define ECALL_STREAM_READ   10  // open file a0 for reading, window at a1; a0 = handle
+#define ECALL_STREAM_WRITE  11  // same for writing
+#define ECALL_STREAM_NEXT   12  // a0 = handle, a1 = bytes produced (write);
+                                // a0 = next half, a1 = its length / capacity
+#define ECALL_STREAM_CLOSE  13  // a0 = handle; a0 = 0 or 0xFFFF on error
+#define ECALL_BULK          14  // block memory operation t0 on a0, a1, length t1
+                                // (see z16bulk.h)
+#define ECALL_ACCEL         15  // accelerator kernel t0 on a0, a1, length t1
+                                // (see z16accel.h)
+
+// M extension: R-type funct3 2, rs1 op= rs2 like the base ALU operations.
+// Signed division by zero gives -1 (unsigned: 0xFFFF) and rem by zero the
+// dividend; -32768 / -1 gives -32768 with remainder 0.
+#define MULDIV_FUNCT3  0x2
+#define MULDIV_MUL     0x1   // low 16 bits of the product
+#define MULDIV_MULH    0x2   // high 16 bits, signed x signed
+#define MULDIV_MULHU   0x3   // high 16 bits, unsigned x unsigned
+#define MULDIV_DIV     0x4
+#define MULDIV_DIVU    0x5
+#define MULDIV_REM     0x6
+#define MULDIV_REMU    0x7
+
+// Packed-byte extension: R-type funct3 1, rd op= rs on the two 8-bit lanes
+// of each register (see z16simd.h). Compares give 0xFF/0x00 per lane.
+#define SIMD_FUNCT3    0x1
+#define SIMD_ADDB      0x1   // wrapping add
+#define SIMD_SUBB      0x2   // wrapping subtract
+#define SIMD_ADDSB     0x3   // signed saturating add
+#define SIMD_SUBSB     0x4   // signed saturating subtract
+#define SIMD_ADDUSB    0x5   // unsigned saturating add
+#define SIMD_SUBUSB    0x6   // unsigned saturating subtract
+#define SIMD_MINSB     0x7
+#define SIMD_MAXSB     0x8
+#define SIMD_MINUB     0x9
+#define SIMD_MAXUB     0xA
+#define SIMD_CMPEQB    0xB
+#define SIMD_CMPLTB    0xC   // signed
+#define SIMD_SWAPB     0xD   // rd = rs with its lanes swapped
+#define SIMD_PACKLB    0xE   // rd = low lane of rd, low lane of rs above it
+#define SIMD_PACKHB    0xF   // rd = high lane of rd, high lane of rs above it
+
+// Set when the M extension is enabled (z16_sim --mext); otherwise its
+// encodings decode as invalid, as on the base machine.
+extern int decodeMulDiv;
+
+// Set when the packed-byte extension is enabled (z16_sim --simd).
+extern int decodePackedSimd;
+
+extern const char *regNames[8];
+
+void disassemble(uint16_t inst, uint16_t pc, char *buf, size_t bufSize);
+
+// Register and control-flow footprint of one instruction, decoded with the
+// same field layout as executeInstruction().
+typedef enum {
+    KIND_ALU,       // register/immediate arithmetic, LUI/AUIPC
+    KIND_MUL,       // M extension multiplies
+    KIND_DIV,       // M extension divides and remainders
+    KIND_LOAD,
+    KIND_STORE,
+    KIND_BRANCH,    // conditional, PC-relative
+    KIND_JUMP,      // J/JAL, PC-relative
+    KIND_JUMP_REG,  // JR/JALR
+    KIND_ECALL,
+    KIND_INVALID    // the simulator stops on it (including 0x0000)
+} InstKind;
+
+typedef struct {
+    InstKind kind;
+    uint8_t srcMask;   // bit r set if register r is read
+    uint8_t dstMask;   // bit r set if register r is written
+} InstInfo;
+
+void decodeOperands(uint16_t inst, InstInfo *info);
+
+// Target of a branch or J/JAL at `pc`; returns 0 for other instructions.
+int decodeTarget(uint16_t inst, uint16_t pc, uint16_t *target);
+
+// Where a call (JAL or JALR at `pc`) resumes after the callee's "jr ra".
+uint16_t decodeReturnPoint(uint16_t inst, uint16_t pc);
+
+#endif // Z16DECODE_H
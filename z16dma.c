@@ -0,0 +1,223 @@
+/*
+ * Memory-mapped DMA controller (see z16dma.h for the register layout and
+ * the memory model).
+ *
+ * Spec syntax (comma separated, any order):
+ *   base=<addr>     register window, a multiple of 32 (default 0xFFE0)
+ *   inline=<bytes>  transfers up to this size are copied when started
+ *                   (default 256); starting the helper thread costs more
+ *
+ * One transfer is in flight at a time. The simulating thread fills in the
+ * transfer, sets `busy` and posts it to the helper thread, which copies and
+ * clears `busy` with release semantics. A conflicting access or a new start
+ * only takes the mutex when it actually has to wait.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "z16sim.h"
+#include "z16dma.h"
+#include "z16bus.h"
+#include "z16spec.h"
+
+int dmaDoorbellPending = 0;
+
+static uint32_t base = 0xFFE0;
+static uint32_t inlineLimit = 256;
+static int synchronousMode = 0;
+static DmaObserve observer = NULL;
+
+// Transfer in flight; written by the simulating thread while idle
+static uint16_t curSrc, curDst;
+static uint32_t curLen;
+static _Atomic int busy = 0;
+static uint16_t doneBits = 0;       // STATUS once the last transfer is over
+
+static pthread_t worker;
+static int workerStarted = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+static int workPosted = 0;
+static int quitting = 0;
+
+static uint64_t transfers = 0;
+static uint64_t inlineTransfers = 0;
+static uint64_t failedTransfers = 0;
+static uint64_t bytesCopied = 0;
+static uint64_t stalls = 0;
+
+static void *workerMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!workPosted && !quitting)
+            pthread_cond_wait(&workCond, &lock);
+        if (!workPosted)
+            break;
+        workPosted = 0;
+        pthread_mutex_unlock(&lock);
+        memmove(&memory[curDst], &memory[curSrc], curLen);
+        pthread_mutex_lock(&lock);
+        atomic_store_explicit(&busy, 0, memory_order_release);
+        pthread_cond_broadcast(&doneCond);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static void waitIdle(void) {
+    if (!atomic_load_explicit(&busy, memory_order_acquire))
+        return;
+    stalls++;
+    pthread_mutex_lock(&lock);
+    while (atomic_load_explicit(&busy, memory_order_acquire))
+        pthread_cond_wait(&doneCond, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+static inline int overlaps(uint32_t a, uint32_t aEnd, uint32_t b, uint32_t bEnd) {
+    return a < bEnd && b < aEnd;
+}
+
+static uint16_t readRegister(uint32_t offset) {
+    return (uint16_t)(memory[base + offset] | (memory[base + offset + 1] << 8));
+}
+
+// -----------------------
+// Bus device
+// -----------------------
+// The registers live in the backing RAM of the controller's page; the rest
+// of the page behaves as RAM.
+
+static uint32_t deviceRead(void *ctx, uint16_t addr, int size) {
+    (void)ctx;
+    int inFlight = atomic_load_explicit(&busy, memory_order_acquire);
+    uint16_t status = (uint16_t)((inFlight ? DMA_BUSY : doneBits) |
+                                 (((transfers - inFlight) & 0xFF) << 8));
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++) {
+        uint32_t a = (uint32_t)addr + i;
+        uint8_t byte = memory[a];
+        if (a == base + DMA_REG_STATUS)
+            byte = (uint8_t)status;
+        else if (a == base + DMA_REG_STATUS + 1)
+            byte = (uint8_t)(status >> 8);
+        value |= (uint32_t)byte << (8 * i);
+    }
+    return value;
+}
+
+static void deviceWrite(void *ctx, uint16_t addr, int size, uint32_t value) {
+    (void)ctx;
+    for (int i = 0; i < size; i++) {
+        uint32_t a = (uint32_t)addr + i;
+        memory[a] = (uint8_t)(value >> (8 * i));
+        if (a == base + DMA_REG_CTRL)
+            dmaDoorbellPending = 1;
+    }
+}
+
+static int dmaItem(const char *key, char *value) {
+    uint64_t v;
+    if (specNumber(value, &v) != 0)
+        return -1;
+    if (strcmp(key, "base") == 0) base = (uint32_t)v;
+    else if (strcmp(key, "inline") == 0) inlineLimit = (uint32_t)v;
+    else return -1;
+    return 0;
+}
+
+int dmaInit(const char *spec, int synchronous, DmaObserve observe) {
+    int status = specParse(spec, "", "DMA", dmaItem);
+    if (status == 0 && (base % DMA_WINDOW != 0 || base > MEM_SIZE - DMA_WINDOW)) {
+        fprintf(stderr, "Error: DMA base must be a multiple of %d below 0x%X\n", DMA_WINDOW, MEM_SIZE);
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+    uint16_t page = (uint16_t)(base & ~(uint32_t)(BUS_PAGE_SIZE - 1));
+    if (busMap(page, BUS_PAGE_SIZE, "DMA controller", deviceRead, deviceWrite, NULL) != 0)
+        return -1;
+    synchronousMode = synchronous;
+    observer = observe;
+    return 0;
+}
+
+void dmaAccess(uint16_t addr, int size, int isWrite) {
+    uint32_t end = (uint32_t)addr + size;
+    if (atomic_load_explicit(&busy, memory_order_acquire) &&
+        (overlaps(addr, end, curDst, curDst + curLen) ||
+         (isWrite && overlaps(addr, end, curSrc, curSrc + curLen))))
+        waitIdle();
+}
+
+void dmaDoorbell(void) {
+    dmaDoorbellPending = 0;
+    if (!(memory[base + DMA_REG_CTRL] & DMA_START))
+        return;
+    waitIdle();
+    uint32_t src = readRegister(DMA_REG_SRC);
+    uint32_t dst = readRegister(DMA_REG_DST);
+    uint32_t len = readRegister(DMA_REG_LEN);
+    transfers++;
+    if (src + len > MEM_SIZE || dst + len > MEM_SIZE ||
+        overlaps(src, src + len, base, base + DMA_WINDOW) ||
+        overlaps(dst, dst + len, base, base + DMA_WINDOW)) {
+        doneBits = DMA_ERROR;
+        failedTransfers++;
+        return;
+    }
+    doneBits = DMA_DONE;
+    bytesCopied += len;
+    if (len == 0)
+        return;
+    if (synchronousMode || len <= inlineLimit) {
+        inlineTransfers++;
+        if (observer) {
+            observer((uint16_t)src, (int)len, 0);
+            observer((uint16_t)dst, (int)len, 1);
+        }
+        memmove(&memory[dst], &memory[src], len);
+        return;
+    }
+
+    if (!workerStarted) {
+        if (pthread_create(&worker, NULL, workerMain, NULL) != 0) {
+            // No thread: degrade to inline copies
+            synchronousMode = 1;
+            inlineTransfers++;
+            memmove(&memory[dst], &memory[src], len);
+            return;
+        }
+        workerStarted = 1;
+    }
+    curSrc = (uint16_t)src;
+    curDst = (uint16_t)dst;
+    curLen = len;
+    pthread_mutex_lock(&lock);
+    atomic_store_explicit(&busy, 1, memory_order_relaxed);
+    workPosted = 1;
+    pthread_cond_signal(&workCond);
+    pthread_mutex_unlock(&lock);
+}
+
+void dmaClose(void) {
+    waitIdle();
+    if (workerStarted) {
+        pthread_mutex_lock(&lock);
+        quitting = 1;
+        pthread_cond_signal(&workCond);
+        pthread_mutex_unlock(&lock);
+        pthread_join(worker, NULL);
+        workerStarted = 0;
+    }
+    fprintf(stderr, "dma: %llu transfers (%llu inline, %llu failed), %llu bytes copied, %llu stalls\n",
+            (unsigned long long)transfers, (unsigned long long)inlineTransfers,
+            (unsigned long long)failedTransfers, (unsigned long long)bytesCopied,
+            (unsigned long long)stalls);
+}
@@ -0,0 +1,70 @@
+/*
+ * Memory-mapped DMA controller for the Z16 simulator.
+ *
+ * A 32-byte register window (default 0xFFE0) holds, at 4-byte strides so
+ * that SW/LW (which move 4 bytes) touch one register each:
+ *   +0  SRC     source address
+ *   +4  DST     destination address
+ *   +8  LEN     bytes to copy (0 completes at once)
+ *   +12 CTRL    writing bit 0 (DMA_START) starts SRC/DST/LEN
+ *   +16 STATUS  DMA_BUSY, DMA_DONE, DMA_ERROR (range wraps or covers the
+ *               window); bits 8-15 count completed transfers
+ * The controller is a bus device (z16bus.h) on the 256-byte page holding
+ * the window; the rest of that page stays RAM. The registers are kept in
+ * the page's backing memory: the device acts on a store to CTRL and
+ * computes STATUS for every load that reads it.
+ *
+ * Transfers copy like memmove. Short ones run inline when started; longer
+ * ones run on a helper thread while the guest keeps executing. Memory
+ * model: until a transfer completes, a guest load or store that overlaps
+ * its destination, or a store that overlaps its source, waits for it to
+ * finish, so every access sees either none or all of the copy and the
+ * result never depends on host timing. Loads from the source proceed.
+ * Starting a transfer while one is in flight also waits. Instruction
+ * fetches and ecall output are not checked: poll STATUS before running or
+ * printing copied bytes.
+ */
+#ifndef Z16DMA_H
+#define Z16DMA_H
+
+#include <stdint.h>
+
+#define DMA_WINDOW 32
+#define DMA_REG_SRC    0
+#define DMA_REG_DST    4
+#define DMA_REG_LEN    8
+#define DMA_REG_CTRL   12
+#define DMA_REG_STATUS 16
+
+#define DMA_START 0x01
+
+#define DMA_BUSY  0x01
+#define DMA_DONE  0x02
+#define DMA_ERROR 0x04
+
+// Reports the bytes an inline transfer reads and writes to the rest of the
+// instrumentation, as accesses of the store that started it.
+typedef void (*DmaObserve)(uint16_t addr, int size, int isWrite);
+
+// Set by a store to CTRL; the simulator then calls dmaDoorbell() once the
+// store has retired.
+extern int dmaDoorbellPending;
+
+// Parse a spec such as "base=0xFFE0,inline=256" (or "default") and map the
+// controller onto the bus. With `synchronous` every transfer runs inline, so
+// that memory-tracking instrumentation sees all of them. Returns 0 on
+// success.
+int dmaInit(const char *spec, int synchronous, DmaObserve observe);
+
+// Record a data access of the instruction being executed; must be called
+// before the access. Waits for conflicting transfers.
+void dmaAccess(uint16_t addr, int size, int isWrite);
+
+// Act on the CTRL write that set dmaDoorbellPending.
+void dmaDoorbell(void);
+
+// Wait for the transfer in flight, stop the helper thread and print the
+// statistics to stderr.
+void dmaClose(void);
+
+#endif // Z16DMA_H
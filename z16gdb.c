@@ -0,0 +1,645 @@
+/*
+ * GDB Remote Serial Protocol stub for the Z16 simulator.
+ *
+ * Spec: "<port>" listens on 127.0.0.1:<port>, "unix:<path>" on a Unix
+ * socket. One debugger is served; when it detaches or disconnects the
+ * program runs on undisturbed.
+ *
+ * Supported requests: ? g G p P m M c s C S k D H T, Z/z 0-4 (breakpoints
+ * and write/read/access watchpoints), qSupported, qXfer:features:read
+ * (target.xml), qAttached, qC, qOffsets, q[fs]ThreadInfo, QStartNoAckMode,
+ * vKill. Anything else gets the empty "unsupported" reply.
+ *
+ * While the program runs, the connection is polled for Ctrl-C only every
+ * POLL_INTERVAL block entries, so a free-running program pays one
+ * system call per several hundred thousand instructions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "z16sim.h"
+#include "z16gdb.h"
+
+#define PAGE_BITS 8
+#define PAGE_COUNT (MEM_SIZE >> PAGE_BITS)
+#define MAX_PACKET 4096
+#define MAX_TRANSFER 2000          // bytes per m/M request and qXfer chunk
+#define MAX_WATCHPOINTS 32
+#define POLL_INTERVAL (1u << 16)
+#define REG_COUNT 9                // r0-r7, pc
+
+#define SIGNAL_INT  2
+#define SIGNAL_ILL  4
+#define SIGNAL_TRAP 5
+
+typedef struct {
+    uint16_t addr;
+    uint16_t len;
+    int type;                      // Z packet type: 2 write, 3 read, 4 access
+} Watchpoint;
+
+int gdbArmed = 0;
+uint16_t gdbBreakPages[PAGE_COUNT];
+uint32_t gdbPollCountdown = POLL_INTERVAL;
+
+static int conn = -1;
+static int noAck = 0;
+static unsigned char inBuf[MAX_PACKET];
+static size_t inLen = 0, inPos = 0;
+
+static uint8_t breakBits[MEM_SIZE / 16];   // one bit per instruction address
+static Watchpoint watchpoints[MAX_WATCHPOINTS];
+static int watchCount = 0;
+static uint16_t watchPages[PAGE_COUNT];    // watchpoints touching each page
+
+static int stepping = 0;
+static int resumed = 0;                    // a stop reply is owed
+static int stopSignal = SIGNAL_TRAP;
+static const Watchpoint *watchHit = NULL;
+
+static char targetXml[2048];
+
+// -----------------------
+// Connection
+// -----------------------
+
+static void closeConnection(void) {
+    if (conn >= 0)
+        close(conn);
+    conn = -1;
+    memset(breakBits, 0, sizeof(breakBits));
+    memset(gdbBreakPages, 0, sizeof(gdbBreakPages));
+    memset(watchPages, 0, sizeof(watchPages));
+    watchCount = 0;
+    watchHit = NULL;
+    stepping = 0;
+    gdbArmed = 0;
+}
+
+static int readByte(void) {
+    if (inPos == inLen) {
+        ssize_t n;
+        do {
+            n = recv(conn, inBuf, sizeof(inBuf), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            return -1;
+        inLen = (size_t)n;
+        inPos = 0;
+    }
+    return inBuf[inPos++];
+}
+
+static int sendAll(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(conn, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int hexValue(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static const char hexDigits[] = "0123456789abcdef";
+
+// Receive one packet into buf (NUL-terminated, escapes undone). Returns its
+// length, or -1 if the connection is gone.
+static int getPacket(char *buf) {
+    for (;;) {
+        int c;
+        while ((c = readByte()) != '$')
+            if (c < 0)
+                return -1;          // anything else between packets (acks, Ctrl-C) is dropped
+        int len = 0;
+        unsigned sum = 0;
+        while ((c = readByte()) != '#') {
+            if (c < 0)
+                return -1;
+            sum += (unsigned)c;
+            if (c == '}') {
+                if ((c = readByte()) < 0)
+                    return -1;
+                sum += (unsigned)c;
+                c ^= 0x20;
+            }
+            if (len < MAX_PACKET)
+                buf[len++] = (char)c;
+        }
+        int hi = readByte(), lo = readByte();
+        if (hi < 0 || lo < 0)
+            return -1;
+        buf[len] = '\0';
+        if (noAck)
+            return len;
+        if (hexValue(hi) * 16 + hexValue(lo) == (int)(sum & 0xFF)) {
+            sendAll("+", 1);
+            return len;
+        }
+        sendAll("-", 1);
+    }
+}
+
+static int putPacket(const char *data) {
+    static char frame[2 * MAX_PACKET + 8];
+    size_t len = 0;
+    unsigned sum = 0;
+    frame[len++] = '$';
+    for (const char *p = data; *p && len < sizeof(frame) - 5; p++) {
+        char c = *p;
+        if (c == '$' || c == '#' || c == '}' || c == '*') {
+            frame[len++] = '}';
+            sum += '}';
+            c ^= 0x20;
+        }
+        frame[len++] = c;
+        sum += (unsigned char)c;
+    }
+    frame[len++] = '#';
+    frame[len++] = hexDigits[(sum >> 4) & 0xF];
+    frame[len++] = hexDigits[sum & 0xF];
+    for (;;) {
+        if (sendAll(frame, len) != 0)
+            return -1;
+        if (noAck)
+            return 0;
+        int c;
+        while ((c = readByte()) != '+' && c != '-')
+            if (c < 0)
+                return -1;
+        if (c == '+')
+            return 0;
+    }
+}
+
+static int listenTcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Error creating GDB socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        perror("Error listening for GDB");
+        close(fd);
+        return -1;
+    }
+    fprintf(stderr, "Waiting for GDB on localhost:%d\n", port);
+    return fd;
+}
+
+static int listenUnix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Error creating GDB socket");
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: GDB socket path too long: %s\n", path);
+        close(fd);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        perror("Error listening for GDB");
+        close(fd);
+        return -1;
+    }
+    fprintf(stderr, "Waiting for GDB on %s\n", path);
+    return fd;
+}
+
+int gdbOpen(const char *spec) {
+    int unixSocket = strncmp(spec, "unix:", 5) == 0;
+    int listenFd;
+    if (unixSocket) {
+        listenFd = listenUnix(spec + 5);
+    } else {
+        char *end;
+        long port = strtol(spec, &end, 10);
+        if (*spec == '\0' || *end != '\0' || port < 1 || port > 65535) {
+            fprintf(stderr, "Error: --gdb expects a port number or unix:<path>, not '%s'\n", spec);
+            return -1;
+        }
+        listenFd = listenTcp((int)port);
+    }
+    if (listenFd < 0)
+        return -1;
+    do {
+        conn = accept(listenFd, NULL, NULL);
+    } while (conn < 0 && errno == EINTR);
+    close(listenFd);
+    if (unixSocket)
+        unlink(spec + 5);
+    if (conn < 0) {
+        perror("Error accepting GDB connection");
+        return -1;
+    }
+    int one = 1;
+    if (!unixSocket)
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    size_t len = (size_t)snprintf(targetXml, sizeof(targetXml),
+        "<?xml version=\"1.0\"?>\n<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+        "<target version=\"1.0\">\n  <feature name=\"org.z16.cpu\">\n");
+    for (int i = 0; i < 8; i++)
+        len += (size_t)snprintf(targetXml + len, sizeof(targetXml) - len,
+                                "    <reg name=\"%s\" bitsize=\"16\" type=\"int\" regnum=\"%d\"/>\n", regNames[i], i);
+    snprintf(targetXml + len, sizeof(targetXml) - len,
+             "    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\" regnum=\"8\"/>\n  </feature>\n</target>\n");
+    return 0;
+}
+
+// -----------------------
+// Breakpoints and watchpoints
+// -----------------------
+
+static inline int breakpointAt(uint16_t addr) {
+    return (breakBits[addr >> 4] >> ((addr >> 1) & 7)) & 1;
+}
+
+static int setBreakpoint(uint16_t addr, int insert) {
+    if (addr & 1)
+        return -1;
+    uint8_t bit = (uint8_t)(1 << ((addr >> 1) & 7));
+    if (insert && !(breakBits[addr >> 4] & bit)) {
+        breakBits[addr >> 4] |= bit;
+        gdbBreakPages[addr >> PAGE_BITS]++;
+    } else if (!insert && (breakBits[addr >> 4] & bit)) {
+        breakBits[addr >> 4] &= (uint8_t)~bit;
+        gdbBreakPages[addr >> PAGE_BITS]--;
+    }
+    return 0;
+}
+
+static void markWatchPages(const Watchpoint *w, int delta) {
+    for (uint32_t page = w->addr >> PAGE_BITS; page <= (uint32_t)(w->addr + w->len - 1) >> PAGE_BITS; page++)
+        watchPages[page & (PAGE_COUNT - 1)] = (uint16_t)(watchPages[page & (PAGE_COUNT - 1)] + delta);
+}
+
+static int setWatchpoint(int type, uint16_t addr, uint32_t len, int insert) {
+    if (len == 0 || len > (uint32_t)MEM_SIZE - addr)
+        return -1;
+    for (int i = 0; i < watchCount; i++) {
+        Watchpoint *w = &watchpoints[i];
+        if (w->type == type && w->addr == addr && w->len == len) {
+            if (insert)
+                return 0;
+            markWatchPages(w, -1);
+            *w = watchpoints[--watchCount];
+            return 0;
+        }
+    }
+    if (!insert)
+        return 0;
+    if (watchCount == MAX_WATCHPOINTS)
+        return -1;
+    Watchpoint *w = &watchpoints[watchCount++];
+    w->type = type;
+    w->addr = addr;
+    w->len = (uint16_t)len;
+    markWatchPages(w, +1);
+    return 0;
+}
+
+int gdbWatching(void) {
+    return watchCount > 0;
+}
+
+void gdbAccess(uint16_t addr, int size, int isWrite) {
+    // ecall buffers can span many pages; L/S touch at most two
+    uint32_t page = addr >> PAGE_BITS, last = ((uint32_t)addr + size - 1) >> PAGE_BITS;
+    while (page <= last && !watchPages[page & (PAGE_COUNT - 1)])
+        page++;
+    if (page > last)
+        return;
+    for (int i = 0; i < watchCount && !watchHit; i++) {
+        const Watchpoint *w = &watchpoints[i];
+        if ((w->type == 2 && !isWrite) || (w->type == 3 && isWrite))
+            continue;
+        if ((uint32_t)addr < (uint32_t)w->addr + w->len && (uint32_t)w->addr < (uint32_t)addr + size) {
+            watchHit = w;
+            gdbArmed = 1;   // stop before the next instruction
+        }
+    }
+}
+
+// -----------------------
+// Execution control
+// -----------------------
+
+int gdbCheck(uint16_t pc) {
+    if (conn < 0)
+        return 0;
+    if (stepping || watchHit) {
+        stopSignal = SIGNAL_TRAP;
+        return 1;
+    }
+    gdbArmed = gdbBreakPages[pc >> PAGE_BITS] != 0;
+    if (gdbArmed && breakpointAt(pc)) {
+        stopSignal = SIGNAL_TRAP;
+        return 1;
+    }
+    if (gdbPollCountdown == 0 || --gdbPollCountdown == 0) {
+        gdbPollCountdown = POLL_INTERVAL;
+        struct pollfd pfd = { conn, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) > 0) {
+            int c = readByte();
+            if (c < 0) {
+                fprintf(stderr, "GDB disconnected\n");
+                closeConnection();
+                return 0;
+            }
+            if (c == 0x03) {
+                stopSignal = SIGNAL_INT;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void sendStopReply(void) {
+    char reply[48];
+    if (watchHit) {
+        const char *kind = watchHit->type == 2 ? "watch" : watchHit->type == 3 ? "rwatch" : "awatch";
+        snprintf(reply, sizeof(reply), "T%02x%s:%x;", stopSignal, kind, watchHit->addr);
+        watchHit = NULL;
+    } else {
+        snprintf(reply, sizeof(reply), "T%02x", stopSignal);
+    }
+    putPacket(reply);
+}
+
+static uint16_t readRegister(int n) {
+    return n < 8 ? regs[n] : pc;
+}
+
+static void writeRegister(int n, uint16_t value) {
+    if (n < 8)
+        regs[n] = value;
+    else
+        pc = value;
+}
+
+static void putHex16(char *out, uint16_t value) {
+    out[0] = hexDigits[(value >> 4) & 0xF];
+    out[1] = hexDigits[value & 0xF];
+    out[2] = hexDigits[(value >> 12) & 0xF];
+    out[3] = hexDigits[(value >> 8) & 0xF];
+}
+
+// Little-endian register value from 4 hex digits; -1 if malformed.
+static long getHex16(const char *in) {
+    int d[4];
+    for (int i = 0; i < 4; i++)
+        if ((d[i] = hexValue((unsigned char)in[i])) < 0)
+            return -1;
+    return (d[0] << 4) | d[1] | (d[2] << 12) | (d[3] << 8);
+}
+
+// Parse "addr,len" (hex); returns the position after len or NULL.
+static const char *parseRange(const char *p, uint32_t *addr, uint32_t *len) {
+    char *end;
+    *addr = (uint32_t)strtoul(p, &end, 16);
+    if (*end != ',')
+        return NULL;
+    *len = (uint32_t)strtoul(end + 1, &end, 16);
+    return end;
+}
+
+static void handleQuery(const char *pkt, char *reply) {
+    uint32_t offset, len;
+    const char *xfer = "qXfer:features:read:target.xml:";
+    if (strncmp(pkt, "qSupported", 10) == 0)
+        sprintf(reply, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", MAX_PACKET);
+    else if (strncmp(pkt, xfer, strlen(xfer)) == 0 && parseRange(pkt + strlen(xfer), &offset, &len)) {
+        size_t total = strlen(targetXml);
+        if (len > MAX_TRANSFER)
+            len = MAX_TRANSFER;
+        if (offset >= total) {
+            strcpy(reply, "l");
+        } else {
+            size_t n = total - offset < len ? total - offset : len;
+            reply[0] = offset + n < total ? 'm' : 'l';
+            memcpy(reply + 1, targetXml + offset, n);
+            reply[n + 1] = '\0';
+        }
+    }
+    else if (strcmp(pkt, "qAttached") == 0)
+        strcpy(reply, "1");
+    else if (strcmp(pkt, "qC") == 0)
+        strcpy(reply, "QC1");
+    else if (strcmp(pkt, "qOffsets") == 0)
+        strcpy(reply, "Text=0;Data=0;Bss=0");
+    else if (strcmp(pkt, "qfThreadInfo") == 0)
+        strcpy(reply, "m1");
+    else if (strcmp(pkt, "qsThreadInfo") == 0)
+        strcpy(reply, "l");
+    else
+        reply[0] = '\0';
+}
+
+// Serve requests while stopped. Returns GDB_RESUME, GDB_KILL or GDB_DETACHED.
+static int serve(void) {
+    static char pkt[MAX_PACKET + 1];
+    static char reply[2 * MAX_PACKET + 1];
+    for (;;) {
+        if (getPacket(pkt) < 0) {
+            fprintf(stderr, "GDB disconnected\n");
+            closeConnection();
+            return GDB_DETACHED;
+        }
+        uint32_t addr, len;
+        const char *p;
+        char *end;
+        strcpy(reply, "E01");
+        switch (pkt[0]) {
+        case '?':
+            snprintf(reply, sizeof(reply), "T%02x", stopSignal);
+            break;
+        case 'g':
+            for (int i = 0; i < REG_COUNT; i++)
+                putHex16(reply + 4 * i, readRegister(i));
+            reply[4 * REG_COUNT] = '\0';
+            break;
+        case 'G':
+            if (strlen(pkt + 1) >= 4 * REG_COUNT) {
+                for (int i = 0; i < REG_COUNT; i++) {
+                    long v = getHex16(pkt + 1 + 4 * i);
+                    if (v >= 0)
+                        writeRegister(i, (uint16_t)v);
+                }
+                strcpy(reply, "OK");
+            }
+            break;
+        case 'p': {
+            unsigned long n = strtoul(pkt + 1, NULL, 16);
+            if (n < REG_COUNT) {
+                putHex16(reply, readRegister((int)n));
+                reply[4] = '\0';
+            }
+            break;
+        }
+        case 'P': {
+            unsigned long n = strtoul(pkt + 1, &end, 16);
+            long v = *end == '=' ? getHex16(end + 1) : -1;
+            if (n < REG_COUNT && v >= 0) {
+                writeRegister((int)n, (uint16_t)v);
+                strcpy(reply, "OK");
+            }
+            break;
+        }
+        case 'm':
+            if (parseRange(pkt + 1, &addr, &len) && addr < MEM_SIZE) {
+                if (len > MAX_TRANSFER)
+                    len = MAX_TRANSFER;
+                if (len > MEM_SIZE - addr)
+                    len = MEM_SIZE - addr;
+                for (uint32_t i = 0; i < len; i++) {
+                    reply[2 * i] = hexDigits[memory[addr + i] >> 4];
+                    reply[2 * i + 1] = hexDigits[memory[addr + i] & 0xF];
+                }
+                reply[2 * len] = '\0';
+            }
+            break;
+        case 'M':
+            if ((p = parseRange(pkt + 1, &addr, &len)) && *p == ':' && len <= MEM_SIZE - addr &&
+                strlen(p + 1) >= 2 * len) {
+                for (uint32_t i = 0; i < len; i++)
+                    memory[addr + i] = (unsigned char)(hexValue((unsigned char)p[1 + 2 * i]) * 16 +
+                                                       hexValue((unsigned char)p[2 + 2 * i]));
+                strcpy(reply, "OK");
+            }
+            break;
+        case 'c':
+        case 's':
+        case 'C':
+        case 'S':
+            // Optional resume address after the command (and signal, ignored)
+            p = pkt + 1;
+            if (pkt[0] == 'C' || pkt[0] == 'S')
+                p = strchr(pkt, ';') ? strchr(pkt, ';') + 1 : pkt + strlen(pkt);
+            if (*p)
+                pc = (uint16_t)strtoul(p, NULL, 16);
+            stepping = pkt[0] == 's' || pkt[0] == 'S';
+            gdbArmed = stepping || gdbBreakPages[pc >> PAGE_BITS] != 0;
+            resumed = 1;
+            return GDB_RESUME;
+        case 'Z':
+        case 'z': {
+            int type = pkt[1] - '0';
+            if (pkt[2] != ',' || !parseRange(pkt + 3, &addr, &len) || addr >= MEM_SIZE)
+                break;
+            int ok;
+            if (type == 0 || type == 1)
+                ok = setBreakpoint((uint16_t)addr, pkt[0] == 'Z') == 0;
+            else if (type >= 2 && type <= 4)
+                ok = setWatchpoint(type, (uint16_t)addr, len, pkt[0] == 'Z') == 0;
+            else {
+                reply[0] = '\0';
+                break;
+            }
+            strcpy(reply, ok ? "OK" : "E01");
+            break;
+        }
+        case 'k':
+            closeConnection();
+            return GDB_KILL;
+        case 'D':
+            putPacket("OK");
+            closeConnection();
+            return GDB_DETACHED;
+        case 'H':
+        case 'T':
+            strcpy(reply, "OK");
+            break;
+        case 'q':
+            handleQuery(pkt, reply);
+            break;
+        case 'Q':
+            if (strcmp(pkt, "QStartNoAckMode") == 0) {
+                putPacket("OK");
+                noAck = 1;
+                continue;
+            }
+            reply[0] = '\0';
+            break;
+        case 'v':
+            if (strncmp(pkt, "vKill", 5) == 0) {
+                putPacket("OK");
+                closeConnection();
+                return GDB_KILL;
+            }
+            reply[0] = '\0';
+            break;
+        default:
+            reply[0] = '\0';
+            break;
+        }
+        if (putPacket(reply) != 0) {
+            fprintf(stderr, "GDB disconnected\n");
+            closeConnection();
+            return GDB_DETACHED;
+        }
+    }
+}
+
+int gdbStop(void) {
+    if (conn < 0)
+        return GDB_DETACHED;
+    if (resumed)
+        sendStopReply();
+    resumed = 0;
+    stepping = 0;
+    return serve();
+}
+
+void gdbHalted(uint16_t inst) {
+    if (conn < 0)
+        return;
+    if ((inst & 0x7) == 0x7 && ((inst >> 3) & 0xF) == ECALL_EXIT) {
+        putPacket("W00");
+        closeConnection();
+        return;
+    }
+    // Let the debugger look at the state that made the program stop; the
+    // program cannot go on, so any resume ends it.
+    stopSignal = SIGNAL_ILL;
+    watchHit = NULL;
+    if (gdbStop() == GDB_RESUME) {
+        char reply[8];
+        snprintf(reply, sizeof(reply), "X%02x", SIGNAL_ILL);
+        putPacket(reply);
+    }
+    closeConnection();
+}
@@ -0,0 +1,62 @@
+/*
+ * GDB Remote Serial Protocol stub for the Z16 simulator.
+ *
+ * The simulator listens on a local TCP port or Unix socket and waits for a
+ * debugger before the first instruction. Registers (t0..a1 as r0..r7, then
+ * pc, all 16 bits) and memory can be read and written; the program can be
+ * stepped, continued and interrupted with Ctrl-C.
+ *
+ * Breakpoints cost nothing while none is near: they live in a bitmap with
+ * a per-page count, and the simulator only asks gdbCheck() at block entries
+ * (taken control transfers) and page crossings, or on every instruction
+ * while gdbArmed is set because the current page holds a breakpoint or
+ * GDB is single-stepping. Watchpoints are per-page flags looked at in the
+ * load/store instrumentation path, which only runs while one is set.
+ */
+#ifndef Z16GDB_H
+#define Z16GDB_H
+
+#include <stdint.h>
+
+// What the simulator should do after gdbStop()
+#define GDB_RESUME   0
+#define GDB_KILL     1
+#define GDB_DETACHED 2
+
+// Non-zero while gdbCheck() must run before every instruction
+extern int gdbArmed;
+
+// Breakpoints per 256-byte page, and block entries left until the next
+// Ctrl-C poll; only gdbBlockEntry() should touch them.
+extern uint16_t gdbBreakPages[256];
+extern uint32_t gdbPollCountdown;
+
+// Cheap test at a block entry or page crossing: non-zero if gdbCheck() has
+// to look closer.
+static inline int gdbBlockEntry(uint16_t pc) {
+    return gdbBreakPages[pc >> 8] != 0 || --gdbPollCountdown == 0;
+}
+
+// Listen on "<port>" (TCP, localhost only) or "unix:<path>" and wait for a
+// debugger to connect. Returns 0 on success.
+int gdbOpen(const char *spec);
+
+// Before executing the instruction at pc: non-zero if execution must stop
+// for a breakpoint, a completed single step, a watchpoint hit or Ctrl-C.
+int gdbCheck(uint16_t pc);
+
+// Record a data access for the watchpoints (L/S handlers).
+void gdbAccess(uint16_t addr, int size, int isWrite);
+
+// Report the stop to the debugger and serve its requests until it resumes,
+// kills or detaches. Returns GDB_RESUME, GDB_KILL or GDB_DETACHED.
+int gdbStop(void);
+
+// The program halted on `inst`: report an exit for ecall 3, otherwise an
+// illegal instruction stop that can still be inspected.
+void gdbHalted(uint16_t inst);
+
+// Non-zero while any watchpoint is set.
+int gdbWatching(void);
+
+#endif // Z16GDB_H
@@ -0,0 +1,438 @@
+/*
+ * Guest heap ecall (see z16heap.h for the guest's view).
+ *
+ * Spec syntax (comma separated, any order):
+ *   base=<addr>     first byte of the heap (rounded up to a page)
+ *   end=<addr>      one past the last byte (rounded down to a page)
+ *   debug=0|1       red zones, fill patterns and the leak report (default 0)
+ *   redzone=<n>     red zone bytes on each side in debug mode, a multiple of
+ *                   8 (default 8)
+ *
+ * The heap is cut into 256-byte pages. Blocks of up to 128 bytes come from
+ * pages holding one size class each (a bitmap of slots per page, and a list
+ * of the pages of each class with a free slot); larger blocks take a run of
+ * whole pages, found first-fit. Page and block metadata (requested size and
+ * allocating pc per block) are host arrays, so a guest that overruns a
+ * block can damage its neighbours' data but never the allocator.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16bus.h"
+#include "z16heap.h"
+#include "z16debuginfo.h"
+#include "z16spec.h"
+
+#define PAGE_BITS 8
+#define PAGE_SIZE (1 << PAGE_BITS)
+#define MAX_PAGES (MEM_SIZE / PAGE_SIZE)
+#define GRANULE 8
+#define DEFAULT_END 0xC000
+#define NUM_CLASSES 8
+#define LARGEST_SMALL 128
+
+#define FILL_NEW  0xCD
+#define FILL_FREE 0xDD
+#define FILL_RED  0xFD
+
+static const uint16_t classSize[NUM_CLASSES] = {8, 16, 24, 32, 48, 64, 96, 128};
+
+enum { PAGE_FREE, PAGE_SMALL, PAGE_LARGE, PAGE_TAIL };
+
+typedef struct {
+    uint8_t state;
+    uint8_t sizeClass;      // PAGE_SMALL
+    uint16_t run;           // PAGE_LARGE: pages in the block
+    uint32_t live;          // PAGE_SMALL: one bit per slot in use
+    int16_t nextPartial;    // PAGE_SMALL with a free slot: next page of the class, or -1
+} Page;
+
+static uint32_t heapBase = 0, heapEnd = 0;
+static int baseGiven = 0, endGiven = 0;
+static uint32_t pageCount = 0;
+static Page pages[MAX_PAGES];
+static int16_t partial[NUM_CLASSES];
+static uint16_t blockSize[MEM_SIZE / GRANULE];   // requested bytes, by block start
+static uint16_t blockPc[MEM_SIZE / GRANULE];     // pc of the allocating ecall
+
+static int debugMode = 0;
+static uint32_t redZone = 8;
+static HeapObserve observer = NULL;
+
+static uint64_t mallocs = 0, callocs = 0, reallocs = 0, frees = 0;
+static uint64_t movedReallocs = 0, failed = 0, invalid = 0, damaged = 0;
+static uint32_t liveBlocks = 0, bytesInUse = 0, peakBytes = 0;
+static uint32_t pagesInUse = 0, peakPages = 0;
+
+static int heapItem(const char *key, char *value) {
+    uint64_t v;
+    if (specNumber(value, &v) != 0)
+        return -1;
+    if (strcmp(key, "base") == 0) { heapBase = (uint32_t)v; baseGiven = 1; }
+    else if (strcmp(key, "end") == 0) { heapEnd = (uint32_t)v; endGiven = 1; }
+    else if (strcmp(key, "debug") == 0) debugMode = v != 0;
+    else if (strcmp(key, "redzone") == 0) redZone = (uint32_t)v;
+    else return -1;
+    return 0;
+}
+
+int heapInit(const char *spec, uint32_t imageEnd, HeapObserve observe) {
+    if (specParse(spec, "", "heap", heapItem) != 0)
+        return -1;
+    if (redZone % GRANULE != 0 || redZone > 64) {
+        fprintf(stderr, "Error: heap red zone must be a multiple of %d up to 64\n", GRANULE);
+        return -1;
+    }
+    if (!debugMode)
+        redZone = 0;
+
+    // Labels in the program override the spec, as a linker script would.
+    uint16_t label;
+    if (debugSymbolAddress("__heap_start", &label))
+        heapBase = label;
+    else if (!baseGiven)
+        heapBase = imageEnd;
+    if (debugSymbolAddress("__heap_end", &label))
+        heapEnd = label;
+    else if (!endGiven)
+        heapEnd = DEFAULT_END;
+    heapBase = (heapBase + PAGE_SIZE - 1) & ~(uint32_t)(PAGE_SIZE - 1);
+    heapEnd &= ~(uint32_t)(PAGE_SIZE - 1);
+    if (heapBase == 0)
+        heapBase = PAGE_SIZE;   // 0 is the failure result
+    if (heapEnd > MEM_SIZE || heapBase >= heapEnd) {
+        fprintf(stderr, "Error: the heap needs at least one %d-byte page between base and end "
+                "(image ends at 0x%X)\n", PAGE_SIZE, imageEnd);
+        return -1;
+    }
+    for (uint32_t a = heapBase; a < heapEnd; a += PAGE_SIZE)
+        if (busDevice((uint16_t)a)) {
+            fprintf(stderr, "Error: the heap overlaps %s at 0x%04X\n", busDevice((uint16_t)a), a);
+            return -1;
+        }
+    pageCount = (heapEnd - heapBase) / PAGE_SIZE;
+    for (int c = 0; c < NUM_CLASSES; c++)
+        partial[c] = -1;
+    observer = observe;
+    return 0;
+}
+
+// -----------------------
+// Pages and blocks
+// -----------------------
+
+static inline uint32_t pageAddress(uint32_t p) {
+    return heapBase + p * PAGE_SIZE;
+}
+
+static inline uint32_t slots(int c) {
+    return PAGE_SIZE / classSize[c];
+}
+
+// Slot bitmap of a full page of class c
+static inline uint32_t fullMask(int c) {
+    return slots(c) == 32 ? 0xFFFFFFFFu : (1u << slots(c)) - 1;
+}
+
+static void fill(uint32_t addr, uint32_t n, uint8_t byte) {
+    if (n == 0)
+        return;
+    if (observer)
+        observer((uint16_t)addr, (int)n, 1);
+    memset(&memory[addr], byte, n);
+}
+
+static void takePages(uint32_t n) {
+    pagesInUse += n;
+    if (pagesInUse > peakPages)
+        peakPages = pagesInUse;
+}
+
+// First run of n free pages, or -1
+static int64_t findRun(uint32_t n) {
+    uint32_t length = 0;
+    for (uint32_t p = 0; p < pageCount; p++) {
+        length = pages[p].state == PAGE_FREE ? length + 1 : 0;
+        if (length == n)
+            return (int64_t)(p + 1 - n);
+    }
+    return -1;
+}
+
+static void unlinkPartial(uint32_t p) {
+    int c = pages[p].sizeClass;
+    for (int16_t *link = &partial[c]; *link >= 0; link = &pages[*link].nextPartial)
+        if (*link == (int16_t)p) {
+            *link = pages[p].nextPartial;
+            return;
+        }
+}
+
+// Start of a new block of at least `need` bytes, or 0
+static uint32_t blockAlloc(uint32_t need) {
+    if (need <= LARGEST_SMALL) {
+        int c = 0;
+        while (classSize[c] < need)
+            c++;
+        if (partial[c] < 0) {
+            int64_t p = findRun(1);
+            if (p < 0)
+                return 0;
+            pages[p] = (Page){PAGE_SMALL, (uint8_t)c, 1, 0, -1};
+            partial[c] = (int16_t)p;
+            takePages(1);
+        }
+        uint32_t p = (uint32_t)partial[c];
+        uint32_t slot = 0;
+        while ((pages[p].live >> slot) & 1)
+            slot++;
+        pages[p].live |= 1u << slot;
+        if (pages[p].live == fullMask(c))
+            unlinkPartial(p);
+        return pageAddress(p) + slot * classSize[c];
+    }
+    uint32_t n = (need + PAGE_SIZE - 1) / PAGE_SIZE;
+    int64_t p = findRun(n);
+    if (p < 0)
+        return 0;
+    pages[p] = (Page){PAGE_LARGE, 0, (uint16_t)n, 0, -1};
+    for (uint32_t i = 1; i < n; i++)
+        pages[p + i].state = PAGE_TAIL;
+    takePages(n);
+    return pageAddress((uint32_t)p);
+}
+
+// Block start for a guest pointer, or 0 if it is not a live block
+static uint32_t blockAt(uint16_t ptr) {
+    uint32_t start = (uint32_t)ptr - redZone;
+    if (ptr < redZone || start < heapBase || start >= heapEnd)
+        return 0;
+    uint32_t p = (start - heapBase) / PAGE_SIZE, offset = (start - heapBase) % PAGE_SIZE;
+    if (pages[p].state == PAGE_LARGE)
+        return offset == 0 ? start : 0;
+    if (pages[p].state != PAGE_SMALL || offset % classSize[pages[p].sizeClass] != 0)
+        return 0;
+    uint32_t slot = offset / classSize[pages[p].sizeClass];
+    return (pages[p].live >> slot) & 1 ? start : 0;
+}
+
+static uint32_t capacity(uint32_t start) {
+    const Page *page = &pages[(start - heapBase) / PAGE_SIZE];
+    return page->state == PAGE_LARGE ? page->run * PAGE_SIZE : classSize[page->sizeClass];
+}
+
+static void blockRelease(uint32_t start) {
+    uint32_t p = (start - heapBase) / PAGE_SIZE;
+    Page *page = &pages[p];
+    if (page->state == PAGE_LARGE) {
+        uint32_t n = page->run;
+        for (uint32_t i = 0; i < n; i++)
+            pages[p + i].state = PAGE_FREE;
+        pagesInUse -= n;
+        return;
+    }
+    int c = page->sizeClass;
+    int wasFull = page->live == fullMask(c);
+    page->live &= ~(1u << ((start - pageAddress(p)) / classSize[c]));
+    if (page->live == 0) {
+        if (!wasFull)
+            unlinkPartial(p);
+        page->state = PAGE_FREE;
+        pagesInUse--;
+    } else if (wasFull) {
+        page->nextPartial = partial[c];
+        partial[c] = (int16_t)p;
+    }
+}
+
+// -----------------------
+// Debug checks
+// -----------------------
+
+static void describe(uint32_t start, char *buf, size_t bufSize) {
+    char name[64], where[96];
+    uint16_t allocPc = blockPc[start / GRANULE];
+    debugLocation(allocPc, where, sizeof(where));
+    snprintf(buf, bufSize, "block at 0x%04X (%u bytes, allocated by the ecall at %s%s%s)",
+             start + redZone, blockSize[start / GRANULE], debugName(allocPc, name, sizeof(name)),
+             where[0] ? " " : "", where);
+}
+
+// Write both red zones of a block of `size` bytes.
+static void guard(uint32_t start, uint32_t size) {
+    fill(start, redZone, FILL_RED);
+    fill(start + redZone + size, redZone, FILL_RED);
+}
+
+static void checkRedZones(uint32_t start) {
+    if (!debugMode)
+        return;
+    uint32_t user = start + redZone, size = blockSize[start / GRANULE];
+    for (uint32_t i = 0; i < redZone; i++) {
+        uint32_t a = memory[start + i] != FILL_RED ? start + i :
+                     memory[user + size + i] != FILL_RED ? user + size + i : 0;
+        if (a) {
+            char what[192];
+            describe(start, what, sizeof(what));
+            fprintf(stderr, "heap: red zone of the %s overwritten at 0x%04X\n", what, a);
+            damaged++;
+            return;
+        }
+    }
+}
+
+// -----------------------
+// Operations
+// -----------------------
+
+static uint16_t heapMalloc(uint32_t size) {
+    if (size == 0)
+        size = 1;   // a distinct block, as the C library gives
+    uint32_t start = size + 2 * redZone <= pageCount * PAGE_SIZE ? blockAlloc(size + 2 * redZone) : 0;
+    if (!start) {
+        failed++;
+        return 0;
+    }
+    blockSize[start / GRANULE] = (uint16_t)size;
+    blockPc[start / GRANULE] = pc;
+    liveBlocks++;
+    bytesInUse += size;
+    if (bytesInUse > peakBytes)
+        peakBytes = bytesInUse;
+    if (debugMode) {
+        guard(start, size);
+        fill(start + redZone, size, FILL_NEW);
+    }
+    return (uint16_t)(start + redZone);
+}
+
+static void reportInvalid(const char *operation, uint16_t ptr) {
+    char name[64];
+    fprintf(stderr, "heap: %s of 0x%04X at %s, which is not a live block\n", operation, ptr,
+            debugName(pc, name, sizeof(name)));
+    invalid++;
+}
+
+static void heapFree(uint16_t ptr) {
+    if (ptr == 0)
+        return;
+    uint32_t start = blockAt(ptr);
+    if (!start) {
+        reportInvalid("free", ptr);
+        return;
+    }
+    checkRedZones(start);
+    uint32_t size = blockSize[start / GRANULE];
+    if (debugMode)
+        fill(start, size + 2 * redZone, FILL_FREE);
+    liveBlocks--;
+    bytesInUse -= size;
+    blockRelease(start);
+}
+
+static uint16_t heapRealloc(uint16_t ptr, uint32_t size) {
+    if (ptr == 0)
+        return heapMalloc(size);
+    uint32_t start = blockAt(ptr);
+    if (!start) {
+        reportInvalid("realloc", ptr);
+        return 0;
+    }
+    if (size == 0)
+        size = 1;
+    checkRedZones(start);
+    uint32_t old = blockSize[start / GRANULE];
+    if (size + 2 * redZone <= capacity(start)) {
+        // Fits where it is: only the end moves.
+        if (debugMode) {
+            if (size > old)
+                fill(start + redZone + old, size - old, FILL_NEW);
+            fill(start + redZone + size, redZone, FILL_RED);
+        }
+        blockSize[start / GRANULE] = (uint16_t)size;
+        bytesInUse = bytesInUse - old + size;
+        if (bytesInUse > peakBytes)
+            peakBytes = bytesInUse;
+        return ptr;
+    }
+    uint16_t moved = heapMalloc(size);
+    if (!moved)
+        return 0;
+    uint32_t n = old < size ? old : size;
+    if (observer) {
+        observer(ptr, (int)n, 0);
+        observer(moved, (int)n, 1);
+    }
+    memcpy(&memory[moved], &memory[ptr], n);
+    heapFree(ptr);
+    movedReallocs++;
+    return moved;
+}
+
+int heapEcall(void) {
+    uint16_t a0 = regs[REG_A0], a1 = regs[REG_A1];
+    switch (regs[REG_T0]) {
+        case HEAP_MALLOC:
+            mallocs++;
+            regs[REG_A0] = heapMalloc(a0);
+            break;
+        case HEAP_FREE:
+            frees++;
+            heapFree(a0);
+            break;
+        case HEAP_REALLOC:
+            reallocs++;
+            if (a0 != 0 && a1 == 0) {
+                heapFree(a0);
+                regs[REG_A0] = 0;
+            } else {
+                regs[REG_A0] = heapRealloc(a0, a1);
+            }
+            break;
+        case HEAP_CALLOC: {
+            callocs++;
+            uint32_t size = (uint32_t)a0 * a1;
+            uint16_t block = size < MEM_SIZE ? heapMalloc(size) : 0;
+            if (size >= MEM_SIZE)
+                failed++;
+            if (block)
+                fill(block, size, 0);
+            regs[REG_A0] = block;
+            break;
+        }
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+void heapReport(void) {
+    fprintf(stderr, "heap: 0x%04X-0x%04X, %llu malloc, %llu calloc, %llu realloc (%llu moved), %llu free, "
+            "%llu failed, %llu invalid; peak %u bytes in %u pages, %u blocks (%u bytes) live at exit\n",
+            heapBase, heapEnd, (unsigned long long)mallocs, (unsigned long long)callocs,
+            (unsigned long long)reallocs, (unsigned long long)movedReallocs, (unsigned long long)frees,
+            (unsigned long long)failed, (unsigned long long)invalid, peakBytes, peakPages, liveBlocks,
+            bytesInUse);
+    if (!debugMode)
+        return;
+    // Live blocks in address order: the leaks, and any red zone damage
+    // not yet seen by a free.
+    char what[192];
+    for (uint32_t p = 0; p < pageCount; p++) {
+        uint32_t n = pages[p].state == PAGE_LARGE ? 1 :
+                     pages[p].state == PAGE_SMALL ? slots(pages[p].sizeClass) : 0;
+        for (uint32_t slot = 0; slot < n; slot++) {
+            if (pages[p].state == PAGE_SMALL && !((pages[p].live >> slot) & 1))
+                continue;
+            uint32_t start = pageAddress(p) + (pages[p].state == PAGE_SMALL ? slot * classSize[pages[p].sizeClass] : 0);
+            checkRedZones(start);
+            describe(start, what, sizeof(what));
+            fprintf(stderr, "heap: leaked %s\n", what);
+        }
+    }
+    if (damaged)
+        fprintf(stderr, "heap: %llu damaged red zones\n", (unsigned long long)damaged);
+}
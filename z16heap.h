@@ -0,0 +1,49 @@
+/*
+ * Guest heap ecall (service 4) for the Z16 simulator: malloc, free, realloc
+ * and calloc on a region of guest memory, with the allocator running on the
+ * host instead of as guest code.
+ *
+ * t0 selects the operation; arguments are in a0/a1 and the result comes
+ * back in a0, 0 when there is no room. Other registers are preserved. A
+ * block is aligned to 8 bytes. Freeing or resizing an address that is not
+ * a live block (including a second free) is reported on stderr and
+ * otherwise ignored.
+ *
+ * The region is [__heap_start, __heap_end) when the program defines those
+ * labels (and its -g debug table is loaded), else the spec's range, else
+ * from the end of the image to 0xC000. All bookkeeping lives on the host,
+ * so the guest's heap bytes are exactly its blocks.
+ *
+ * With debug=1 every block is surrounded by red zones and filled with 0xCD
+ * when allocated and 0xDD when freed; damaged red zones are reported when
+ * the block is freed and at exit, along with every block never freed and
+ * where it was allocated.
+ */
+#ifndef Z16HEAP_H
+#define Z16HEAP_H
+
+#include <stdint.h>
+
+#define HEAP_MALLOC  0  // a0 = block of a0 bytes
+#define HEAP_FREE    1  // release the block at a0 (0 is ignored)
+#define HEAP_REALLOC 2  // a0 = the block at a0 resized to a1 bytes, contents
+                        // kept; on failure 0 and the old block stays
+#define HEAP_CALLOC  3  // a0 = zeroed block of a0 * a1 bytes
+
+// Reports the bytes an operation writes to the load/store instrumentation;
+// called before guest memory changes.
+typedef void (*HeapObserve)(uint16_t addr, int size, int isWrite);
+
+// Parse a spec such as "base=0x8000,end=0xC000,debug=1,redzone=8" (or
+// "default") and set up the heap; imageEnd is one past the last byte the
+// program image defines. Returns 0 on success.
+int heapInit(const char *spec, uint32_t imageEnd, HeapObserve observe);
+
+// Run the operation selected by t0. Returns 0, or -1 for an unknown one.
+int heapEcall(void);
+
+// Print allocation statistics to stderr and, in debug mode, leaks and
+// damaged red zones.
+void heapReport(void);
+
+#endif // Z16HEAP_H
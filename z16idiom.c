@@ -0,0 +1,188 @@
+/*
+ * Loop idiom recognition (see z16idiom.h for what is recognised and when a
+ * loop falls back to normal interpretation).
+ *
+ * The interpreter offers every taken backward BNE. The body is looked up in
+ * a small direct-mapped cache keyed by its head; an entry holds the body's
+ * bytes, so a hit only costs a compare of at most 16 bytes and rewritten
+ * code misses and is decoded again. Loops that are not idioms are cached
+ * too, so an ordinary hot loop is decoded once.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16bus.h"
+#include "z16idiom.h"
+
+#define IDIOM_MAX_BODY 8    // the farthest a BNE reaches back, itself included
+#define IDIOM_CACHE 64      // entries, a power of two
+
+typedef enum { LOOP_NONE, LOOP_COPY, LOOP_FILL } LoopKind;
+
+typedef struct {
+    int valid;
+    uint16_t head, branch;                  // first instruction and the BNE
+    unsigned char code[2 * IDIOM_MAX_BODY]; // body bytes it was decoded from
+    LoopKind kind;
+    uint32_t length;                        // instructions, the BNE included
+    uint8_t stepped;                        // bit r set for each "addi r, 1"
+    uint8_t counter, limit;                 // bne counter, limit
+    uint8_t temp;                           // copy: register loaded and stored
+    int signedLoad;                         // copy: lb rather than lbu
+    uint8_t value;                          // fill: register stored
+    uint8_t srcBase, dstBase;
+    // Added to the base as it is at the head: the offset, plus 1 when the
+    // base is stepped before the access
+    uint16_t srcOffset, dstOffset;
+} Loop;
+
+static Loop cache[IDIOM_CACHE];
+
+static uint64_t copies = 0, fills = 0;
+static uint64_t copiedBytes = 0, filledBytes = 0;
+static uint64_t fallbacks = 0;
+static uint64_t retiredTotal = 0;
+
+// Load/store offset as executeInstruction() forms it
+static inline uint16_t memOffset(uint16_t inst) {
+    uint8_t imm4 = (inst >> 12) & 0xF;
+    int16_t offset = imm4;
+    if (imm4 & 0x8) offset |= 0xF0;
+    return (uint16_t)offset;
+}
+
+// Classify the body in loop->code; leaves kind LOOP_NONE unless every
+// instruction has its role.
+static void decodeLoop(Loop *loop) {
+    int loads = 0, stores = 0, loadFirst = 0;
+    uint8_t written = 0;    // registers written other than by "addi r, 1"
+    uint8_t stepped = 0;
+    loop->kind = LOOP_NONE;
+    for (uint32_t i = 0; i + 1 < loop->length; i++) {
+        uint16_t inst = loop->code[2 * i] | (loop->code[2 * i + 1] << 8);
+        uint8_t opcode = inst & 0x7;
+        uint8_t funct3 = (inst >> 3) & 0x7;
+        uint8_t r1 = (inst >> 6) & 0x7;
+        uint8_t r2 = (inst >> 9) & 0x7;
+        if (opcode == 0x1 && funct3 == 0x0 && ((inst >> 9) & 0x7F) == 1) {  // addi r1, 1
+            if (stepped & (1 << r1))
+                return;
+            stepped |= 1 << r1;
+        } else if (opcode == 0x4 && (funct3 == 0x0 || funct3 == 0x4)) {    // lb/lbu r1, off(r2)
+            if (loads++)
+                return;
+            loop->temp = r1;
+            loop->signedLoad = funct3 == 0x0;
+            loop->srcBase = r2;
+            loop->srcOffset = (uint16_t)(memOffset(inst) + ((stepped >> r2) & 1));
+            written |= 1 << r1;
+        } else if (opcode == 0x3 && funct3 == 0x0) {                       // sb r2, off(r1)
+            if (stores++)
+                return;
+            loop->dstBase = r1;
+            loop->value = r2;
+            loop->dstOffset = (uint16_t)(memOffset(inst) + ((stepped >> r1) & 1));
+            loadFirst = loads > 0;
+        } else {
+            return;
+        }
+    }
+
+    uint16_t bne = loop->code[2 * (loop->length - 1)] | (loop->code[2 * (loop->length - 1) + 1] << 8);
+    uint16_t target;
+    if ((bne & 0x3F) != ((0x1 << 3) | 0x2) || !decodeTarget(bne, loop->branch, &target) ||
+        target != loop->head)
+        return;
+    uint8_t a = (bne >> 6) & 0x7, b = (bne >> 9) & 0x7;
+    if ((stepped >> a) & 1 && !((stepped >> b) & 1)) {
+        loop->counter = a;
+        loop->limit = b;
+    } else if ((stepped >> b) & 1 && !((stepped >> a) & 1)) {
+        loop->counter = b;
+        loop->limit = a;
+    } else {
+        return;
+    }
+    if ((written >> loop->limit) & 1 || stores != 1 || !((stepped >> loop->dstBase) & 1))
+        return;
+    loop->stepped = stepped;
+    if (loads == 0) {
+        if (!((stepped >> loop->value) & 1))
+            loop->kind = LOOP_FILL;
+    } else if (loadFirst && loop->value == loop->temp && !((stepped >> loop->temp) & 1) &&
+               (stepped >> loop->srcBase) & 1) {
+        loop->kind = LOOP_COPY;
+    }
+}
+
+// Whether [addr, addr+n) is RAM and does not wrap
+static int ramRange(uint16_t addr, uint32_t n) {
+    if ((uint32_t)addr + n > MEM_SIZE)
+        return 0;
+    for (uint32_t p = addr >> BUS_PAGE_BITS; p <= (addr + n - 1) >> BUS_PAGE_BITS; p++)
+        if (!busRam[p])
+            return 0;
+    return 1;
+}
+
+uint64_t idiomLoop(uint16_t branchPc) {
+    uint16_t head = pc;
+    uint32_t length = ((uint32_t)(uint16_t)(branchPc - head) >> 1) + 1;
+    if (length < 3 || length > IDIOM_MAX_BODY)
+        return 0;
+    Loop *loop = &cache[(head >> 1) & (IDIOM_CACHE - 1)];
+    if (!loop->valid || loop->head != head || loop->branch != branchPc ||
+        memcmp(loop->code, &memory[head], 2 * length) != 0) {
+        loop->valid = 1;
+        loop->head = head;
+        loop->branch = branchPc;
+        loop->length = length;
+        memcpy(loop->code, &memory[head], 2 * length);
+        decodeLoop(loop);
+    }
+    if (loop->kind == LOOP_NONE)
+        return 0;
+
+    // The counter reaches the limit after this many more iterations; 0
+    // would be a full 65536.
+    uint32_t trips = (uint16_t)(regs[loop->limit] - regs[loop->counter]);
+    uint16_t dst = (uint16_t)(regs[loop->dstBase] + loop->dstOffset);
+    uint16_t src = (uint16_t)(regs[loop->srcBase] + loop->srcOffset);
+    uint32_t codeEnd = (uint32_t)branchPc + 2;
+    if (trips == 0 || !ramRange(dst, trips) || (dst < codeEnd && head < dst + trips) ||
+        (loop->kind == LOOP_COPY && (!ramRange(src, trips) ||
+                                     (dst != src && (uint16_t)(dst - src) < trips)))) {
+        fallbacks++;
+        return 0;
+    }
+
+    if (loop->kind == LOOP_COPY) {
+        // No store reaches the last source byte before it is loaded.
+        uint8_t last = memory[src + trips - 1];
+        memmove(&memory[dst], &memory[src], trips);
+        regs[loop->temp] = loop->signedLoad ? (uint16_t)(int8_t)last : last;
+        copies++;
+        copiedBytes += trips;
+    } else {
+        memset(&memory[dst], regs[loop->value] & 0xFF, trips);
+        fills++;
+        filledBytes += trips;
+    }
+    for (int r = 0; r < 8; r++)
+        if ((loop->stepped >> r) & 1)
+            regs[r] += (uint16_t)trips;
+    pc = (uint16_t)codeEnd;
+    uint64_t retired = (uint64_t)trips * loop->length;
+    retiredTotal += retired;
+    return retired;
+}
+
+void idiomReport(void) {
+    fprintf(stderr, "idioms: %llu copy loops (%llu bytes), %llu fill loops (%llu bytes), "
+            "%llu instructions replaced, %llu fallbacks\n",
+            (unsigned long long)copies, (unsigned long long)copiedBytes, (unsigned long long)fills,
+            (unsigned long long)filledBytes, (unsigned long long)retiredTotal,
+            (unsigned long long)fallbacks);
+}
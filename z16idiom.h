@@ -0,0 +1,40 @@
+/*
+ * Loop idiom recognition for the Z16 simulator: byte copy and fill loops in
+ * existing binaries run as one host memmove/memset instead of instruction
+ * by instruction.
+ *
+ * A loop is the straight-line body from the target of a taken backward BNE
+ * up to that BNE, at most 8 instructions. It is an idiom when the body
+ * holds, in any order apart from the load coming before the store:
+ *   copy:  lb/lbu t, off(src)   sb t, off(dst)   addi src, 1   addi dst, 1
+ *   fill:  sb v, off(dst)       addi dst, 1
+ * plus any further "addi r, 1" counters and, last, "bne c, e" where c is
+ * stepped by the body and e is not written by it. The trip count is then
+ * known when the branch returns to the head: the remaining iterations run
+ * until c reaches e.
+ *
+ * Registers and the instruction count come out exactly as if the
+ * iterations had run: every stepped register advances by the trip count,
+ * t holds the last byte loaded, and each iteration counts as its body's
+ * instructions. The loop runs normally instead when the trip count is 0
+ * (65536 iterations), a range wraps past 0xFFFF or touches a device page,
+ * the destination starts inside the source (a forward byte loop would
+ * repeat the pattern there) or the stores would overwrite the loop itself.
+ * Recognised loops are cached by address with their instruction words, so
+ * rewritten code is decoded again.
+ */
+#ifndef Z16IDIOM_H
+#define Z16IDIOM_H
+
+#include <stdint.h>
+
+// The BNE at branchPc has just jumped back to pc. If it closes a copy or
+// fill loop that is safe to replace, run the remaining iterations, leave pc
+// after the branch and return the instructions they retire; otherwise
+// return 0 and change nothing.
+uint64_t idiomLoop(uint16_t branchPc);
+
+// Print the loops replaced and the bytes they moved to stderr.
+void idiomReport(void);
+
+#endif // Z16IDIOM_H
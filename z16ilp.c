@@ -0,0 +1,342 @@
+/*
+ * Dependency critical-path and ILP analysis for the Z16 simulator.
+ *
+ * Spec syntax (comma separated, any order):
+ *   window=<n>   instructions in flight for the windowed schedule (default 64)
+ *   load=<n>     load latency in cycles; everything else takes 1 (default 1)
+ *   mul=<n>      M extension multiply latency (default 3)
+ *   div=<n>      M extension divide/remainder latency (default 12)
+ *   loops=<n>    hot loops listed in the report (default 10)
+ *
+ * Only true (read-after-write) dependences through registers and memory
+ * bytes are followed: renaming removes the others, and branches are assumed
+ * perfectly predicted, so the numbers are an upper bound on what wider
+ * hardware could exploit.
+ *
+ * Windowed schedule: instruction i may not start before instruction i-W has
+ * retired, and retirement is in order. The retire times of the last W
+ * instructions are kept in a ring.
+ *
+ * Loops are found from taken backward branches and jumps. An instruction
+ * belongs to the innermost known loop whose address range contains it, or,
+ * inside a function called from a loop, to the calling loop; calls are
+ * JAL/JALR and returns "jr ra", while any other jr is an ordinary jump. Each
+ * loop (and the code outside loops) is also scheduled on its own: values
+ * produced by the loop carry their ready time on the loop's timeline, while
+ * values from anywhere else count as ready when the current visit to the
+ * loop began. The loop's critical path divided by its iterations
+ * approximates the loop-carried recurrence.
+ */
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16ilp.h"
+#include "z16debuginfo.h"
+#include "z16spec.h"
+
+#define MAX_LOOPS 1024
+#define MAX_WINDOW 4096
+// A bulk copy reports both ranges, each in up to two pieces where it wraps,
+// and a DMA copy run inline adds them to the store that starts it.
+#define MAX_PENDING_ACCESSES 8
+#define MAX_CALL_DEPTH 256
+
+// One schedule: an unbounded dataflow machine and a windowed one.
+typedef struct {
+    uint64_t pathEnd;         // critical path so far (unbounded)
+    uint64_t retired;         // last retire cycle (windowed)
+    uint64_t pathBase;        // start of the current visit, per machine
+    uint64_t windowBase;
+    uint64_t count;           // instructions scheduled
+    uint64_t *ring;           // [windowSize] retire cycle of instruction i-W
+} Schedule;
+
+typedef struct {
+    uint16_t head, tail;      // address range [head, tail]
+    uint64_t iterations;      // taken back edges
+    Schedule sched;
+} Loop;
+
+// Ready time of one value on the timeline of the context that produced it
+typedef struct {
+    uint64_t path, window;
+    uint16_t context;
+} LocalReady;
+
+static uint32_t windowSize = 64;
+static uint64_t loadLatency = 1;
+static uint64_t mulLatency = 3;
+static uint64_t divLatency = 12;
+static int reportLoops = 10;
+
+static Schedule program;               // whole run
+static uint64_t regPath[8], regWindow[8];
+static uint64_t *memPath = NULL;       // [MEM_SIZE]
+static uint64_t *memWindow = NULL;     // [MEM_SIZE]
+
+static Loop loops[MAX_LOOPS + 1];      // entry 0 collects code outside loops
+static int loopCount = 0;
+static uint16_t *loopOf = NULL;        // [MEM_SIZE / 2] innermost loop id per pc
+static uint16_t *loopAtHead = NULL;    // [MEM_SIZE / 2] loop id by head pc
+static LocalReady regLocal[8];
+static LocalReady *memLocal = NULL;    // [MEM_SIZE]
+static int lastContext = -1;
+static uint16_t callContext[MAX_CALL_DEPTH];
+static int callDepth = 0;
+
+static uint16_t pendingAddr[MAX_PENDING_ACCESSES];
+static uint32_t pendingSize[MAX_PENDING_ACCESSES];
+static uint8_t pendingWrite[MAX_PENDING_ACCESSES];
+static int pendingCount = 0;
+static uint64_t droppedAccesses = 0;  // beyond MAX_PENDING_ACCESSES
+
+static uint64_t *newRing(void) {
+    uint64_t *ring = (uint64_t *)calloc(windowSize, sizeof(uint64_t));
+    if (!ring) { perror("malloc"); exit(1); }
+    return ring;
+}
+
+// The ranges are checked in ilpInit() once the value is a number.
+static int ilpItem(const char *key, char *value) {
+    uint64_t v;
+    if (specNumber(value, &v) != 0 || v > INT_MAX)
+        return -1;
+    if (strcmp(key, "window") == 0) windowSize = (uint32_t)v;
+    else if (strcmp(key, "load") == 0) loadLatency = v;
+    else if (strcmp(key, "mul") == 0) mulLatency = v;
+    else if (strcmp(key, "div") == 0) divLatency = v;
+    else if (strcmp(key, "loops") == 0) reportLoops = (int)v;
+    else return -1;
+    return 0;
+}
+
+int ilpInit(const char *spec) {
+    int status = specParse(spec, "window=64,load=1,mul=3,div=12,loops=10", "ILP", ilpItem);
+    if (status == 0 && (windowSize < 1 || windowSize > MAX_WINDOW || loadLatency < 1 ||
+                        mulLatency < 1 || divLatency < 1 || reportLoops < 0)) {
+        fprintf(stderr, "Error: ILP analysis needs 1 <= window <= %d, load, mul and div >= 1 and loops >= 0\n",
+                MAX_WINDOW);
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+
+    memPath = (uint64_t *)calloc(MEM_SIZE, sizeof(uint64_t));
+    memWindow = (uint64_t *)calloc(MEM_SIZE, sizeof(uint64_t));
+    memLocal = (LocalReady *)calloc(MEM_SIZE, sizeof(LocalReady));
+    loopOf = (uint16_t *)calloc(MEM_SIZE / 2, sizeof(uint16_t));
+    loopAtHead = (uint16_t *)calloc(MEM_SIZE / 2, sizeof(uint16_t));
+    if (!memPath || !memWindow || !memLocal || !loopOf || !loopAtHead) {
+        perror("malloc");
+        exit(1);
+    }
+    program.ring = newRing();
+    loops[0].sched.ring = newRing();
+    return 0;
+}
+
+void ilpAccess(uint16_t addr, int size, int isWrite) {
+    if (pendingCount < MAX_PENDING_ACCESSES) {
+        pendingAddr[pendingCount] = addr;
+        pendingSize[pendingCount] = (uint32_t)size;
+        pendingWrite[pendingCount] = (uint8_t)isWrite;
+        pendingCount++;
+    } else {
+        droppedAccesses++;
+    }
+}
+
+// Claim [head, tail] for `id` wherever no smaller loop already owns the pc.
+static void markLoop(int id) {
+    uint32_t span = (uint32_t)(loops[id].tail - loops[id].head);
+    for (uint32_t p = loops[id].head; p <= loops[id].tail; p += 2) {
+        int owner = loopOf[p >> 1];
+        if (owner == 0 || owner == id || (uint32_t)(loops[owner].tail - loops[owner].head) > span)
+            loopOf[p >> 1] = (uint16_t)id;
+    }
+}
+
+static void noteBackEdge(uint16_t instPc, uint16_t target) {
+    int id = loopAtHead[target >> 1];
+    if (id == 0) {
+        if (loopCount == MAX_LOOPS)
+            return;
+        id = ++loopCount;
+        loops[id].head = target;
+        loops[id].tail = instPc;
+        loops[id].sched.ring = newRing();
+        loopAtHead[target >> 1] = (uint16_t)id;
+        markLoop(id);
+    } else if (instPc > loops[id].tail) {
+        loops[id].tail = instPc; // another back edge further down
+        markLoop(id);
+    }
+    loops[id].iterations++;
+}
+
+// Place one instruction whose sources are ready at (path, window) on `s`;
+// returns its completion cycles through the same pointers.
+static void schedule(Schedule *s, uint64_t *path, uint64_t *window, uint64_t latency) {
+    // The window only admits instruction i once instruction i-W has retired.
+    uint64_t *slot = &s->ring[s->count++ % windowSize];
+    if (*slot > *window)
+        *window = *slot;
+    *path += latency;
+    *window += latency;
+    if (*path > s->pathEnd)
+        s->pathEnd = *path;
+    if (*window > s->retired)
+        s->retired = *window;
+    *slot = s->retired;
+}
+
+void ilpInstruction(uint16_t instPc, uint16_t inst) {
+    InstInfo info;
+    decodeOperands(inst, &info);
+
+    int context = loopOf[instPc >> 1];
+    if (context == 0 && callDepth > 0)
+        context = callContext[callDepth - 1];
+    Schedule *local = &loops[context].sched;
+    if (context != lastContext) {
+        // New visit: values from elsewhere are ready from here on.
+        local->pathBase = local->pathEnd;
+        local->windowBase = local->retired;
+        lastContext = context;
+    }
+
+    // Earliest start on each machine: all sources produced.
+    uint64_t path = 0, window = 0;
+    uint64_t localPath = local->pathBase, localWindow = local->windowBase;
+#define READY(globalPath, globalWindow, lr) do { \
+        if ((globalPath) > path) path = (globalPath); \
+        if ((globalWindow) > window) window = (globalWindow); \
+        if ((lr).context == context) { \
+            if ((lr).path > localPath) localPath = (lr).path; \
+            if ((lr).window > localWindow) localWindow = (lr).window; \
+        } \
+    } while (0)
+    for (int r = 0; r < 8; r++) {
+        if ((info.srcMask >> r) & 1)
+            READY(regPath[r], regWindow[r], regLocal[r]);
+    }
+    for (int i = 0; i < pendingCount; i++) {
+        if (pendingWrite[i])
+            continue;
+        for (uint32_t b = 0; b < pendingSize[i]; b++) {
+            uint16_t a = (uint16_t)(pendingAddr[i] + b);
+            READY(memPath[a], memWindow[a], memLocal[a]);
+        }
+    }
+#undef READY
+
+    uint64_t latency = 1;
+    if (info.kind == KIND_LOAD)
+        latency = loadLatency;
+    else if (info.kind == KIND_MUL)
+        latency = mulLatency;
+    else if (info.kind == KIND_DIV)
+        latency = divLatency;
+    schedule(&program, &path, &window, latency);
+    schedule(local, &localPath, &localWindow, latency);
+    LocalReady produced = { localPath, localWindow, (uint16_t)context };
+
+    for (int r = 0; r < 8; r++) {
+        if ((info.dstMask >> r) & 1) {
+            regPath[r] = path;
+            regWindow[r] = window;
+            regLocal[r] = produced;
+        }
+    }
+    for (int i = 0; i < pendingCount; i++) {
+        if (!pendingWrite[i])
+            continue;
+        for (uint32_t b = 0; b < pendingSize[i]; b++) {
+            uint16_t a = (uint16_t)(pendingAddr[i] + b);
+            memPath[a] = path;
+            memWindow[a] = window;
+            memLocal[a] = produced;
+        }
+    }
+    pendingCount = 0;
+
+    // Calls carry the loop context into the callee; "jr ra" returns restore
+    // it. Any other jr is a computed jump, such as a jump table's.
+    int taken = pc != (uint16_t)(instPc + 2);
+    int linking = info.dstMask != 0;
+    if ((info.kind == KIND_JUMP && linking) || (info.kind == KIND_JUMP_REG && linking)) {
+        if (callDepth < MAX_CALL_DEPTH)
+            callContext[callDepth++] = (uint16_t)context;
+    } else if (info.kind == KIND_JUMP_REG && info.srcMask == 1 << REG_RA) {
+        if (callDepth > 0)
+            callDepth--;
+    } else if ((info.kind == KIND_BRANCH || info.kind == KIND_JUMP || info.kind == KIND_JUMP_REG) &&
+               taken && pc <= instPc) {
+        // A taken backward branch or jump closes a loop iteration.
+        noteBackEdge(instPc, pc);
+    }
+}
+
+static double ratio(uint64_t num, uint64_t den) {
+    return den ? (double)num / den : 0.0;
+}
+
+void ilpReport(void) {
+    fprintf(stderr, "\n--- ILP Analysis (window %u, load latency %llu, mul %llu, div %llu) ---\n",
+            windowSize, (unsigned long long)loadLatency, (unsigned long long)mulLatency,
+            (unsigned long long)divLatency);
+    fprintf(stderr, "Instructions: %llu  Critical path: %llu cycles\n",
+            (unsigned long long)program.count, (unsigned long long)program.pathEnd);
+    fprintf(stderr, "ILP: %.2f unbounded, %.2f with a %u-instruction window\n",
+            ratio(program.count, program.pathEnd), ratio(program.count, program.retired), windowSize);
+
+    if (loopCount > 0 && reportLoops > 0) {
+        fprintf(stderr, "Hot loops (by instructions, including called functions):\n");
+        fprintf(stderr, "  %-13s %12s %14s %9s %10s %8s %8s\n", "range", "iterations",
+                "instructions", "inst/iter", "path/iter", "ILP", "ILP(win)");
+    }
+    for (int k = 0; k < reportLoops; k++) {
+        int best = 0;
+        for (int id = 1; id <= loopCount; id++) {
+            if (loops[id].sched.count && (best == 0 || loops[id].sched.count > loops[best].sched.count))
+                best = id;
+        }
+        if (best == 0)
+            break;
+        Loop *l = &loops[best];
+        char name[96], where[96];
+        fprintf(stderr, "  0x%04X-0x%04X %12llu %14llu %9.1f %10.2f %8.2f %8.2f",
+                l->head, l->tail, (unsigned long long)l->iterations,
+                (unsigned long long)l->sched.count, ratio(l->sched.count, l->iterations),
+                ratio(l->sched.pathEnd, l->iterations), ratio(l->sched.count, l->sched.pathEnd),
+                ratio(l->sched.count, l->sched.retired));
+        if (debugInfoLoaded())
+            fprintf(stderr, "  %s %s", debugName(l->head, name, sizeof(name)),
+                    debugLocation(l->head, where, sizeof(where)));
+        fputc('\n', stderr);
+        l->sched.count = 0; // taken
+    }
+    if (loopCount > 0)
+        fprintf(stderr, "  outside loops %12s %14llu %9s %10s %8.2f %8.2f\n", "",
+                (unsigned long long)loops[0].sched.count, "", "",
+                ratio(loops[0].sched.count, loops[0].sched.pathEnd),
+                ratio(loops[0].sched.count, loops[0].sched.retired));
+    if (loopCount == MAX_LOOPS)
+        fprintf(stderr, "  (loop table full: later loops are counted with their callers)\n");
+    if (droppedAccesses)
+        fprintf(stderr, "  (%llu memory accesses beyond %d per instruction were left out of the dependences)\n",
+                (unsigned long long)droppedAccesses, MAX_PENDING_ACCESSES);
+
+    free(program.ring);
+    for (int id = 0; id <= loopCount; id++)
+        free(loops[id].sched.ring);
+    free(memPath);
+    free(memWindow);
+    free(memLocal);
+    free(loopOf);
+    free(loopAtHead);
+}
@@ -0,0 +1,31 @@
+/*
+ * Dependency critical-path and instruction-level parallelism analysis for
+ * the Z16 simulator.
+ *
+ * Every retired instruction is scheduled on an idealised dataflow machine
+ * as soon as the registers and memory bytes it reads have been produced.
+ * The longest chain gives the dynamic critical path; instructions divided by
+ * it is the available ILP. A second schedule limits how far ahead issue may
+ * run to a window of the last W instructions, as a real out-of-order core
+ * would. Both are computed on the fly from per-register and per-byte ready
+ * times, so the analysis needs no trace and O(1) work per instruction.
+ */
+#ifndef Z16ILP_H
+#define Z16ILP_H
+
+#include <stdint.h>
+
+// Parse a spec such as "window=64,load=2,loops=10" (or "default").
+// Returns 0 on success.
+int ilpInit(const char *spec);
+
+// Record a data access of the instruction being executed (L/S handlers).
+void ilpAccess(uint16_t addr, int size, int isWrite);
+
+// Schedule one retired instruction; call after executeInstruction(inst).
+void ilpInstruction(uint16_t instPc, uint16_t inst);
+
+// Print program and per-loop critical path and ILP to stderr.
+void ilpReport(void);
+
+#endif // Z16ILP_H
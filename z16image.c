@@ -0,0 +1,103 @@
+/*
+ * Program image loader (see z16image.h for the formats).
+ *
+ * The file is mapped read-only and private, and only the bytes a segment
+ * holds are copied out of the mapping; gaps and zero-fill segments are
+ * never read from disk.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "z16image.h"
+#include "z16debug.h"
+
+// Copy the part of [addr, addr+n) that lies in [lo, hi); src NULL fills zeros.
+static void place(unsigned char *dst, uint32_t lo, uint32_t hi,
+                  uint32_t addr, const unsigned char *src, uint32_t n) {
+    uint64_t start = addr > lo ? addr : lo;
+    uint64_t stop = (uint64_t)addr + n < hi ? (uint64_t)addr + n : hi;
+    if (start >= stop)
+        return;
+    if (src)
+        memcpy(dst + (start - lo), src + (start - addr), (size_t)(stop - start));
+    else
+        memset(dst + (start - lo), 0, (size_t)(stop - start));
+}
+
+static int loadSegments(const char *path, const unsigned char *h, size_t size, unsigned char *dst,
+                        uint32_t lo, uint32_t hi, uint16_t *entry, uint32_t *end) {
+    uint32_t count = debugGet32(&h[12]);
+    if (debugGet16(&h[8]) != IMAGE_VERSION ||
+        IMAGE_HEADER_BYTES + (uint64_t)count * IMAGE_SEGMENT_BYTES > size) {
+        fprintf(stderr, "Error: %s is not a Z16 image (or has the wrong version)\n", path);
+        return -1;
+    }
+    uint32_t top = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *s = h + IMAGE_HEADER_BYTES + (size_t)i * IMAGE_SEGMENT_BYTES;
+        uint32_t addr = debugGet32(s), offset = debugGet32(s + 4);
+        uint32_t fileBytes = debugGet32(s + 8), memBytes = debugGet32(s + 12);
+        if (fileBytes > memBytes || (uint64_t)offset + fileBytes > size) {
+            fprintf(stderr, "Error: segment %u of %s is damaged\n", i, path);
+            return -1;
+        }
+        place(dst, lo, hi, addr, h + offset, fileBytes);
+        place(dst, lo, hi, addr + fileBytes, NULL, memBytes - fileBytes);
+        if (addr + memBytes > top)
+            top = addr + memBytes;
+    }
+    if (entry)
+        *entry = debugGet16(&h[10]);
+    if (end)
+        *end = top;
+    return 0;
+}
+
+int imageLoad(const char *path, unsigned char *dst, uint32_t lo, uint32_t hi,
+              uint16_t *entry, uint32_t *end) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening binary file");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Error opening binary file");
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        if (entry)
+            *entry = 0;
+        if (end)
+            *end = 0;
+        return 0;
+    }
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Error mapping binary file");
+        return -1;
+    }
+    const unsigned char *h = (const unsigned char *)map;
+    int status = 0;
+    if (size >= IMAGE_HEADER_BYTES && memcmp(h, IMAGE_MAGIC, 8) == 0) {
+        status = loadSegments(path, h, size, dst, lo, hi, entry, end);
+    } else {
+        place(dst, lo, hi, 0, h, size > UINT32_MAX ? UINT32_MAX : (uint32_t)size);
+        if (entry)
+            *entry = 0;
+        if (end)
+            *end = (uint32_t)size;
+    }
+    munmap(map, size);
+    return status;
+}
@@ -0,0 +1,45 @@
+/*
+ * Z16 program images: the flat .bin the assembler writes by default (byte n
+ * of the file is loaded at address n) and the segmented format below,
+ * written by z16asm -s. The loader tells them apart by the magic.
+ *
+ * All integers are little-endian.
+ *
+ *   Header (24 bytes)
+ *     "Z16IMAGE"         magic
+ *     u16 version        IMAGE_VERSION
+ *     u16 entry          initial pc
+ *     u32 segmentCount
+ *     u32 reserved
+ *     u32 reserved
+ *
+ *   Segments segmentCount x { u32 address, u32 fileOffset, u32 fileBytes,
+ *                             u32 memBytes, u16 flags, u16 reserved }
+ *            sorted by address and not overlapping; memBytes >= fileBytes
+ *            and the bytes past fileBytes are zero (.space), so they take
+ *            no room in the file. Addresses are physical: past 0xFFFF they
+ *            are only loaded with --mmu.
+ *   Data     the segments' file bytes at their offsets
+ */
+#ifndef Z16IMAGE_H
+#define Z16IMAGE_H
+
+#include <stdint.h>
+
+#define IMAGE_MAGIC          "Z16IMAGE"
+#define IMAGE_VERSION        1
+#define IMAGE_HEADER_BYTES   24
+#define IMAGE_SEGMENT_BYTES  20
+
+#define IMAGE_SEG_TEXT       1   // holds instructions
+#define IMAGE_SEG_DATA       2   // holds data or reserved space
+
+// Copy the bytes of the image at `path` whose addresses lie in [lo, hi) to
+// dst + (address - lo); bytes it does not define are left alone. Sets
+// *entry (if not NULL) to the entry point, 0 for a flat image, and *end (if
+// not NULL) to one past the highest address it defines. Returns 0 on
+// success.
+int imageLoad(const char *path, unsigned char *dst, uint32_t lo, uint32_t hi,
+              uint16_t *entry, uint32_t *end);
+
+#endif // Z16IMAGE_H
@@ -0,0 +1,168 @@
+/*
+ * Guest memory-access heatmap and per-instruction stride analysis.
+ *
+ * Counters live in flat arrays indexed by address and by instruction slot
+ * (pc / 2), so recording an access is a handful of increments with no
+ * lookups or allocation. Stride detection keeps, per load/store PC, the last
+ * address, the last delta, how often the delta repeated, and a majority-vote
+ * candidate for the dominant stride.
+ *
+ * Heatmap file: one "address reads writes" line per touched byte, preceded by
+ * one "# page" summary line per touched 256-byte page.
+ * Stride file: one line per load/store PC, hottest first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16memprof.h"
+#include "z16debuginfo.h"
+
+#define PAGE_SIZE 256
+
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+    uint16_t lastAddr;
+    int16_t lastDelta;
+    uint64_t repeats;      // transitions whose delta equals the previous one
+    int16_t candidate;     // majority-vote dominant stride
+    uint64_t votes;
+    uint8_t size;          // access size in bytes
+} PcStride;
+
+static uint64_t *readCount = NULL;   // [MEM_SIZE]
+static uint64_t *writeCount = NULL;  // [MEM_SIZE]
+static PcStride *pcStride = NULL;    // [MEM_SIZE / 2]
+
+void memprofInit(void) {
+    readCount = (uint64_t *)calloc(MEM_SIZE, sizeof(uint64_t));
+    writeCount = (uint64_t *)calloc(MEM_SIZE, sizeof(uint64_t));
+    pcStride = (PcStride *)calloc(MEM_SIZE / 2, sizeof(PcStride));
+    if (!readCount || !writeCount || !pcStride) { perror("calloc"); exit(1); }
+}
+
+void memprofAccess(uint16_t instPc, uint16_t addr, int size, int isWrite) {
+    uint64_t *counts = isWrite ? writeCount : readCount;
+    for (int i = 0; i < size; i++)
+        counts[(uint16_t)(addr + i)]++;
+
+    PcStride *s = &pcStride[instPc >> 1];
+    uint64_t seen = s->reads + s->writes;
+    if (isWrite) s->writes++; else s->reads++;
+    s->size = (uint8_t)size;
+    if (seen > 0) {
+        int16_t delta = (int16_t)(uint16_t)(addr - s->lastAddr);
+        if (seen > 1 && delta == s->lastDelta)
+            s->repeats++;
+        if (s->votes == 0) {
+            s->candidate = delta;
+            s->votes = 1;
+        } else if (delta == s->candidate) {
+            s->votes++;
+        } else {
+            s->votes--;
+        }
+        s->lastDelta = delta;
+    }
+    s->lastAddr = addr;
+}
+
+static void classify(const PcStride *s, char *buf, size_t bufSize) {
+    uint64_t accesses = s->reads + s->writes;
+    if (accesses < 3) {
+        snprintf(buf, bufSize, "too-few");
+        return;
+    }
+    // repeats counts matches among the (accesses - 2) delta pairs.
+    double regularity = (double)s->repeats / (accesses - 2);
+    if (regularity < 0.75)
+        snprintf(buf, bufSize, "random");
+    else if (s->candidate == 0)
+        snprintf(buf, bufSize, "same-address");
+    else if (s->candidate == s->size || s->candidate == -s->size)
+        snprintf(buf, bufSize, "sequential(%+d)", s->candidate);
+    else
+        snprintf(buf, bufSize, "stride(%+d)", s->candidate);
+}
+
+static int compareHotness(const void *a, const void *b) {
+    const PcStride *x = &pcStride[*(const int *)a];
+    const PcStride *y = &pcStride[*(const int *)b];
+    uint64_t nx = x->reads + x->writes, ny = y->reads + y->writes;
+    return (nx < ny) - (nx > ny);
+}
+
+static void writeHeatmap(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening heatmap file");
+        return;
+    }
+    fprintf(fp, "# address reads writes\n");
+    for (int page = 0; page < MEM_SIZE; page += PAGE_SIZE) {
+        uint64_t pageReads = 0, pageWrites = 0;
+        for (int a = page; a < page + PAGE_SIZE; a++) {
+            pageReads += readCount[a];
+            pageWrites += writeCount[a];
+        }
+        if (pageReads == 0 && pageWrites == 0)
+            continue;
+        fprintf(fp, "# page 0x%04X reads %llu writes %llu\n", page,
+                (unsigned long long)pageReads, (unsigned long long)pageWrites);
+        for (int a = page; a < page + PAGE_SIZE; a++) {
+            if (readCount[a] || writeCount[a])
+                fprintf(fp, "0x%04X %llu %llu\n", a, (unsigned long long)readCount[a],
+                        (unsigned long long)writeCount[a]);
+        }
+    }
+    fclose(fp);
+}
+
+static void writeStrides(const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening stride summary file");
+        return;
+    }
+    int *order = (int *)malloc((MEM_SIZE / 2) * sizeof(int));
+    if (!order) { perror("malloc"); exit(1); }
+    int n = 0;
+    for (int i = 0; i < MEM_SIZE / 2; i++) {
+        if (pcStride[i].reads || pcStride[i].writes)
+            order[n++] = i;
+    }
+    qsort(order, n, sizeof(int), compareHotness);
+
+    fprintf(fp, "# pc      accesses  reads     writes    pattern           disassembly  [source]\n");
+    char pattern[32], disasm[128], where[96];
+    for (int k = 0; k < n; k++) {
+        const PcStride *s = &pcStride[order[k]];
+        uint16_t instPc = (uint16_t)(order[k] << 1);
+        uint16_t inst = memory[instPc] | (memory[instPc + 1] << 8);
+        classify(s, pattern, sizeof(pattern));
+        disassemble(inst, instPc, disasm, sizeof(disasm));
+        fprintf(fp, "0x%04X  %-9llu %-9llu %-9llu %-17s %-24s %s\n", instPc,
+                (unsigned long long)(s->reads + s->writes), (unsigned long long)s->reads,
+                (unsigned long long)s->writes, pattern, disasm,
+                debugLocation(instPc, where, sizeof(where)));
+    }
+    free(order);
+    fclose(fp);
+}
+
+void memprofWrite(const char *filename) {
+    char strideName[512];
+    snprintf(strideName, sizeof(strideName), "%s.strides", filename);
+    writeHeatmap(filename);
+    writeStrides(strideName);
+    fprintf(stderr, "Memory heatmap generated: %s, %s\n", filename, strideName);
+
+    free(readCount);
+    free(writeCount);
+    free(pcStride);
+    readCount = writeCount = NULL;
+    pcStride = NULL;
+}
@@ -0,0 +1,22 @@
+/*
+ * Guest memory-access heatmap and per-instruction stride analysis.
+ *
+ * Fed from the L/S handlers of executeInstruction(); keeps per-byte read and
+ * write counters over the 64KB address space and classifies the address
+ * stream of every load/store PC (sequential, fixed stride, same address or
+ * irregular).
+ */
+#ifndef Z16MEMPROF_H
+#define Z16MEMPROF_H
+
+#include <stdint.h>
+
+void memprofInit(void);
+
+// Record one data access of `size` bytes at `addr` made by the instruction at `instPc`.
+void memprofAccess(uint16_t instPc, uint16_t addr, int size, int isWrite);
+
+// Write the heatmap to <file> and the stride summary to <file>.strides.
+void memprofWrite(const char *filename);
+
+#endif // Z16MEMPROF_H
@@ -0,0 +1,127 @@
+/*
+ * Simulator side of the live metrics segment (layout: z16metrics.h).
+ *
+ * Counting happens in plain process-local counters. They are copied to the
+ * shared segment with relaxed stores at the end of a basic block once at
+ * least METRICS_PUBLISH_INTERVAL instructions have retired since the last
+ * copy, so the hot loop never takes a lock or makes a system call. The rate
+ * is refreshed every METRICS_RATE_INTERVAL instructions from
+ * CLOCK_MONOTONIC, which the vDSO serves without entering the kernel.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "z16sim.h"
+#include "z16metrics.h"
+
+#define METRICS_PUBLISH_INTERVAL 1024
+#define METRICS_RATE_INTERVAL (1u << 20)
+
+static Z16Metrics *shared = NULL;
+static char shmName[64];
+static uint64_t opcodeCounts[8];
+static uint64_t ecallCounts[16];
+static uint64_t lastPublished = 0;
+static uint64_t lastRateCount = 0;
+static uint64_t lastRateNs = 0;
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Interrupted runs never reach atexit(); drop the name, then die as before.
+static void unlinkOnSignal(int sig) {
+    shm_unlink(shmName);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+int metricsOpen(const char *program) {
+    snprintf(shmName, sizeof(shmName), METRICS_SHM_PREFIX "%d", (int)getpid());
+    int fd = shm_open(shmName, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creating metrics segment");
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(Z16Metrics)) != 0) {
+        perror("Error sizing metrics segment");
+        close(fd);
+        shm_unlink(shmName);
+        return -1;
+    }
+    shared = (Z16Metrics *)mmap(NULL, sizeof(Z16Metrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        perror("Error mapping metrics segment");
+        shared = NULL;
+        shm_unlink(shmName);
+        return -1;
+    }
+    // The fresh segment is zero-filled; fill the identity fields, then
+    // publish the magic last so readers never see a half-initialised record.
+    shared->version = METRICS_VERSION;
+    shared->size = sizeof(Z16Metrics);
+    shared->pid = (int32_t)getpid();
+    const char *base = strrchr(program, '/');
+    strncpy(shared->program, base ? base + 1 : program, sizeof(shared->program) - 1);
+    shared->startNs = lastRateNs = monotonicNs();
+    atomic_store_explicit(&shared->updateNs, shared->startNs, memory_order_relaxed);
+    atomic_store_explicit(&shared->state, METRICS_RUNNING, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    shared->magic = METRICS_MAGIC;
+    atexit(metricsClose); // also unlink when the simulator exits early
+    signal(SIGINT, unlinkOnSignal);
+    signal(SIGTERM, unlinkOnSignal);
+    return 0;
+}
+
+void metricsInstruction(uint16_t inst) {
+    opcodeCounts[inst & 0x7]++;
+    if ((inst & 0x7) == 0x7)
+        ecallCounts[(inst >> 3) & 0xF]++;
+}
+
+static void publish(void) {
+    atomic_store_explicit(&shared->instructions, instructionCount, memory_order_relaxed);
+    atomic_store_explicit(&shared->pc, pc, memory_order_relaxed);
+    for (int i = 0; i < 8; i++)
+        atomic_store_explicit(&shared->opcodes[i], opcodeCounts[i], memory_order_relaxed);
+    for (int i = 0; i < 16; i++)
+        atomic_store_explicit(&shared->ecalls[i], ecallCounts[i], memory_order_relaxed);
+    lastPublished = instructionCount;
+
+    if (instructionCount - lastRateCount >= METRICS_RATE_INTERVAL) {
+        uint64_t now = monotonicNs();
+        if (now > lastRateNs) {
+            uint64_t rate = (instructionCount - lastRateCount) * 1000000000ull / (now - lastRateNs);
+            atomic_store_explicit(&shared->instructionsPerSecond, rate, memory_order_relaxed);
+        }
+        atomic_store_explicit(&shared->updateNs, now, memory_order_relaxed);
+        lastRateCount = instructionCount;
+        lastRateNs = now;
+    }
+}
+
+void metricsBlockEnd(void) {
+    if (instructionCount - lastPublished >= METRICS_PUBLISH_INTERVAL)
+        publish();
+}
+
+void metricsClose(void) {
+    if (!shared)
+        return;
+    publish();
+    atomic_store_explicit(&shared->state, METRICS_EXITED, memory_order_relaxed);
+    munmap(shared, sizeof(Z16Metrics));
+    shared = NULL;
+    shm_unlink(shmName);
+}
@@ -0,0 +1,49 @@
+/*
+ * Live simulator metrics published through POSIX shared memory.
+ *
+ * Each simulator started with --metrics creates the segment
+ * METRICS_SHM_PREFIX<pid> holding one Z16Metrics record. The simulator is the
+ * only writer and publishes with relaxed atomic stores; readers such as
+ * z16top map the segment read-only and check magic, version and size before
+ * trusting the fields. New fields are only ever appended, with a version
+ * bump, so older readers keep working.
+ */
+#ifndef Z16METRICS_H
+#define Z16METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define METRICS_MAGIC      0x4D36315Au // "Z16M"
+#define METRICS_VERSION    1
+#define METRICS_SHM_PREFIX "/z16sim."
+#define METRICS_SHM_DIR    "/dev/shm"  // where the segments show up on Linux
+
+#define METRICS_RUNNING 1
+#define METRICS_EXITED  2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                         // sizeof(Z16Metrics) of the writer
+    int32_t pid;
+    char program[64];                      // guest image name
+    uint64_t startNs;                      // CLOCK_MONOTONIC at start
+    _Atomic uint32_t state;                // METRICS_RUNNING / METRICS_EXITED
+    _Atomic uint32_t pc;                   // pc at the last publish
+    _Atomic uint64_t instructions;         // instructions retired
+    _Atomic uint64_t instructionsPerSecond; // rate over the last rate interval
+    _Atomic uint64_t updateNs;             // CLOCK_MONOTONIC of the last rate update
+    _Atomic uint64_t ecalls[16];           // per ecall service number
+    _Atomic uint64_t opcodes[8];           // per major opcode
+} Z16Metrics;
+
+#ifdef Z16SIM_H
+// Simulator side (z16metrics.c)
+int metricsOpen(const char *program);
+void metricsInstruction(uint16_t inst);
+void metricsBlockEnd(void);
+void metricsClose(void);
+#endif
+
+#endif // Z16METRICS_H
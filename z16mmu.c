@@ -0,0 +1,167 @@
+/*
+ * Banked memory (see z16mmu.h for the guest's view).
+ *
+ * Spec syntax (comma separated, any order):
+ *   phys=<bytes>   physical memory, a multiple of the bank size from 64 KB
+ *                  to 16 MB; k and m suffixes (default 1m)
+ *   bank=<bytes>   bank size, a power of two from 1 KB to 32 KB (default 4k)
+ *   base=<addr>    bank register window, a multiple of 256 (default 0xFE00)
+ *
+ * Physical memory holds every bank that is not mapped; the copy of a mapped
+ * bank in it is stale until the bank is unmapped again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16bus.h"
+#include "z16mmu.h"
+#include "z16image.h"
+#include "z16spec.h"
+
+#define MAX_PHYS (16u * 1024 * 1024)
+#define MAX_BANKS (MEM_SIZE / 1024)
+
+static uint32_t physSize = 1024 * 1024;
+static uint32_t bankSize = 4096;
+static uint32_t base = 0xFE00;
+static MmuObserve observer = NULL;
+
+static unsigned char *phys = NULL;
+static uint32_t bankCount;              // virtual banks
+static uint32_t physBanks;
+static uint16_t mapping[MAX_BANKS];     // virtual bank -> physical bank
+static int32_t *residentAt = NULL;      // physical bank -> virtual bank, or -1
+
+static uint64_t remaps = 0;
+static uint64_t refused = 0;
+
+// A bank holding a device page cannot move: the device's registers live in
+// its backing memory.
+static int bankFixed(uint32_t v) {
+    for (uint32_t p = v * bankSize >> BUS_PAGE_BITS; p < (v + 1) * bankSize >> BUS_PAGE_BITS; p++)
+        if (!busRam[p])
+            return 1;
+    return 0;
+}
+
+static void remap(uint32_t v, uint16_t target) {
+    uint16_t old = mapping[v];
+    if (target == old)
+        return;
+    if (target >= physBanks || residentAt[target] >= 0 || bankFixed(v)) {
+        refused++;
+        return;
+    }
+    uint16_t addr = (uint16_t)(v * bankSize);
+    if (observer)
+        observer(addr, (int)bankSize, 1);
+    memcpy(phys + (size_t)old * bankSize, &memory[addr], bankSize);
+    memcpy(&memory[addr], phys + (size_t)target * bankSize, bankSize);
+    residentAt[old] = -1;
+    residentAt[target] = (int32_t)v;
+    mapping[v] = target;
+    remaps++;
+}
+
+// -----------------------
+// Bus device
+// -----------------------
+// The bank registers are kept in the backing memory of their page, which
+// always reads back the mapping; the rest of the page is RAM.
+
+static void syncRegister(uint32_t v) {
+    uint32_t a = base + 4 * v;
+    memory[a] = (uint8_t)mapping[v];
+    memory[a + 1] = (uint8_t)(mapping[v] >> 8);
+    memory[a + 2] = memory[a + 3] = 0;
+}
+
+static uint32_t deviceRead(void *ctx, uint16_t addr, int size) {
+    (void)ctx;
+    uint32_t value = 0;
+    for (int i = 0; i < size; i++)
+        value |= (uint32_t)memory[(uint32_t)addr + i] << (8 * i);
+    return value;
+}
+
+// A word store sets a whole register before its bank moves.
+static void deviceWrite(void *ctx, uint16_t addr, int size, uint32_t value) {
+    (void)ctx;
+    for (int i = 0; i < size; i++)
+        memory[(uint32_t)addr + i] = (uint8_t)(value >> (8 * i));
+    uint32_t end = base + 4 * bankCount;
+    for (uint32_t a = addr; a < (uint32_t)addr + size; a++) {
+        if (a < base || a >= end || (a > addr && (a - base) % 4 != 0))
+            continue;
+        uint32_t v = (a - base) / 4;
+        remap(v, (uint16_t)(memory[base + 4 * v] | memory[base + 4 * v + 1] << 8));
+        syncRegister(v);
+    }
+}
+
+static int mmuItem(const char *key, char *value) {
+    uint64_t v;
+    if (strcmp(key, "phys") == 0 && specBytes(value, &v) == 0) physSize = (uint32_t)v;
+    else if (strcmp(key, "bank") == 0 && specBytes(value, &v) == 0) bankSize = (uint32_t)v;
+    else if (strcmp(key, "base") == 0 && specNumber(value, &v) == 0) base = (uint32_t)v;
+    else return -1;
+    return 0;
+}
+
+int mmuInit(const char *spec, const char *imageFile, MmuObserve observe) {
+    if (specParse(spec, "", "MMU", mmuItem) != 0)
+        return -1;
+    if (bankSize < 1024 || bankSize > 32768 || (bankSize & (bankSize - 1)) != 0) {
+        fprintf(stderr, "Error: MMU bank size must be a power of two from 1k to 32k\n");
+        return -1;
+    }
+    if (physSize < MEM_SIZE || physSize > MAX_PHYS || physSize % bankSize != 0) {
+        fprintf(stderr, "Error: MMU physical memory must be a multiple of the bank size from 64k to 16m\n");
+        return -1;
+    }
+    if (base % BUS_PAGE_SIZE != 0 || base >= MEM_SIZE) {
+        fprintf(stderr, "Error: MMU base must be a multiple of %d below 0x%X\n", BUS_PAGE_SIZE, MEM_SIZE);
+        return -1;
+    }
+    bankCount = MEM_SIZE / bankSize;
+    physBanks = physSize / bankSize;
+    phys = (unsigned char *)calloc(physSize, 1);
+    residentAt = (int32_t *)malloc(physBanks * sizeof(int32_t));
+    if (!phys || !residentAt) {
+        perror("malloc");
+        exit(1);
+    }
+    for (uint32_t p = 0; p < physBanks; p++)
+        residentAt[p] = p < bankCount ? (int32_t)p : -1;
+    for (uint32_t v = 0; v < bankCount; v++) {
+        mapping[v] = (uint16_t)v;
+        syncRegister(v);
+    }
+
+    // The first 64 KB of the image were loaded into the resident banks.
+    uint32_t end;
+    if (imageLoad(imageFile, phys + MEM_SIZE, MEM_SIZE, physSize, NULL, &end) != 0)
+        return -1;
+    if (end > physSize) {
+        fprintf(stderr, "Error: image is larger than the %u bytes of physical memory\n", physSize);
+        return -1;
+    }
+
+    if (busMap((uint16_t)base, BUS_PAGE_SIZE, "MMU bank registers", deviceRead, deviceWrite, NULL) != 0)
+        return -1;
+    observer = observe;
+    return 0;
+}
+
+void mmuClose(void) {
+    fprintf(stderr, "mmu: %u banks of %u bytes over %u KB physical, %llu remaps, %llu refused\n",
+            bankCount, bankSize, physSize / 1024, (unsigned long long)remaps,
+            (unsigned long long)refused);
+    free(phys);
+    free(residentAt);
+    phys = NULL;
+    residentAt = NULL;
+}
@@ -0,0 +1,43 @@
+/*
+ * Banked memory for the Z16 simulator: a physical memory larger than the
+ * 64 KB address space, seen through bank registers.
+ *
+ * The address space is split into equal banks (4 KB by default); bank
+ * register i holds the physical bank that appears at virtual bank i. The
+ * registers sit at 4-byte strides in a memory-mapped window (default
+ * 0xFE00) so that SW/LW touch one register each:
+ *   +4*i  BANK_i  physical bank of virtual bank i (reads back the mapping)
+ * At reset virtual bank i maps physical bank i, so ordinary programs do
+ * not notice the MMU (except that the register window replaces the image
+ * bytes under it). An image may reach past 64 KB into physical memory: byte
+ * n of a flat file, or a segment at address n, is physical byte n.
+ *
+ * The banks currently mapped are kept resident in `memory`: a write to a
+ * bank register copies the old bank out to physical memory and the new one
+ * in, before the next instruction. Translation therefore costs nothing on
+ * fetches, loads, stores and ecalls, and every other module keeps working
+ * on the virtual view. A remap reports its bank as written to the load/store
+ * instrumentation.
+ *
+ * A write is refused (the register keeps its old value) when the physical
+ * bank does not exist, is already mapped at another virtual bank, or the
+ * virtual bank holds a device page; run bank-switching code from such a
+ * fixed bank or from one that stays mapped.
+ */
+#ifndef Z16MMU_H
+#define Z16MMU_H
+
+#include <stdint.h>
+
+// Reports the bytes a remap replaces; called before guest memory changes.
+typedef void (*MmuObserve)(uint16_t addr, int size, int isWrite);
+
+// Parse a spec such as "phys=1m,bank=4k,base=0xFE00" (or "default"), map
+// the bank registers onto the bus and load the part of the image past
+// 64 KB into physical memory. Returns 0 on success.
+int mmuInit(const char *spec, const char *imageFile, MmuObserve observe);
+
+// Print remap statistics to stderr and free physical memory.
+void mmuClose(void);
+
+#endif // Z16MMU_H
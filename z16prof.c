@@ -0,0 +1,231 @@
+/*
+ * Call-graph profiler for the Z16 simulator.
+ *
+ * Every distinct call path is a node in a calling-context tree. The profiler
+ * keeps a shadow stack of (node, link value) frames; retiring an instruction
+ * costs one counter increment plus a few bit tests on the instruction word,
+ * so it can stay enabled for long runs.
+ *
+ *   - A call is a JAL or JALR whose link register is ra. It pushes the child
+ *     of the current node for the target address.
+ *   - A return is a JR through ra. The shadow stack is searched from the top
+ *     for the frame whose recorded link equals ra, so returns that skip
+ *     frames (longjmp-style unwinding) pop everything above the match.
+ *     A JR ra that matches no frame is counted and treated as a jump.
+ *   - A jump (J, JR/JALR not involving ra) to an address that has already
+ *     been seen as a call target is a tail call: the top frame is replaced
+ *     by the sibling for the new function and keeps its link value.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16prof.h"
+#include "z16debuginfo.h"
+
+#define MAX_CALL_DEPTH 4096
+
+typedef struct {
+    uint16_t entry;    // function entry address
+    int parent;        // parent node index (-1 for the root)
+    int firstChild;    // first callee node
+    int nextSibling;   // next callee of the parent
+    uint64_t self;     // instructions retired while this path was on top
+} CallNode;
+
+typedef struct {
+    int node;          // calling-context node of this frame
+    uint16_t link;     // value the call wrote into ra
+} Frame;
+
+static CallNode *nodes = NULL;
+static int nodeCount = 0;
+static int nodeCapacity = 0;
+
+static Frame stack[MAX_CALL_DEPTH];
+static int depth = 0;  // index of the top frame
+
+static unsigned char knownEntry[MEM_SIZE / 8]; // bitmap of call targets
+
+static uint64_t callCount = 0;
+static uint64_t returnCount = 0;
+static uint64_t unmatchedReturns = 0;
+static uint64_t tailCalls = 0;
+static uint64_t depthOverflows = 0;
+
+static int newNode(uint16_t entry, int parent) {
+    if (nodeCount == nodeCapacity) {
+        nodeCapacity = nodeCapacity ? nodeCapacity * 2 : 256;
+        nodes = (CallNode *)realloc(nodes, nodeCapacity * sizeof(CallNode));
+        if (!nodes) { perror("realloc"); exit(1); }
+    }
+    CallNode *n = &nodes[nodeCount];
+    n->entry = entry;
+    n->parent = parent;
+    n->firstChild = -1;
+    n->nextSibling = -1;
+    n->self = 0;
+    if (parent >= 0) {
+        n->nextSibling = nodes[parent].firstChild;
+        nodes[parent].firstChild = nodeCount;
+    }
+    return nodeCount++;
+}
+
+// Find (or create) the callee of `parent` entered at `entry`. The match is
+// moved to the front of the child list so hot call sites stay one probe away.
+static int childNode(int parent, uint16_t entry) {
+    int prev = -1;
+    for (int c = nodes[parent].firstChild; c >= 0; prev = c, c = nodes[c].nextSibling) {
+        if (nodes[c].entry == entry) {
+            if (prev >= 0) {
+                nodes[prev].nextSibling = nodes[c].nextSibling;
+                nodes[c].nextSibling = nodes[parent].firstChild;
+                nodes[parent].firstChild = c;
+            }
+            return c;
+        }
+    }
+    return newNode(entry, parent);
+}
+
+static int isKnownEntry(uint16_t addr) {
+    return knownEntry[addr >> 3] & (1 << (addr & 7));
+}
+
+static void profileCall(uint16_t target, uint16_t link) {
+    callCount++;
+    knownEntry[target >> 3] |= (unsigned char)(1 << (target & 7));
+    if (depth + 1 >= MAX_CALL_DEPTH) {
+        // Runaway recursion: fold the new frame into the top one.
+        depthOverflows++;
+        stack[depth].node = childNode(nodes[stack[depth].node].parent, target);
+        stack[depth].link = link;
+        return;
+    }
+    depth++;
+    stack[depth].node = childNode(stack[depth - 1].node, target);
+    stack[depth].link = link;
+}
+
+static void profileJump(uint16_t target) {
+    if (depth == 0 || !isKnownEntry(target))
+        return;
+    int top = stack[depth].node;
+    if (nodes[top].entry == target)
+        return;
+    tailCalls++;
+    stack[depth].node = childNode(nodes[top].parent, target);
+}
+
+static void profileReturn(uint16_t link, uint16_t target) {
+    for (int i = depth; i > 0; i--) {
+        if (stack[i].link == link) {
+            returnCount++;
+            depth = i - 1;
+            return;
+        }
+    }
+    unmatchedReturns++;
+    profileJump(target);
+}
+
+void profileInit(uint16_t entryPc) {
+    nodeCount = 0;
+    depth = 0;
+    memset(knownEntry, 0, sizeof(knownEntry));
+    stack[0].node = newNode(entryPc, -1);
+    stack[0].link = 0;
+}
+
+void profileInstruction(uint16_t inst) {
+    nodes[stack[depth].node].self++;
+
+    uint8_t opcode = inst & 0x7;
+    if (opcode == 0x0 && ((inst >> 3) & 0x7) == 0x0) { // R-type JR/JALR
+        uint8_t funct4 = (inst >> 12) & 0xF;
+        uint8_t rs1 = (inst >> 6) & 0x7;
+        uint8_t rs2 = (inst >> 9) & 0x7;
+        if (funct4 == 0x8) {        // JALR: link in rs2
+            if (rs2 == REG_RA)
+                profileCall(pc, regs[REG_RA]);
+            else
+                profileJump(pc);
+        } else if (funct4 == 0x4) { // JR
+            if (rs1 == REG_RA)
+                profileReturn(regs[REG_RA], pc);
+            else
+                profileJump(pc);
+        }
+    } else if (opcode == 0x5) {     // J/JAL
+        uint8_t rd = (inst >> 6) & 0x7;
+        if ((inst >> 15) & 0x1 && rd == REG_RA)
+            profileCall(pc, regs[REG_RA]);
+        else
+            profileJump(pc);
+    }
+}
+
+void profileCharge(uint64_t extra) {
+    nodes[stack[depth].node].self += extra;
+}
+
+// Append "main;f;0xBBBB;..." for the path ending at node n: label names
+// when debug info is loaded, entry addresses otherwise.
+static void writePath(FILE *fp, int n) {
+    char name[96];
+    if (nodes[n].parent >= 0) {
+        writePath(fp, nodes[n].parent);
+        fputc(';', fp);
+    }
+    fputs(debugName(nodes[n].entry, name, sizeof(name)), fp);
+}
+
+static int writeFolded(const char *filename, const uint64_t *counts) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Error opening call-graph file");
+        return -1;
+    }
+    for (int n = 0; n < nodeCount; n++) {
+        if (counts[n] == 0)
+            continue;
+        writePath(fp, n);
+        fprintf(fp, " %llu\n", (unsigned long long)counts[n]);
+    }
+    fclose(fp);
+    return 0;
+}
+
+void profileWrite(const char *filename) {
+    // Children are always created after their parent, so a single reverse
+    // sweep accumulates inclusive counts bottom-up.
+    uint64_t *self = (uint64_t *)malloc(nodeCount * sizeof(uint64_t));
+    uint64_t *inclusive = (uint64_t *)malloc(nodeCount * sizeof(uint64_t));
+    if (!self || !inclusive) { perror("malloc"); exit(1); }
+    for (int n = 0; n < nodeCount; n++)
+        self[n] = inclusive[n] = nodes[n].self;
+    for (int n = nodeCount - 1; n > 0; n--)
+        inclusive[nodes[n].parent] += inclusive[n];
+
+    char inclusiveName[512];
+    snprintf(inclusiveName, sizeof(inclusiveName), "%s.inclusive", filename);
+    if (writeFolded(filename, self) == 0 && writeFolded(inclusiveName, inclusive) == 0) {
+        fprintf(stderr, "Call-graph profile: %llu instructions, %d call paths, "
+                "%llu calls, %llu returns, %llu unmatched returns, %llu tail calls",
+                (unsigned long long)inclusive[0], nodeCount,
+                (unsigned long long)callCount, (unsigned long long)returnCount,
+                (unsigned long long)unmatchedReturns, (unsigned long long)tailCalls);
+        if (depthOverflows)
+            fprintf(stderr, ", %llu calls beyond depth %d folded", (unsigned long long)depthOverflows, MAX_CALL_DEPTH);
+        fprintf(stderr, "\nCall-graph files generated: %s, %s\n", filename, inclusiveName);
+    }
+
+    free(self);
+    free(inclusive);
+    free(nodes);
+    nodes = NULL;
+    nodeCount = nodeCapacity = 0;
+}
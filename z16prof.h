@@ -0,0 +1,27 @@
+/*
+ * Call-graph profiler for the Z16 simulator.
+ *
+ * Reconstructs the guest call stack from the executed instruction stream
+ * (JAL/JALR linking into ra are calls, JR through ra is a return) and writes
+ * per-call-path instruction counts in the folded-stack format read by
+ * flame-graph tools.
+ */
+#ifndef Z16PROF_H
+#define Z16PROF_H
+
+#include <stdint.h>
+
+// Start profiling with the root frame at the given entry address.
+void profileInit(uint16_t entryPc);
+
+// Account one retired instruction; call after executeInstruction(inst).
+void profileInstruction(uint16_t inst);
+
+// The last instruction counts as `extra` more (bulk memory and accelerator
+// ecalls).
+void profileCharge(uint64_t extra);
+
+// Write <file> (exclusive counts) and <file>.inclusive, then free the tree.
+void profileWrite(const char *filename);
+
+#endif // Z16PROF_H
@@ -0,0 +1,37 @@
+/*
+ * Wrapped guest address ranges (see z16range.h).
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "z16range.h"
+
+unsigned char rangeStaging[MEM_SIZE];
+
+void rangeObserve(RangeObserve observe, uint16_t addr, uint32_t n, int isWrite) {
+    while (n > 0) {
+        uint32_t c = rangePiece(addr, n);
+        observe(addr, (int)c, isWrite);
+        addr = (uint16_t)(addr + c);
+        n -= c;
+    }
+}
+
+void rangeRead(const unsigned char *mem, uint16_t addr, unsigned char *buf, uint32_t n) {
+    uint32_t first = rangePiece(addr, n);
+    memcpy(buf, &mem[addr], first);
+    memcpy(buf + first, mem, n - first);
+}
+
+void rangeWrite(unsigned char *mem, uint16_t addr, const unsigned char *buf, uint32_t n) {
+    uint32_t first = rangePiece(addr, n);
+    memcpy(&mem[addr], buf, first);
+    memcpy(mem, buf + first, n - first);
+}
+
+const unsigned char *rangeGather(const unsigned char *mem, uint16_t addr, uint32_t n) {
+    if ((uint32_t)addr + n <= MEM_SIZE)
+        return &mem[addr];
+    rangeRead(mem, addr, rangeStaging, n);
+    return rangeStaging;
+}
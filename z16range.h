@@ -0,0 +1,41 @@
+/*
+ * Guest address ranges that wrap past 0xFFFF, shared by the ecalls that
+ * work on whole buffers (z16bulk.c, z16accel.c).
+ *
+ * A range [addr, addr+n) with addr + n > MEM_SIZE continues at address 0,
+ * like every other guest address. The helpers split it into at most two
+ * pieces, or copy it through one staging buffer when a routine needs the
+ * bytes in one run.
+ */
+#ifndef Z16RANGE_H
+#define Z16RANGE_H
+
+#include <stdint.h>
+
+#include "z16sim.h"
+
+// Told about `size` bytes at addr before they are read or written
+typedef void (*RangeObserve)(uint16_t addr, int size, int isWrite);
+
+// Room for any guest range; contents are only valid until the next call
+// that uses it.
+extern unsigned char rangeStaging[MEM_SIZE];
+
+// Bytes of an n-byte range at addr before it wraps
+static inline uint32_t rangePiece(uint16_t addr, uint32_t n) {
+    uint32_t room = MEM_SIZE - addr;
+    return n < room ? n : room;
+}
+
+// Report the range to `observe` one piece at a time.
+void rangeObserve(RangeObserve observe, uint16_t addr, uint32_t n, int isWrite);
+
+// Copy the n bytes at addr in `mem` to buf / from buf.
+void rangeRead(const unsigned char *mem, uint16_t addr, unsigned char *buf, uint32_t n);
+void rangeWrite(unsigned char *mem, uint16_t addr, const unsigned char *buf, uint32_t n);
+
+// The n bytes at addr as one run: in place, or gathered into rangeStaging
+// if the range wraps.
+const unsigned char *rangeGather(const unsigned char *mem, uint16_t addr, uint32_t n);
+
+#endif // Z16RANGE_H
@@ -0,0 +1,522 @@
+; z16rt.s - Z16 runtime library: memory, string, arithmetic and number
+; formatting routines for guest programs.
+;
+; .include "z16rt.s" inside .text; see z16rt.inc for the calling convention.
+; Every routine is a leaf that only touches a0, a1, t0 and t1, and is called
+; with "call <name>". Instruction and cycle counts are in the README.
+;
+; Routines
+;   rt_memcpy   copy t1 bytes from a1 to a0 (no overlap); a0 = a0 + t1
+;   rt_memset   fill t1 bytes at a0 with the low byte of a1; a0 = a0 + t1
+;   rt_strlen   a0 = length of the string at a0
+;   rt_strcmp   a0 = first difference (byte of a0 - byte of a1) or 0
+;   rt_mul      a0 = a0 * a1 (low 16 bits)
+;   rt_divu     a0 = a0 / a1, a1 = a0 % a1, unsigned; by zero 0xFFFF and a0
+;   rt_divu10   a0 = a0 / 10, a1 = a0 % 10, unsigned
+;   rt_utoa     write a0 in decimal at a1, NUL-terminated (up to 6 bytes);
+;               a0 = address of the NUL
+;   rt_itoa     same for a signed a0 (up to 7 bytes)
+
+; -----------------------
+; Memory
+; -----------------------
+
+; Sixteen bytes per iteration through word loads and stores while at least
+; 18 bytes remain (a word store also writes the two bytes after it), then
+; words while 4 remain, then bytes.
+rt_memcpy:
+    add  t1, a0                 ; t1 = end of the destination
+    li   t0, 18
+    add  t0, a0
+    bgeu t1, t0, rt_memcpy_big
+    j    rt_memcpy_small
+rt_memcpy_big:
+    li   t0, 17
+    sub  t1, t0                 ; loop while a0 < end - 17
+rt_memcpy_16:
+    lw   t0, 0(a1)
+    sw   t0, 0(a0)
+    lw   t0, 2(a1)
+    sw   t0, 2(a0)
+    lw   t0, 4(a1)
+    sw   t0, 4(a0)
+    lw   t0, 6(a1)
+    sw   t0, 6(a0)
+    addi a1, 8
+    addi a0, 8
+    lw   t0, 0(a1)
+    sw   t0, 0(a0)
+    lw   t0, 2(a1)
+    sw   t0, 2(a0)
+    lw   t0, 4(a1)
+    sw   t0, 4(a0)
+    lw   t0, 6(a1)
+    sw   t0, 6(a0)
+    addi a1, 8
+    addi a0, 8
+    bgeu a0, t1, rt_memcpy_rest
+    j    rt_memcpy_16
+rt_memcpy_rest:
+    li   t0, 14
+    add  t1, t0                 ; end - 3
+    j    rt_memcpy_words
+rt_memcpy_small:
+    li   t0, 3
+    sub  t1, t0                 ; end - 3
+rt_memcpy_words:
+    bgeu a0, t1, rt_memcpy_tail
+    lw   t0, 0(a1)
+    sw   t0, 0(a0)
+    addi a1, 2
+    addi a0, 2
+    j    rt_memcpy_words
+rt_memcpy_tail:
+    li   t0, 3
+    add  t1, t0                 ; end
+    beq  a0, t1, rt_memcpy_done
+rt_memcpy_byte:
+    lbu  t0, 0(a1)
+    sb   t0, 0(a0)
+    addi a1, 1
+    addi a0, 1
+    bne  a0, t1, rt_memcpy_byte
+rt_memcpy_done:
+    jr   ra
+
+; Same shape as rt_memcpy, storing the byte doubled into a word.
+rt_memset:
+    slli a1, 8
+    li   t0, 0
+    add  t0, a1
+    srli t0, 8
+    or   a1, t0                 ; the byte in both halves
+    add  t1, a0                 ; t1 = end
+    li   t0, 18
+    add  t0, a0
+    bgeu t1, t0, rt_memset_big
+    j    rt_memset_small
+rt_memset_big:
+    li   t0, 17
+    sub  t1, t0
+rt_memset_16:
+    sw   a1, 0(a0)
+    sw   a1, 2(a0)
+    sw   a1, 4(a0)
+    sw   a1, 6(a0)
+    addi a0, 8
+    sw   a1, 0(a0)
+    sw   a1, 2(a0)
+    sw   a1, 4(a0)
+    sw   a1, 6(a0)
+    addi a0, 8
+    bgeu a0, t1, rt_memset_rest
+    j    rt_memset_16
+rt_memset_rest:
+    li   t0, 14
+    add  t1, t0                 ; end - 3
+    j    rt_memset_words
+rt_memset_small:
+    li   t0, 3
+    sub  t1, t0                 ; end - 3
+rt_memset_words:
+    bgeu a0, t1, rt_memset_tail
+    sw   a1, 0(a0)
+    addi a0, 2
+    j    rt_memset_words
+rt_memset_tail:
+    li   t0, 3
+    add  t1, t0                 ; end
+    beq  a0, t1, rt_memset_done
+rt_memset_byte:
+    sb   a1, 0(a0)
+    addi a0, 1
+    bne  a0, t1, rt_memset_byte
+rt_memset_done:
+    jr   ra
+
+; -----------------------
+; Strings
+; -----------------------
+
+; Three bytes per iteration. The exits sit before the loop so the branches
+; reach them; t1 = start + 1 lets the fall-through exit subtract directly.
+rt_strlen:
+    li   t1, 1
+    add  t1, a0
+    j    rt_strlen_loop
+rt_strlen_at1:
+    addi a0, 1
+rt_strlen_at0:
+    addi a0, 1
+rt_strlen_end:
+    sub  a0, t1
+    jr   ra
+rt_strlen_loop:
+    lbu  t0, 0(a0)
+    bz   t0, rt_strlen_at0
+    lbu  t0, 1(a0)
+    bz   t0, rt_strlen_at1
+    lbu  t0, 2(a0)
+    addi a0, 3
+    bnz  t0, rt_strlen_loop
+    j    rt_strlen_end
+
+rt_strcmp:
+    lbu  t0, 0(a0)
+    lbu  t1, 0(a1)
+    bne  t0, t1, rt_strcmp_diff
+    addi a0, 1
+    addi a1, 1
+    bnz  t0, rt_strcmp
+    li   a0, 0
+    jr   ra
+rt_strcmp_diff:
+    sub  t0, t1
+    li   a0, 0
+    add  a0, t0
+    jr   ra
+
+; -----------------------
+; Arithmetic
+; -----------------------
+
+; Shift and add over the bits of the smaller operand.
+rt_mul:
+    bgeu a0, a1, rt_mul_go
+    xor  a0, a1
+    xor  a1, a0
+    xor  a0, a1
+rt_mul_go:
+    li   t1, 0
+rt_mul_bit:
+    li   t0, 1
+    and  t0, a1
+    bz   t0, rt_mul_skip
+    add  t1, a0
+rt_mul_skip:
+    add  a0, a0
+    srli a1, 1
+    bnz  a1, rt_mul_bit
+    li   a0, 0
+    add  a0, t1
+    jr   ra
+
+; Restoring division, unrolled: each step shifts the top bit of a0 into the
+; remainder t1 and the quotient bit into the bottom of a0. A dividend below
+; 256 skips the first eight steps. A divisor of 0x8000 or more would
+; overflow the remainder, but then the quotient is 0 or 1.
+rt_divu:
+    li   t0, 0
+    add  t0, a1
+    srli t0, 15
+    bz   t0, rt_divu_small
+    j    rt_divu_big
+rt_divu_small:
+    li   t1, 0
+    bz   a1, rt_divu_s15        ; by zero: all 16 steps give 0xFFFF
+    li   t0, 1
+    slli t0, 8
+    bgeu a0, t0, rt_divu_s15
+    slli a0, 8
+    j    rt_divu_s7
+rt_divu_s15:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s14
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s14:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s13
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s13:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s12
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s12:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s11
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s11:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s10
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s10:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s9
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s9:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s8
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s8:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s7
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s7:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s6
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s6:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s5
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s5:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s4
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s4:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s3
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s3:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s2
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s2:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s1
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s1:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_s0
+    sub  t1, a1
+    addi a0, 1
+rt_divu_s0:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    add  t1, t1
+    or   t1, t0
+    add  a0, a0
+    bltu t1, a1, rt_divu_done
+    sub  t1, a1
+    addi a0, 1
+rt_divu_done:
+    li   a1, 0
+    add  a1, t1
+    jr   ra
+rt_divu_big:
+    li   t1, 0
+    add  t1, a0
+    li   a0, 0
+    bltu t1, a1, rt_divu_done
+    sub  t1, a1
+    li   a0, 1
+    j    rt_divu_done
+
+; Division by the constant 10 without a divide: q = n * 0.8 / 8 from a
+; shift-and-add series, low by at most one, then corrected from the
+; remainder (exact for every 16-bit n).
+rt_divu10:
+    li   a1, 0
+    add  a1, a0                 ; a1 = n
+    li   t0, 0
+    add  t0, a0
+    srli t0, 1
+    srli a0, 2
+    add  a0, t0                 ; q = n/2 + n/4
+    li   t0, 0
+    add  t0, a0
+    srli t0, 4
+    add  a0, t0                 ; q += q >> 4
+    li   t0, 0
+    add  t0, a0
+    srli t0, 8
+    add  a0, t0                 ; q += q >> 8
+    srli a0, 3
+    li   t0, 0
+    add  t0, a0
+    slli t0, 2
+    add  t0, a0
+    slli t0, 1                  ; 10q
+    sub  a1, t0                 ; r = n - 10q, 0..13
+    li   t0, 10
+    bltu a1, t0, rt_divu10_done
+    sub  a1, t0
+    addi a0, 1
+rt_divu10_done:
+    jr   ra
+
+; -----------------------
+; Formatting
+; -----------------------
+
+; rt_itoa writes the sign and continues as rt_utoa on the magnitude.
+rt_itoa:
+    li   t0, 0
+    add  t0, a0
+    srli t0, 15
+    bz   t0, rt_utoa
+    li   t0, 45                 ; '-'
+    sb   t0, 0(a1)
+    addi a1, 1
+    li   t0, 0
+    sub  t0, a0
+    li   a0, 0
+    add  a0, t0
+
+; Digits from the most significant, each by repeated subtraction of its
+; power of ten (at most nine times). The first part finds the leading
+; digit's power so no division or reversal is needed.
+rt_utoa:
+    li   t0, 10
+    bgeu a0, t0, rt_utoa_c2
+    j    rt_utoa_d0
+rt_utoa_c2:
+    li   t0, 100
+    bgeu a0, t0, rt_utoa_c3
+    li   t0, 10
+    j    rt_utoa_d1
+rt_utoa_c3:
+    li   t0, 125
+    slli t0, 3                  ; 1000
+    bgeu a0, t0, rt_utoa_c4
+    li   t0, 100
+    j    rt_utoa_d2
+rt_utoa_c4:
+    li   t0, 78
+    slli t0, 7
+    addi t0, 16                 ; 10000
+    bgeu a0, t0, rt_utoa_d4
+    li   t0, 125
+    slli t0, 3
+    j    rt_utoa_d3
+rt_utoa_d4:
+    li   t1, 48                 ; '0'; this digit is at least 1
+rt_utoa_s4:
+    addi t1, 1
+    sub  a0, t0
+    bgeu a0, t0, rt_utoa_s4
+    sb   t1, 0(a1)
+    addi a1, 1
+    li   t0, 125
+    slli t0, 3
+rt_utoa_d3:
+    li   t1, 48                 ; '0'
+    bltu a0, t0, rt_utoa_w3
+rt_utoa_s3:
+    addi t1, 1
+    sub  a0, t0
+    bgeu a0, t0, rt_utoa_s3
+rt_utoa_w3:
+    sb   t1, 0(a1)
+    addi a1, 1
+    li   t0, 100
+rt_utoa_d2:
+    li   t1, 48
+    bltu a0, t0, rt_utoa_w2
+rt_utoa_s2:
+    addi t1, 1
+    sub  a0, t0
+    bgeu a0, t0, rt_utoa_s2
+rt_utoa_w2:
+    sb   t1, 0(a1)
+    addi a1, 1
+    li   t0, 10
+rt_utoa_d1:
+    li   t1, 48
+    bltu a0, t0, rt_utoa_w1
+rt_utoa_s1:
+    addi t1, 1
+    sub  a0, t0
+    bgeu a0, t0, rt_utoa_s1
+rt_utoa_w1:
+    sb   t1, 0(a1)
+    addi a1, 1
+rt_utoa_d0:
+    addi a0, 48
+    sb   a0, 0(a1)
+    addi a1, 1
+    li   t0, 0
+    sb   t0, 0(a1)
+    li   a0, 0
+    add  a0, a1
+    jr   ra
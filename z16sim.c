@@ -3,78 +3,75 @@
 #include <stdint.h>
 #include <string.h>
 
-#define MEM_SIZE 65536 // 64KB memory
+#include "z16sim.h"
+#include "z16prof.h"
+#include "z16memprof.h"
+#include "z16cache.h"
+#include "z16timing.h"
+#include "z16tracewriter.h"
+#include "z16metrics.h"
+#include "z16ilp.h"
+#include "z16debuginfo.h"
+#include "z16cosim.h"
+#include "z16gdb.h"
+#include "z16console.h"
+#include "z16dma.h"
+#include "z16stream.h"
+#include "z16bulk.h"
+#include "z16accel.h"
+#include "z16bus.h"
+#include "z16mmu.h"
+#include "z16image.h"
+#include "z16simd.h"
+#include "z16heap.h"
+#include "z16idiom.h"
 
 // Simulated memory and register file
-unsigned char memory[MEM_SIZE];
+unsigned char memory[MEM_SIZE + MEM_GUARD];
 uint16_t regs[8]; // 8 registers: x0 - x7
 uint16_t pc = 0; // Program counter
-
-// Register names
-const char *regNames[8] = {"t0", "ra", "sp", "s0", "s1", "t1", "a0", "a1"};
-
-// Function to disassemble instructions
-void disassemble(uint16_t inst, uint16_t pc, char *buf, size_t bufSize) {
-    uint8_t opcode = inst & 0x7;
-
-    switch (opcode) {
-        case 0x0: { // R-Type
-            uint8_t funct4 = (inst >> 12) & 0xF;
-            uint8_t rs2 = (inst >> 9) & 0x7;
-            uint8_t rs1 = (inst >> 6) & 0x7;
-            uint8_t funct3 = (inst >> 3) & 0x7;
-            snprintf(buf, bufSize, "R-Type (%X) %s, %s", funct4, regNames[rs1], regNames[rs2]);
-            break;
-        }
-        case 0x1: { // I-Type
-            uint16_t imm = (inst >> 9) & 0x7F; // 7-bit immediate
-            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 6-8)
-            uint8_t funct3 = (inst >> 3) & 0x7; // funct3 (bits 3-5)
-            snprintf(buf, bufSize, "I-Type imm: %d, rs1: %s", imm, regNames[rs1]);
-            break;
-        }
-        case 0x2: { // B-Type (Branch)
-            int16_t imm = ((inst >> 12) & 0xF) | ((inst >> 1) & 0xE);
-            if (imm & 0x10) imm |= 0xFFE0;  // Sign-extend if necessary
-            uint8_t rs2 = (inst >> 9) & 0x7;
-            uint8_t rs1 = (inst >> 6) & 0x7;
-            snprintf(buf, bufSize, "B-Type offset: %d, %s, %s", imm, regNames[rs1], regNames[rs2]);
-            break;
-        }
-        case 0x3: { // S-Type (Store)
-            uint8_t imm = (inst >> 12) & 0xF;  // Immediate (bits 12-15)
-            uint8_t rs2 = (inst >> 9) & 0x7;   // rs2 (bits 9-11)
-            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 6-8)
-            snprintf(buf, bufSize, "S-Type Store %s -> [%s + %d]", regNames[rs2], regNames[rs1], imm);
-            break;
-        }
-        case 0x4: { // L-Type (Load)
-            uint8_t imm = (inst >> 12) & 0xF;  // Immediate (bits 12-15)
-            uint8_t rd = (inst >> 9) & 0x7;    // rd (bits 6-8)
-            uint8_t rs1 = (inst >> 6) & 0x7;   // rs1 (bits 3-5)
-            snprintf(buf, bufSize, "L-Type Load %s <- [%s + %d]", regNames[rd], regNames[rs1], imm);
-            break;
-        }
-        case 0x5: { // J-Type (Jump)
-            uint16_t imm = ((inst >> 4) & 0x3F) | ((inst >> 1) & 0xE);
-            uint8_t rd = (inst >> 9) & 0x7;    // rd (bits 6-8)
-            snprintf(buf, bufSize, "J-Type Jump to %d", imm);
-            break;
-        }
-        case 0x6: { // U-Type (Upper Immediate)
-            uint8_t imm = (inst >> 10) & 0x7;   // I[9:7] (bits 9-7)
-            uint8_t rd = (inst >> 9) & 0x7;     // rd (bits 6-8)
-            snprintf(buf, bufSize, "U-Type LUI/AUIPC %s = %d", regNames[rd], imm);
-            break;
-        }
-        case 0x7: { // System Instructions (e.g., ECALL)
-            snprintf(buf, bufSize, "ecall");
-            break;
-        }
-
-        default:
-            snprintf(buf, bufSize, "Unknown Instruction");
-    }
+uint64_t instructionCount = 0; // Instructions retired
+
+// Per-instruction text trace; -q turns it off for long runs
+int traceEnabled = 1;
+#define TRACE(...) do { if (traceEnabled) printf(__VA_ARGS__); } while (0)
+
+// Data-access instrumentation: the L/S handlers call observeAccess() only
+// while memHooks is set, so an uninstrumented run pays a single test.
+static int memHooks = 0;
+static int heatmapEnabled = 0;
+static int cacheEnabled = 0;
+static int binTraceEnabled = 0;
+static int ilpEnabled = 0;
+static int cosimEnabled = 0;
+static int gdbEnabled = 0;
+static int gdbWatchEnabled = 0;
+static int dmaEnabled = 0;
+static int heapEnabled = 0;
+
+// Copy and fill loops run on the host (--idioms) unless something watches
+// individual instructions or accesses.
+static int idiomsEnabled = 0;
+
+// Instructions the last bulk memory or accelerator ecall counts as beyond
+// itself
+static uint64_t ecallCharge = 0;
+
+static void observeAccess(uint16_t addr, int size, int isWrite) {
+    if (heatmapEnabled)
+        memprofAccess(pc, addr, size, isWrite);
+    if (cacheEnabled)
+        cacheData(pc, addr, size, isWrite);
+    if (binTraceEnabled && isWrite)
+        traceMemWrite(addr, size);
+    if (ilpEnabled)
+        ilpAccess(addr, size, isWrite);
+    if (cosimEnabled)
+        cosimAccess(addr, size, isWrite);
+    if (gdbWatchEnabled)
+        gdbAccess(addr, size, isWrite);
+    if (dmaEnabled)
+        dmaAccess(addr, size, isWrite);
 }
 
 int executeInstruction(uint16_t inst) {
@@ -111,6 +108,26 @@ case 0x0: { // R-Type (opcode 000)
                 default: op = "Unknown"; break;
             }
             break;
+        case SIMD_FUNCT3: {
+            static char *simdOps[16] = {
+                "Unknown", "PADDB", "PSUBB", "PADDSB", "PSUBSB", "PADDUSB", "PSUBUSB", "PMINSB",
+                "PMAXSB", "PMINUB", "PMAXUB", "PCMPEQB", "PCMPLTB", "PSWAPB", "PPACKLB", "PPACKHB",
+            };
+            op = simdOps[funct4];
+            break;
+        }
+        case MULDIV_FUNCT3:
+            switch (funct4) {
+                case MULDIV_MUL: op = "MUL"; break;
+                case MULDIV_MULH: op = "MULH"; break;
+                case MULDIV_MULHU: op = "MULHU"; break;
+                case MULDIV_DIV: op = "DIV"; break;
+                case MULDIV_DIVU: op = "DIVU"; break;
+                case MULDIV_REM: op = "REM"; break;
+                case MULDIV_REMU: op = "REMU"; break;
+                default: op = "Unknown"; break;
+            }
+            break;
         case 0x3:
             switch (funct4) {
                 case 0x2: op = "SLL"; break;
@@ -127,7 +144,7 @@ case 0x0: { // R-Type (opcode 000)
     }
 
     // Print the R-Type instruction with the operation
-    printf("R-Type: %s %s %s\n", regNames[rs1], op, regNames[rs2]);
+    TRACE("R-Type: %s %s %s\n", regNames[rs1], op, regNames[rs2]);
 
     // Handle different R-Type operations based on funct3 and funct4
     switch (funct3) {
@@ -158,6 +175,38 @@ case 0x0: { // R-Type (opcode 000)
             }
             break;
 
+        case SIMD_FUNCT3: { // packed bytes (--simd)
+            if (!decodePackedSimd || funct4 == 0) {
+                printf("⚠️ Unknown R-Type instruction: funct3=%X funct4=%X%s\n", funct3, funct4,
+                       decodePackedSimd ? "" : " (packed-byte operations need --simd)");
+                return 0;
+            }
+            regs[rs1] = simdExecute(funct4, regs[rs1], regs[rs2]);
+            break;
+        }
+
+        case MULDIV_FUNCT3: { // M extension (--mext)
+            if (!decodeMulDiv || funct4 < MULDIV_MUL || funct4 > MULDIV_REMU) {
+                printf("⚠️ Unknown R-Type instruction: funct3=%X funct4=%X%s\n", funct3, funct4,
+                       decodeMulDiv ? "" : " (mul/div need --mext)");
+                return 0;
+            }
+            int16_t a = (int16_t)regs[rs1], b = (int16_t)regs[rs2];
+            uint16_t ua = regs[rs1], ub = regs[rs2];
+            switch (funct4) {
+                case MULDIV_MUL: regs[rs1] = (uint16_t)((uint32_t)ua * ub); break;
+                case MULDIV_MULH: regs[rs1] = (uint16_t)(((int32_t)a * b) >> 16); break;
+                case MULDIV_MULHU: regs[rs1] = (uint16_t)(((uint32_t)ua * ub) >> 16); break;
+                case MULDIV_DIV: // -32768 / -1 wraps back to -32768
+                    regs[rs1] = b == 0 ? 0xFFFF : (uint16_t)((int32_t)a / b);
+                    break;
+                case MULDIV_DIVU: regs[rs1] = ub == 0 ? 0xFFFF : ua / ub; break;
+                case MULDIV_REM: regs[rs1] = b == 0 ? ua : (uint16_t)((int32_t)a % b); break;
+                case MULDIV_REMU: regs[rs1] = ub == 0 ? ua : ua % ub; break;
+            }
+            break;
+        }
+
         case 0x3: {
             switch (funct4) {
                 case 0x2: { // SLL (Shift left logical)
@@ -215,19 +264,19 @@ case 0x1: { // I-Type (opcode 001)
     switch (funct3) {
         case 0x0: { // ADDI
             regs[rs1] += imm7;
-            printf("ADDI: %s += %d → %d\n", regNames[rs1], imm7, regs[rs1]);
+            TRACE("ADDI: %s += %d → %d\n", regNames[rs1], imm7, regs[rs1]);
             break;
         }
 
         case 0x1: { // SLTI
             regs[rs1] = (regs[rs1] < imm7) ? 1 : 0;
-            printf("SLTI: %s = %d (if %s < %d)\n", regNames[rs1], regs[rs1], regNames[rs1], imm7);
+            TRACE("SLTI: %s = %d (if %s < %d)\n", regNames[rs1], regs[rs1], regNames[rs1], imm7);
             break;
         }
 
         case 0x2: { // SLTUI
             regs[rs1] = ((unsigned)regs[rs1] < (unsigned)imm7) ? 1 : 0;
-            printf("SLTUI: %s = %d (if %s < %d unsigned)\n", regNames[rs1], regs[rs1], regNames[rs1], imm7);
+            TRACE("SLTUI: %s = %d (if %s < %d unsigned)\n", regNames[rs1], regs[rs1], regNames[rs1], imm7);
             break;
         }
 
@@ -238,15 +287,15 @@ case 0x1: { // I-Type (opcode 001)
             switch (shiftType) {
                 case 0x1: // SLLI
                     regs[rs1] <<= shamt;
-                    printf("SLLI: %s <<= %d → %d\n", regNames[rs1], shamt, regs[rs1]);
+                    TRACE("SLLI: %s <<= %d → %d\n", regNames[rs1], shamt, regs[rs1]);
                     break;
                 case 0x2: // SRLI
                     regs[rs1] >>= shamt;
-                    printf("SRLI: %s >>= %d → %d\n", regNames[rs1], shamt, regs[rs1]);
+                    TRACE("SRLI: %s >>= %d → %d\n", regNames[rs1], shamt, regs[rs1]);
                     break;
                 case 0x3: // SRAI
                     regs[rs1] = (int32_t)regs[rs1] >> shamt;
-                    printf("SRAI: (int32_t)%s >> %d → %d\n", regNames[rs1], shamt, regs[rs1]);
+                    TRACE("SRAI: (int32_t)%s >> %d → %d\n", regNames[rs1], shamt, regs[rs1]);
                     break;
                 default:
                     printf("⚠️ Unknown shift type (shiftType=%d) in funct3=0x3\n", shiftType);
@@ -257,25 +306,25 @@ case 0x1: { // I-Type (opcode 001)
 
         case 0x4: { // ORI
             regs[rs1] |= imm7;
-            printf("ORI: %s |= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
+            TRACE("ORI: %s |= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
             break;
         }
 
         case 0x5: { // ANDI
             regs[rs1] &= imm7;
-            printf("ANDI: %s &= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
+            TRACE("ANDI: %s &= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
             break;
         }
 
         case 0x6: { // XORI
             regs[rs1] ^= imm7;
-            printf("XORI: %s ^= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
+            TRACE("XORI: %s ^= %d → %d\n", regNames[rs1], imm7, regs[rs1]);
             break;
         }
 
         case 0x7: { // LI (custom: load immediate, funct3 = 111)
             regs[rs1] = imm7;
-            printf("LI: %s = %d\n", regNames[rs1], regs[rs1]);
+            TRACE("LI: %s = %d\n", regNames[rs1], regs[rs1]);
             break;
         }
 
@@ -299,9 +348,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x0: { // BEQ
             if (regs[rs1] == regs[rs2]) {
                 pc += offset;
-                printf("BEQ: %s == %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BEQ: %s == %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BEQ: %s != %s → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BEQ: %s != %s → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -309,9 +358,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x1: { // BNE
             if (regs[rs1] != regs[rs2]) {
                 pc += offset;
-                printf("BNE: %s != %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BNE: %s != %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BNE: %s == %s → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BNE: %s == %s → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -319,9 +368,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x2: { // BZ (branch if zero)
             if (regs[rs1] == 0) {
                 pc += offset;
-                printf("BZ: %s == 0 → PC += %d → %d\n", regNames[rs1], offset, pc);
+                TRACE("BZ: %s == 0 → PC += %d → %d\n", regNames[rs1], offset, pc);
             } else {
-                printf("BZ: %s != 0 → no branch\n", regNames[rs1]);
+                TRACE("BZ: %s != 0 → no branch\n", regNames[rs1]);
             }
             break;
         }
@@ -329,9 +378,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x3: { // BNZ (branch if not zero)
             if (regs[rs1] != 0) {
                 pc += offset;
-                printf("BNZ: %s != 0 → PC += %d → %d\n", regNames[rs1], offset, pc);
+                TRACE("BNZ: %s != 0 → PC += %d → %d\n", regNames[rs1], offset, pc);
             } else {
-                printf("BNZ: %s == 0 → no branch\n", regNames[rs1]);
+                TRACE("BNZ: %s == 0 → no branch\n", regNames[rs1]);
             }
             break;
         }
@@ -339,9 +388,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x4: { // BLT (signed)
             if ((int32_t)regs[rs1] < (int32_t)regs[rs2]) {
                 pc += offset;
-                printf("BLT: %s < %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BLT: %s < %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BLT: %s >= %s → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BLT: %s >= %s → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -349,9 +398,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x5: { // BGE (signed)
             if ((int32_t)regs[rs1] >= (int32_t)regs[rs2]) {
                 pc += offset;
-                printf("BGE: %s >= %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BGE: %s >= %s → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BGE: %s < %s → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BGE: %s < %s → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -359,9 +408,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x6: { // BLTU (unsigned)
             if ((uint32_t)regs[rs1] < (uint32_t)regs[rs2]) {
                 pc += offset;
-                printf("BLTU: %s < %s (unsigned) → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BLTU: %s < %s (unsigned) → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BLTU: %s >= %s (unsigned) → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BLTU: %s >= %s (unsigned) → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -369,9 +418,9 @@ case 0x1: { // I-Type (opcode 001)
         case 0x7: { // BGEU (unsigned)
             if ((uint32_t)regs[rs1] >= (uint32_t)regs[rs2]) {
                 pc += offset;
-                printf("BGEU: %s >= %s (unsigned) → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
+                TRACE("BGEU: %s >= %s (unsigned) → PC += %d → %d\n", regNames[rs1], regNames[rs2], offset, pc);
             } else {
-                printf("BGEU: %s < %s (unsigned) → no branch\n", regNames[rs1], regNames[rs2]);
+                TRACE("BGEU: %s < %s (unsigned) → no branch\n", regNames[rs1], regNames[rs2]);
             }
             break;
         }
@@ -395,17 +444,20 @@ case 0x1: { // I-Type (opcode 001)
         if (imm4_1 & 0x8) offset |= 0xF0;  // Sign-extend to 12 bits if negative
 
         // Base address is in rs1, data to store is in rs2
+        uint16_t addr = regs[rs1] + offset;
         switch (funct3) {
             case 0x0: // SB (Store Byte)
-                printf("SB: Storing byte to address in a0 (rs1) from a1 (rs2), offset = %d\n", offset);
-            // Memory store operation for byte, assume memory is represented as an array `memory`
-            memory[regs[rs1] + offset] = regs[rs2] & 0xFF; // Store byte from rs2
+                TRACE("SB: Storing byte to address in a0 (rs1) from a1 (rs2), offset = %d\n", offset);
+            if (memHooks) observeAccess(addr, 1, 1);
+            // Memory store operation for byte, through the bus (RAM or a device)
+            busStore8(addr, regs[rs2] & 0xFF); // Store byte from rs2
             break;
 
             case 0x1: // SW (Store Word)
-                printf("SW: Storing word to address in a0 (rs1) from a1 (rs2), offset = %d\n", offset);
+                TRACE("SW: Storing word to address in a0 (rs1) from a1 (rs2), offset = %d\n", offset);
+            if (memHooks) observeAccess(addr, 4, 1);
             // Memory store operation for word (4 bytes)
-            *(uint32_t*)&memory[regs[rs1] + offset] = regs[rs2]; // Store word from rs2
+            busStore32(addr, regs[rs2]); // Store word from rs2
             break;
 
             default:
@@ -426,23 +478,27 @@ case 0x1: { // I-Type (opcode 001)
         if (imm4_1 & 0x8) offset |= 0xF0;  // Sign-extend to 12 bits if negative
 
         // Load from memory based on funct3
+        uint16_t addr = regs[rs2] + offset;
         switch (funct3) {
             case 0x0: // LB (Load Byte)
-                printf("LB: Loading byte from address in a0 (rs1) with offset = %d\n", offset);
+                TRACE("LB: Loading byte from address in a0 (rs1) with offset = %d\n", offset);
+            if (memHooks) observeAccess(addr, 1, 0);
             // Memory load operation for byte
-            regs[rd] = (int8_t)memory[regs[rs2] + offset]; // Load signed byte from memory
+            regs[rd] = (int8_t)busLoad8(addr); // Load signed byte from memory
             break;
 
             case 0x1: // LW (Load Word)
-                printf("LW: Loading word from address in a0 (rs1) with offset = %d\n", offset);
+                TRACE("LW: Loading word from address in a0 (rs1) with offset = %d\n", offset);
+            if (memHooks) observeAccess(addr, 4, 0);
             // Memory load operation for word (4 bytes)
-            regs[rd] = *(int32_t*)&memory[regs[rs2] + offset]; // Load word from memory
+            regs[rd] = (uint16_t)busLoad32(addr); // Load word from memory
             break;
 
             case 0x4: // LBU (Load Byte Unsigned)
-                printf("LBU: Loading byte unsigned from address in a0 (rs1) with offset = %d\n", offset);
+                TRACE("LBU: Loading byte unsigned from address in a0 (rs1) with offset = %d\n", offset);
+            if (memHooks) observeAccess(addr, 1, 0);
             // Memory load operation for unsigned byte
-            regs[rd] = (uint8_t)memory[regs[rs2] + offset]; // Load unsigned byte from memory
+            regs[rd] = busLoad8(addr); // Load unsigned byte from memory
             break;
 
             default:
@@ -469,10 +525,10 @@ case 0x1: { // I-Type (opcode 001)
         int32_t target = pc + (offset << 1);  // Multiply offset by 2 (since RISC-V uses byte addresses)
 
         if (f == 0) {  // J (Jump)
-            printf("J: Jumping to address %X\n", target);
+            TRACE("J: Jumping to address %X\n", target);
             pc = target; // Set the PC to the target address
         } else {  // JAL (Jump and Link)
-            printf("JAL: Jumping to address %X and storing return address in rd\n", target);
+            TRACE("JAL: Jumping to address %X and storing return address in rd\n", target);
             regs[rd] = pc + 4;  // Store the address of the next instruction (return address) in rd
             pc = target; // Set the PC to the target address
         }
@@ -494,10 +550,10 @@ case 0x1: { // I-Type (opcode 001)
 
         // Perform the appropriate operation based on the flag (f)
         if (f == 0) {  // JLUI (Load Upper Immediate)
-            printf("JLUI: Setting rd to upper 20-bit immediate %X\n", immediate << 12);
+            TRACE("JLUI: Setting rd to upper 20-bit immediate %X\n", immediate << 12);
             regs[rd] = immediate << 12;  // Set rd to the upper 20 bits of the immediate
         } else {  // AUIPC (Add Upper Immediate to PC)
-            printf("AUIPC: Adding upper 20-bit immediate %X to PC\n", immediate << 12);
+            TRACE("AUIPC: Adding upper 20-bit immediate %X to PC\n", immediate << 12);
             regs[rd] = pc + (immediate << 12);  // Add the immediate shifted by 12 to the current PC
         }
         break;
@@ -505,20 +561,80 @@ case 0x1: { // I-Type (opcode 001)
 
         case 0x7: {  // SYS-Type: ECALL instruction (system call)
             uint8_t service = (inst >> 3) & 0xF;  // ECALL service code is in register a7 (regs[7])
-            printf("Decoded ECALL service: %d\n", service);  // Debugging line to track service number
-
-            if (service == 1) {  // ECALL 1: Print the integer in a0
-                printf("Printing integer from a0: %d\n", regs[6]);  // Debugging print for the integer
-                fflush(stdout);  // Ensure the output is printed immediately
-            } else if (service == 5) {  // ECALL 5: Print a NULL-terminated string (address in a0)
-                char *str = (char*)regs[6];  // a0 is typically in regs[6], pointing to string address
-                printf("Printing string from a0: %s\n", str);  // Print the string
-                fflush(stdout);
-            } else if (service == 3) {  // ECALL 3: Terminate the program
-                printf("Program terminated successfully!\n");
+            TRACE("Decoded ECALL service: %d\n", service);  // Debugging line to track service number
+
+            if (service == ECALL_PRINT_INT) {  // ECALL 1: Print the integer in a0
+                consoleWriteNumber("Printing integer from a0: ", regs[REG_A0]);
+            } else if (service == ECALL_PRINT_STRING) {  // ECALL 5: Print a NULL-terminated string (address in a0)
+                consoleWriteString("Printing string from a0: ", regs[REG_A0]);
+            } else if (service == ECALL_EXIT) {  // ECALL 3: Terminate the program
+                static const char done[] = "Program terminated successfully!\n";
+                consoleWrite(done, sizeof(done) - 1);
                 return 0;  // Exit the program
+            } else if (service == ECALL_READ_INT) {  // ECALL 6: Read an integer into a0, a1 = success
+                uint16_t value;
+                regs[REG_A1] = (uint16_t)consoleReadNumber(&value);
+                regs[REG_A0] = value;
+            } else if (service == ECALL_READ_LINE || service == ECALL_READ_BYTES) {
+                // ECALL 7/8: Read a line / raw bytes into [a0, a0+a1), cut at the top of memory
+                uint16_t addr = regs[REG_A0];
+                uint32_t size = regs[REG_A1];
+                if (size > (uint32_t)MEM_SIZE - addr)
+                    size = MEM_SIZE - addr;
+                if (memHooks && size) observeAccess(addr, (int)size, 1);
+                if (service == ECALL_READ_LINE) {
+                    int len = consoleReadLine(addr, size);
+                    regs[REG_A0] = len < 0 ? 0xFFFF : (uint16_t)len;
+                } else {
+                    regs[REG_A0] = (uint16_t)consoleReadBytes(addr, size);
+                }
+            } else if (service == ECALL_WAIT) {  // ECALL 9: Sleep until input or a0 ms pass
+                regs[REG_A0] = (uint16_t)consoleWait(regs[REG_A0]);
+            } else if (service == ECALL_STREAM_READ || service == ECALL_STREAM_WRITE) {
+                // ECALL 10/11: Open the file named at a0 with its window at a1
+                regs[REG_A0] = streamOpen(regs[REG_A0], regs[REG_A1], service == ECALL_STREAM_WRITE);
+            } else if (service == ECALL_STREAM_NEXT) {  // ECALL 12: Swap window halves
+                uint16_t half, len;
+                if (streamNext(regs[REG_A0], regs[REG_A1], &half, &len) == 0) {
+                    regs[REG_A0] = half;
+                    regs[REG_A1] = len;
+                } else {
+                    regs[REG_A0] = STREAM_FAILED;
+                    regs[REG_A1] = 0;
+                }
+            } else if (service == ECALL_STREAM_CLOSE) {  // ECALL 13: Close the stream in a0
+                regs[REG_A0] = streamClose(regs[REG_A0]);
+            } else if (service == ECALL_HEAP && heapEnabled) {  // ECALL 4: Heap operation selected by t0
+                if (heapEcall() != 0) {
+                    char message[40];
+                    int len = snprintf(message, sizeof(message), "Unknown heap operation: %d\n",
+                                       regs[REG_T0]);
+                    consoleWrite(message, (size_t)len);
+                }
+            } else if (service == ECALL_BULK) {  // ECALL 14: Block memory operation selected by t0
+                int64_t extra = bulkEcall(memHooks ? observeAccess : NULL);
+                if (extra < 0) {
+                    char message[48];
+                    int len = snprintf(message, sizeof(message), "Unknown bulk memory operation: %d\n",
+                                       regs[REG_T0]);
+                    consoleWrite(message, (size_t)len);
+                } else {
+                    ecallCharge = (uint64_t)extra;
+                }
+            } else if (service == ECALL_ACCEL) {  // ECALL 15: Accelerator kernel selected by t0
+                int64_t extra = accelEcall(memHooks ? observeAccess : NULL);
+                if (extra < 0) {
+                    char message[48];
+                    int len = snprintf(message, sizeof(message), "Unknown accelerator kernel: %d\n",
+                                       regs[REG_T0]);
+                    consoleWrite(message, (size_t)len);
+                } else {
+                    ecallCharge = (uint64_t)extra;
+                }
             } else {
-                printf("Unknown ECALL service: %d\n", service);  // Handle unknown services
+                char message[40];
+                int len = snprintf(message, sizeof(message), "Unknown ECALL service: %d\n", service);
+                consoleWrite(message, (size_t)len);  // Handle unknown services
             }
             break;
         }
@@ -527,11 +643,13 @@ case 0x1: { // I-Type (opcode 001)
             return 0;
     }
 
-    printf("Registers: ");
-    for (int i = 0; i < 8; i++) {
-        printf("r%d=%d ", i, regs[i]);
+    if (traceEnabled) {
+        printf("Registers: ");
+        for (int i = 0; i < 8; i++) {
+            printf("r%d=%d ", i, regs[i]);
+        }
+        printf("\n");
     }
-    printf("\n");
 
     if (!pcUpdated) {
         pc += 2;
@@ -543,42 +661,448 @@ case 0x1: { // I-Type (opcode 001)
 
 
 
+// One uninstrumented step at pc, for the co-simulator's divergence replay
+static int replayStep(void) {
+    int savedHooks = memHooks;
+    memHooks = 0;
+    int running = executeInstruction(memory[pc] | (memory[pc+1] << 8));
+    memHooks = savedHooks;
+    ecallCharge = 0;
+    return running;
+}
+
+// Hand control to the debugger. Watchpoints may have come or gone, so the
+// load/store hooks are re-evaluated. Returns 0 if the run should end.
+static int debuggerStop(void) {
+    consoleFlush();
+    int action = gdbStop();
+    if (action == GDB_DETACHED)
+        gdbEnabled = 0;
+    gdbWatchEnabled = gdbEnabled && gdbWatching();
+    memHooks = heatmapEnabled || cacheEnabled || binTraceEnabled || ilpEnabled || cosimEnabled ||
+               gdbWatchEnabled || dmaEnabled;
+    return action != GDB_KILL;
+}
+
 // -----------------------
 // Memory Loading
 // -----------------------
 //
 
-void loadMemoryFromFile(const char *filename) {
-    FILE *fp = fopen(filename, "rb");
-    if(!fp) {
-        perror("Error opening binary file");
+// Loads a flat or segmented image (z16image.h); returns its entry point and
+// sets *end to one past its last byte.
+uint16_t loadMemoryFromFile(const char *filename, uint32_t *end) {
+    uint16_t entry;
+    if (imageLoad(filename, memory, 0, MEM_SIZE, &entry, end) != 0)
         exit(1);
-    }
-    size_t n = fread(memory, 1, MEM_SIZE, fp);
-    fclose(fp);
-    //printf("Loaded %zu bytes into memory\n", n);
+    return entry;
 }
 // -----------------------
 // Main Simulation Loop
 // -----------------------
 int main(int argc, char **argv) {
-    if(argc != 2) {
-        fprintf(stderr, "Usage: %s <machine_code_file>\n", argv[0]);
+    char *filename = NULL;
+    char *callgraphFile = NULL;
+    char *heatmapFile = NULL;
+    char *cacheSpec = NULL;
+    char *cacheStatsFile = NULL;
+    char *timingSpec = NULL;
+    char *binTraceFile = NULL;
+    int metricsEnabled = 0;
+    char *ilpSpec = NULL;
+    char *debugInfoFile = NULL;
+    char *cosimSpec = NULL;
+    char *gdbSpec = NULL;
+    char *consoleSpec = "default";
+    char *dmaSpec = NULL;
+    char *streamSpec = NULL;
+    char *bulkCostSpec = NULL;
+    char *accelSpec = NULL;
+    char *mmuSpec = NULL;
+    char *heapSpec = NULL;
+    int idiomsRequested = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0)
+            traceEnabled = 0;
+        else if (strcmp(argv[i], "--callgraph") == 0) {
+            if (i + 1 < argc) {
+                callgraphFile = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --callgraph requires an output file name\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--heatmap") == 0) {
+            if (i + 1 < argc) {
+                heatmapFile = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --heatmap requires an output file name\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--cache") == 0) {
+            if (i + 1 < argc) {
+                cacheSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --cache requires a cache configuration\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--cache-stats") == 0) {
+            if (i + 1 < argc) {
+                cacheStatsFile = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --cache-stats requires an output file name\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--timing") == 0) {
+            if (i + 1 < argc) {
+                timingSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --timing requires a pipeline configuration\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--metrics") == 0)
+            metricsEnabled = 1;
+        else if (strcmp(argv[i], "--mext") == 0)
+            decodeMulDiv = 1;
+        else if (strcmp(argv[i], "--simd") == 0)
+            decodePackedSimd = 1;
+        else if (strcmp(argv[i], "--idioms") == 0)
+            idiomsRequested = 1;
+        else if (strcmp(argv[i], "--debug-info") == 0) {
+            if (i + 1 < argc) {
+                debugInfoFile = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --debug-info requires a .dbg file name\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--ilp") == 0) {
+            if (i + 1 < argc) {
+                ilpSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --ilp requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--cosim") == 0) {
+            if (i + 1 < argc) {
+                cosimSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --cosim requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--gdb") == 0) {
+            if (i + 1 < argc) {
+                gdbSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --gdb requires a port or unix:<path>\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--console") == 0) {
+            if (i + 1 < argc) {
+                consoleSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --console requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--dma") == 0) {
+            if (i + 1 < argc) {
+                dmaSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --dma requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            if (i + 1 < argc) {
+                streamSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --stream requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--bulk-cost") == 0) {
+            if (i + 1 < argc) {
+                bulkCostSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --bulk-cost requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--accel") == 0) {
+            if (i + 1 < argc) {
+                accelSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --accel requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--heap") == 0) {
+            if (i + 1 < argc) {
+                heapSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --heap requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--mmu") == 0) {
+            if (i + 1 < argc) {
+                mmuSpec = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --mmu requires a spec (or 'default')\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--trace-bin") == 0) {
+            if (i + 1 < argc) {
+                binTraceFile = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --trace-bin requires an output file name\n");
+                exit(1);
+            }
+        }
+        else if (filename == NULL)
+            filename = argv[i];
+    }
+    if (filename == NULL) {
+        fprintf(stderr, "Usage: %s [-q] [--callgraph <folded_file>] [--heatmap <file>]\n"
+                "          [--cache <spec>|default] [--cache-stats <file>]\n"
+                "          [--timing <spec>|default] [--trace-bin <file>]\n"
+                "          [--metrics] [--ilp <spec>|default] [--debug-info <file>]\n"
+                "          [--cosim <spec>|default] [--gdb <port>|unix:<path>]\n"
+                "          [--console <spec>|default] [--dma <spec>|default]\n"
+                "          [--stream <spec>|default] [--bulk-cost <spec>|default]\n"
+                "          [--accel <spec>|default] [--mmu <spec>|default] [--mext] [--simd]\n"
+                "          [--heap <spec>|default] [--idioms]\n"
+                "          <machine_code_file>\n", argv[0]);
         exit(1);
     }
-    loadMemoryFromFile(argv[1]);
+    uint32_t imageEnd;
+    uint16_t entry = loadMemoryFromFile(filename, &imageEnd);
+    // Every page is RAM until a device model claims its pages below.
+    busInit();
+    // Source locations come from the assembler's -g sidecar next to the
+    // binary unless another table is named; without one, nothing changes.
+    if (debugInfoFile) {
+        if (debugInfoOpen(debugInfoFile, 0) != 0)
+            exit(1);
+    } else {
+        char dbgPath[512];
+        debugInfoPathFor(filename, dbgPath, sizeof(dbgPath));
+        debugInfoOpen(dbgPath, 1);
+    }
+    // Guest output is buffered and written by a thread, except while the
+    // text trace has to stay in order with it.
+    if (consoleInit(consoleSpec, traceEnabled) != 0)
+        exit(1);
     memset(regs, 0, sizeof(regs)); // initialize registers to 0
-    pc = 0; // starting at address 0
+    pc = entry; // address 0 unless a segmented image names another
+    if (callgraphFile)
+        profileInit(pc);
+    if (heatmapFile) {
+        memprofInit();
+        heatmapEnabled = memHooks = 1;
+    }
+    if (cacheSpec) {
+        if (cacheInit(cacheSpec) != 0)
+            exit(1);
+        cacheEnabled = memHooks = 1;
+    }
+    if (timingSpec && timingInit(timingSpec) != 0)
+        exit(1);
+    if (bulkCostSpec && bulkInit(bulkCostSpec) != 0)
+        exit(1);
+    if (accelSpec && accelInit(accelSpec) != 0)
+        exit(1);
+    if (binTraceFile) {
+        if (traceOpen(binTraceFile) != 0)
+            exit(1);
+        binTraceEnabled = memHooks = 1;
+    }
+    if (metricsEnabled && metricsOpen(filename) != 0)
+        exit(1);
+    if (ilpSpec) {
+        if (ilpInit(ilpSpec) != 0)
+            exit(1);
+        ilpEnabled = memHooks = 1;
+    }
+    if (cosimSpec) {
+        if (cosimInit(cosimSpec, replayStep) != 0)
+            exit(1);
+        cosimEnabled = memHooks = 1;
+    }
+    // A binary trace must see every byte a transfer writes, so transfers
+    // then run inline as part of the store that starts them.
+    if (dmaSpec) {
+        if (cosimSpec) {
+            fprintf(stderr, "Error: --dma cannot be combined with --cosim (the reference has no DMA model)\n");
+            exit(1);
+        }
+        if (dmaInit(dmaSpec, binTraceEnabled, observeAccess) != 0)
+            exit(1);
+        dmaEnabled = memHooks = 1;
+    }
+    // Streams read and write host files, so a replay could not repeat them.
+    if (streamSpec) {
+        if (cosimSpec) {
+            fprintf(stderr, "Error: --stream cannot be combined with --cosim (a replay cannot repeat file I/O)\n");
+            exit(1);
+        }
+        if (streamInit(streamSpec, observeAccess) != 0)
+            exit(1);
+    }
+    // Bank switches rewrite memory behind the reference's back.
+    if (mmuSpec) {
+        if (cosimSpec) {
+            fprintf(stderr, "Error: --mmu cannot be combined with --cosim (the reference has no MMU model)\n");
+            exit(1);
+        }
+        if (mmuInit(mmuSpec, filename, observeAccess) != 0)
+            exit(1);
+    }
+    // The allocator's state lives outside guest memory.
+    if (heapSpec) {
+        if (cosimSpec) {
+            fprintf(stderr, "Error: --heap cannot be combined with --cosim (the reference has no allocator)\n");
+            exit(1);
+        }
+        if (heapInit(heapSpec, imageEnd, observeAccess) != 0)
+            exit(1);
+        heapEnabled = 1;
+    }
+    int stopped = 0;
+    if (gdbSpec) {
+        if (gdbOpen(gdbSpec) != 0)
+            exit(1);
+        gdbEnabled = 1;
+        stopped = !debuggerStop();
+    }
+    // A replaced loop retires its instructions at once, which only the
+    // instruction count and the call-graph profile can take; the metrics
+    // count every opcode they see.
+    idiomsEnabled = idiomsRequested && !traceEnabled && !memHooks && !timingSpec && !metricsEnabled &&
+                    !gdbEnabled;
+    uint16_t regsBefore[8];
     char disasmBuf[128];
-    while(pc < MEM_SIZE) {
+    const char *traceFile = NULL;
+    uint32_t traceLine = 0;
+    while(!stopped && pc < MEM_SIZE) {
         // Fetch a 16-bit instruction from memory (little-endian)
         uint16_t inst = memory[pc] | (memory[pc+1] << 8);
-        disassemble(inst, pc, disasmBuf, sizeof(disasmBuf));
+        if (traceEnabled) {
+            disassemble(inst, pc, disasmBuf, sizeof(disasmBuf));
+            uint32_t lineNo;
+            const char *file = debugLine(pc, &lineNo);
+            if (file && (file != traceFile || lineNo != traceLine))
+                printf("-- %s:%u\n", file, lineNo);
+            traceFile = file;
+            traceLine = lineNo;
+        }
         //printf("0x%04X: %04X %s\n", pc, inst, disasmBuf);
-        if(!executeInstruction(inst))
+        if (cacheEnabled)
+            cacheFetch(pc);
+        uint16_t instPc = pc;
+        if (binTraceEnabled)
+            memcpy(regsBefore, regs, sizeof(regs));
+        int running = executeInstruction(inst);
+        instructionCount++;
+        if (dmaDoorbellPending)
+            dmaDoorbell();
+        // A bulk memory or accelerator ecall counts as the instructions it
+        // stands for.
+        uint64_t charge = ecallCharge;
+        if (charge) {
+            instructionCount += charge;
+            ecallCharge = 0;
+        }
+        if (binTraceEnabled)
+            traceRecord(instPc, inst, regsBefore, 1 + charge);
+        if (callgraphFile) {
+            profileInstruction(inst);
+            if (charge)
+                profileCharge(charge);
+        }
+        if (timingSpec) {
+            timingInstruction(instPc, inst);
+            if (charge)
+                timingCharge(instPc, charge);
+        }
+        if (ilpEnabled)
+            ilpInstruction(instPc, inst);
+        if (metricsEnabled) {
+            metricsInstruction(inst);
+            if (pc != (uint16_t)(instPc + 2))
+                metricsBlockEnd();
+        }
+        if (cosimEnabled && !cosimInstruction(instPc, running))
+            break;
+        // Breakpoints are looked up at block entries and page crossings only,
+        // unless the debugger armed a per-instruction check.
+        if (gdbEnabled && running &&
+            (gdbArmed || ((pc != (uint16_t)(instPc + 2) || (pc & 0xFF) == 0) && gdbBlockEntry(pc))) &&
+            gdbCheck(pc) && !debuggerStop())
+            break;
+        if(!running) {
+            if (inst == 0x0000 && debugInfoLoaded()) {
+                char name[96], where[96];
+                fprintf(stderr, "Halted on a zero instruction word at 0x%04X %s %s\n", instPc,
+                        debugName(instPc, name, sizeof(name)), debugLocation(instPc, where, sizeof(where)));
+            }
+            if (gdbEnabled)
+                gdbHalted(inst);
             break;
+        }
+        // A taken backward branch may close a copy or fill loop whose
+        // remaining iterations can run on the host.
+        if (idiomsEnabled && pc < instPc) {
+            uint64_t retired = idiomLoop(instPc);
+            if (retired) {
+                instructionCount += retired;
+                if (callgraphFile)
+                    profileCharge(retired);
+            }
+        }
         // Terminate if PC goes out of bounds
         if(pc >= MEM_SIZE) break;
     }
-    return 0;
+    consoleClose();
+    if (dmaEnabled)
+        dmaClose();
+    if (mmuSpec)
+        mmuClose();
+    if (streamSpec)
+        streamShutdown();
+    if (callgraphFile)
+        profileWrite(callgraphFile);
+    if (heatmapFile)
+        memprofWrite(heatmapFile);
+    if (cacheEnabled)
+        cacheReport(cacheStatsFile);
+    if (timingSpec)
+        timingReport();
+    if (binTraceEnabled)
+        traceClose();
+    if (ilpEnabled)
+        ilpReport();
+    if (accelSpec)
+        accelReport();
+    if (heapEnabled)
+        heapReport();
+    if (idiomsRequested)
+        idiomReport();
+    if (metricsEnabled)
+        metricsClose();
+    int status = 0;
+    if (cosimEnabled)
+        status = cosimReport();
+    debugInfoClose();
+    return status;
 }
@@ -314,9 +314,10 @@ int executeInstruction(uint16_t inst) {
             break;
         case 5: { // Print string
             uint16_t addr = regs[6]; // a0 is x6
-            while (memory[addr]) {
-                putchar(memory[addr++]);
-            }
+            // One fwrite up to the terminator (or the top of memory)
+            const unsigned char *str = &memory[addr];
+            const void *nul = memchr(str, 0, MEM_SIZE - addr);
+            fwrite(str, 1, nul ? (size_t)((const unsigned char *)nul - str) : MEM_SIZE - addr, stdout);
             break;
         }
         case 3: // Terminate
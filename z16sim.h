@@ -0,0 +1,32 @@
+/*
+ * Shared state of the Z16 simulator (z16sim.c).
+ *
+ * The interpreter keeps memory, the register file and the program counter in
+ * globals; the instrumentation modules linked into z16_sim read them through
+ * the declarations below. Decoding helpers live in z16decode.h.
+ */
+#ifndef Z16SIM_H
+#define Z16SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "z16decode.h"
+
+#define MEM_SIZE 65536 // 64KB memory
+// Slack after the last byte: LW/SW move 4 bytes and the fetch 2 without
+// wrapping, so accesses at the top of memory land here instead of in
+// whatever the linker placed next.
+#define MEM_GUARD 3
+
+extern unsigned char memory[MEM_SIZE + MEM_GUARD];
+extern uint16_t regs[8];
+extern uint16_t pc;
+
+// Instructions retired so far
+extern uint64_t instructionCount;
+
+// Non-zero while the per-instruction text trace is printed (cleared by -q)
+extern int traceEnabled;
+
+#endif // Z16SIM_H
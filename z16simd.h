@@ -0,0 +1,88 @@
+/*
+ * Packed-byte extension of the Z16 simulator (z16_sim --simd): a register
+ * holds two 8-bit lanes, bits 0-7 and 8-15, and the R-type instructions
+ * with funct3 1 work on both at once as rd op= rs (encodings in
+ * z16decode.h).
+ *
+ * Each operation is SWAR code on the 16-bit register: the lanes' top bits
+ * are split off so carries and borrows never cross into the next lane,
+ * and per-lane conditions become 0x00/0xFF masks. There are only two lanes,
+ * so host vector instructions would not beat this.
+ */
+#ifndef Z16SIMD_H
+#define Z16SIMD_H
+
+#include <stdint.h>
+
+#include "z16decode.h"
+
+#define SIMD_HIGH 0x8080u   // top bit of each lane
+#define SIMD_LOW  0x7F7Fu   // the other bits
+
+// 0xFF in every lane whose top bit is set in `bits`
+static inline uint16_t simdMask(uint16_t bits) {
+    return (uint16_t)(((bits & SIMD_HIGH) >> 7) * 0xFF);
+}
+
+static inline uint16_t simdAdd(uint16_t a, uint16_t b) {
+    return (uint16_t)(((a & SIMD_LOW) + (b & SIMD_LOW)) ^ ((a ^ b) & SIMD_HIGH));
+}
+
+static inline uint16_t simdSub(uint16_t a, uint16_t b) {
+    return (uint16_t)(((a | SIMD_HIGH) - (b & SIMD_LOW)) ^ ((a ^ ~b) & SIMD_HIGH));
+}
+
+// Lanes where a < b unsigned: the borrow out of each lane of a - b
+static inline uint16_t simdBelow(uint16_t a, uint16_t b) {
+    uint16_t d = simdSub(a, b);
+    return simdMask((uint16_t)((~a & b) | ((~a | b) & d)));
+}
+
+// Saturated value for lanes that overflowed: 0x7F if a was positive, else 0x80
+static inline uint16_t simdSaturate(uint16_t a, uint16_t result, uint16_t overflow) {
+    uint16_t limit = (uint16_t)(SIMD_LOW + ((a & SIMD_HIGH) >> 7));
+    uint16_t m = simdMask(overflow);
+    return (uint16_t)((result & ~m) | (limit & m));
+}
+
+static inline uint16_t simdExecute(uint8_t funct4, uint16_t a, uint16_t b) {
+    uint16_t r, m;
+    switch (funct4) {
+        case SIMD_ADDB: return simdAdd(a, b);
+        case SIMD_SUBB: return simdSub(a, b);
+        case SIMD_ADDSB:
+            r = simdAdd(a, b);
+            return simdSaturate(a, r, (uint16_t)(~(a ^ b) & (a ^ r)));
+        case SIMD_SUBSB:
+            r = simdSub(a, b);
+            return simdSaturate(a, r, (uint16_t)((a ^ b) & (a ^ r)));
+        case SIMD_ADDUSB:
+            r = simdAdd(a, b);
+            return r | simdMask((uint16_t)((a & b) | ((a | b) & ~r)));
+        case SIMD_SUBUSB:
+            return (uint16_t)(simdSub(a, b) & ~simdBelow(a, b));
+        case SIMD_MINSB:
+            m = simdBelow(a ^ SIMD_HIGH, b ^ SIMD_HIGH);
+            return (uint16_t)((a & m) | (b & ~m));
+        case SIMD_MAXSB:
+            m = simdBelow(a ^ SIMD_HIGH, b ^ SIMD_HIGH);
+            return (uint16_t)((b & m) | (a & ~m));
+        case SIMD_MINUB:
+            m = simdBelow(a, b);
+            return (uint16_t)((a & m) | (b & ~m));
+        case SIMD_MAXUB:
+            m = simdBelow(a, b);
+            return (uint16_t)((b & m) | (a & ~m));
+        case SIMD_CMPEQB: {
+            uint16_t x = a ^ b;   // top bit set in lanes that differ
+            return (uint16_t)~simdMask((uint16_t)(((x & SIMD_LOW) + SIMD_LOW) | x));
+        }
+        case SIMD_CMPLTB: return simdBelow(a ^ SIMD_HIGH, b ^ SIMD_HIGH);
+        case SIMD_SWAPB: return (uint16_t)((b >> 8) | (b << 8));
+        case SIMD_PACKLB: return (uint16_t)((a & 0x00FF) | (b << 8));
+        case SIMD_PACKHB: return (uint16_t)((a >> 8) | (b & 0xFF00));
+    }
+    return a;
+}
+
+#endif // Z16SIMD_H
@@ -0,0 +1,66 @@
+/*
+ * Option spec parsing (see z16spec.h).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16spec.h"
+
+int specParse(const char *spec, const char *defaults, const char *what, SpecItem item) {
+    if (strcmp(spec, "default") == 0)
+        spec = defaults;
+    char *copy = strdup(spec);
+    if (!copy) {
+        perror("malloc");
+        exit(1);
+    }
+    int status = 0;
+    for (char *key = strtok(copy, ","); key && status == 0; key = strtok(NULL, ",")) {
+        char *eq = strchr(key, '=');
+        if (eq) {
+            *eq = '\0';
+            status = item(key, eq + 1);
+        } else {
+            status = -1;
+        }
+        if (status != 0) {
+            // Quote the item as given; the callback may have cut its value.
+            const char *given = spec + (key - copy);
+            fprintf(stderr, "Error: bad %s parameter '%.*s'\n", what, (int)strcspn(given, ","), given);
+        }
+    }
+    free(copy);
+    return status;
+}
+
+uint64_t specParseBytes(const char *s, char **end) {
+    unsigned long long v = strtoull(s, end, 0);
+    if (**end == 'k' || **end == 'K') {
+        v *= 1024;
+        (*end)++;
+    } else if (**end == 'm' || **end == 'M') {
+        v *= 1024 * 1024;
+        (*end)++;
+    }
+    return (uint64_t)v;
+}
+
+int specNumber(const char *value, uint64_t *out) {
+    char *end;
+    unsigned long long v = strtoull(value, &end, 0);
+    if (end == value || *end || value[0] == '-')
+        return -1;
+    *out = (uint64_t)v;
+    return 0;
+}
+
+int specBytes(const char *value, uint64_t *out) {
+    char *end;
+    uint64_t v = specParseBytes(value, &end);
+    if (end == value || *end || value[0] == '-')
+        return -1;
+    *out = v;
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Option specs of the Z16 simulator: the comma-separated "key=value" lists
+ * that --cache, --timing, --dma, --heap and the other model options take.
+ *
+ * Every module's *Init hands its spec to specParse() with a function that
+ * applies one item, so the syntax, "default" and the error message are the
+ * same everywhere.
+ */
+#ifndef Z16SPEC_H
+#define Z16SPEC_H
+
+#include <stdint.h>
+
+// Apply one item; value may be modified. Returns 0, or -1 if the key is
+// unknown or the value bad.
+typedef int (*SpecItem)(const char *key, char *value);
+
+// Parse `spec` ("default" stands for `defaults`) item by item. The first
+// bad item is reported as "Error: bad <what> parameter '<item>'" and
+// parsing stops. Returns 0 on success.
+int specParse(const char *spec, const char *defaults, const char *what, SpecItem item);
+
+// Leading number of s (decimal, 0x hex or 0 octal) with an optional k or m
+// suffix; *end is left after it.
+uint64_t specParseBytes(const char *s, char **end);
+
+// The whole value as a number, with an optional k or m suffix for
+// specBytes(). Return 0, or -1 if anything else is there.
+int specNumber(const char *value, uint64_t *out);
+int specBytes(const char *value, uint64_t *out);
+
+#endif // Z16SPEC_H
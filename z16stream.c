@@ -0,0 +1,324 @@
+/*
+ * Host file streams (see z16stream.h for the guest's view).
+ *
+ * Spec syntax (comma separated, any order):
+ *   dir=<path>      directory guest paths are resolved in (default ".");
+ *                   absolute paths and ".." components are refused
+ *   chunk=<bytes>   size of each window half, 256-16384 (default 4096)
+ *
+ * Each stream owns two host chunk buffers used as a ring between the
+ * simulating thread and the stream's I/O thread: a reader fills an empty
+ * slot while the guest consumes the other, a writer drains a full slot
+ * while the guest fills the other. One mutex and condition variable per
+ * stream; the handoff happens once per chunk.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "z16sim.h"
+#include "z16stream.h"
+#include "z16spec.h"
+
+#define MAX_STREAMS 8
+#define MAX_PATH_LEN 256
+
+typedef struct {
+    int inUse;
+    int fd;
+    int writing;
+    uint16_t window;
+    int held;                   // half of the window the guest has, or -1
+
+    unsigned char *buf[2];
+    uint32_t len[2];
+    int full[2];
+    int head;                   // slot the simulating thread uses next
+    int tail;                   // slot the I/O thread uses next
+    int atEnd;                  // reader saw end of file
+    int error;                  // errno of a failed read or write
+    int closing;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Stream;
+
+static Stream streams[MAX_STREAMS];
+static int enabled = 0;
+static char rootDir[MAX_PATH_LEN] = ".";
+static uint32_t chunkSize = 4096;
+static StreamObserve observer = NULL;
+
+static uint64_t opened = 0;
+static uint64_t bytesRead = 0;
+static uint64_t bytesWritten = 0;
+static uint64_t guestWaits = 0;     // the guest found the I/O thread behind
+
+// -----------------------
+// I/O threads
+// -----------------------
+
+static void *readerMain(void *arg) {
+    Stream *s = (Stream *)arg;
+    pthread_mutex_lock(&s->lock);
+    while (!s->closing && !s->atEnd && !s->error) {
+        if (s->full[s->tail]) {
+            pthread_cond_wait(&s->cond, &s->lock);
+            continue;
+        }
+        int slot = s->tail;
+        pthread_mutex_unlock(&s->lock);
+        uint32_t got = 0;
+        int err = 0;
+        while (got < chunkSize) {
+            ssize_t n = read(s->fd, s->buf[slot] + got, chunkSize - got);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                err = errno;
+            if (n <= 0)
+                break;
+            got += (uint32_t)n;
+        }
+        pthread_mutex_lock(&s->lock);
+        if (err) {
+            s->error = err;
+        } else if (got == 0) {
+            s->atEnd = 1;
+        } else {
+            s->len[slot] = got;
+            s->full[slot] = 1;
+            s->tail ^= 1;
+        }
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+static void *writerMain(void *arg) {
+    Stream *s = (Stream *)arg;
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        if (!s->full[s->tail]) {
+            if (s->closing)
+                break;
+            pthread_cond_wait(&s->cond, &s->lock);
+            continue;
+        }
+        int slot = s->tail;
+        pthread_mutex_unlock(&s->lock);
+        uint32_t done = 0;
+        int err = 0;
+        while (done < s->len[slot]) {
+            ssize_t n = write(s->fd, s->buf[slot] + done, s->len[slot] - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                err = errno;
+                break;
+            }
+            done += (uint32_t)n;
+        }
+        pthread_mutex_lock(&s->lock);
+        if (err && !s->error)
+            s->error = err;
+        s->full[slot] = 0;
+        s->tail ^= 1;
+        pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// -----------------------
+// Guest services
+// -----------------------
+
+static int streamItem(const char *key, char *value) {
+    if (strcmp(key, "dir") == 0) {
+        if (strlen(value) >= sizeof(rootDir))
+            return -1;
+        strcpy(rootDir, value);
+        return 0;
+    }
+    uint64_t v;
+    if (strcmp(key, "chunk") != 0 || specNumber(value, &v) != 0)
+        return -1;
+    chunkSize = (uint32_t)v;
+    return 0;
+}
+
+int streamInit(const char *spec, StreamObserve observe) {
+    int status = specParse(spec, "", "stream", streamItem);
+    if (status == 0 && (chunkSize < 256 || chunkSize > 16384)) {
+        fprintf(stderr, "Error: stream chunk must be between 256 and 16384 bytes\n");
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+    enabled = 1;
+    observer = observe;
+    return 0;
+}
+
+// Build the host path for a guest string, refusing anything that could
+// leave rootDir. Returns 0 on success.
+static int hostPath(uint16_t pathAddr, char *out, size_t outSize) {
+    char name[MAX_PATH_LEN];
+    size_t n = 0;
+    while (n < sizeof(name) - 1 && pathAddr + n < MEM_SIZE && memory[pathAddr + n]) {
+        name[n] = (char)memory[pathAddr + n];
+        n++;
+    }
+    name[n] = '\0';
+    if (n == 0 || name[0] == '/')
+        return -1;
+    for (const char *p = name; p; p = strchr(p, '/')) {
+        if (*p == '/')
+            p++;
+        if (strncmp(p, "..", 2) == 0 && (p[2] == '/' || p[2] == '\0'))
+            return -1;
+    }
+    return snprintf(out, outSize, "%s/%s", rootDir, name) < (int)outSize ? 0 : -1;
+}
+
+uint16_t streamOpen(uint16_t pathAddr, uint16_t window, int writing) {
+    static int warned = 0;
+    if (!enabled) {
+        if (!warned)
+            fprintf(stderr, "stream: file streams are disabled; run with --stream to allow them\n");
+        warned = 1;
+        return STREAM_FAILED;
+    }
+    if ((uint32_t)window + 2 * chunkSize > MEM_SIZE)
+        return STREAM_FAILED;
+    int h = 0;
+    while (h < MAX_STREAMS && streams[h].inUse)
+        h++;
+    char path[MAX_PATH_LEN + sizeof(rootDir) + 1];
+    if (h == MAX_STREAMS || hostPath(pathAddr, path, sizeof(path)) != 0)
+        return STREAM_FAILED;
+    int fd = writing ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+    if (fd < 0)
+        return STREAM_FAILED;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!writing)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    Stream *s = &streams[h];
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->writing = writing;
+    s->window = window;
+    s->held = -1;
+    s->buf[0] = (unsigned char *)malloc(chunkSize);
+    s->buf[1] = (unsigned char *)malloc(chunkSize);
+    if (!s->buf[0] || !s->buf[1]) {
+        perror("malloc");
+        exit(1);
+    }
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if (pthread_create(&s->thread, NULL, writing ? writerMain : readerMain, s) != 0) {
+        close(fd);
+        free(s->buf[0]);
+        free(s->buf[1]);
+        return STREAM_FAILED;
+    }
+    s->inUse = 1;
+    opened++;
+    return (uint16_t)h;
+}
+
+int streamNext(uint16_t handle, uint16_t produced, uint16_t *addr, uint16_t *len) {
+    if (handle >= MAX_STREAMS || !streams[handle].inUse)
+        return -1;
+    Stream *s = &streams[handle];
+    int half = s->held < 0 ? 0 : s->held ^ 1;
+    uint16_t halfAddr = (uint16_t)(s->window + half * chunkSize);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->writing) {
+        if (s->held >= 0 && produced > 0) {
+            if (produced > chunkSize)
+                produced = (uint16_t)chunkSize;
+            if (s->full[s->head]) {
+                guestWaits++;
+                while (s->full[s->head])
+                    pthread_cond_wait(&s->cond, &s->lock);
+            }
+            uint16_t from = (uint16_t)(s->window + s->held * chunkSize);
+            if (observer)
+                observer(from, produced, 0);
+            memcpy(s->buf[s->head], &memory[from], produced);
+            s->len[s->head] = produced;
+            s->full[s->head] = 1;
+            s->head ^= 1;
+            bytesWritten += produced;
+            pthread_cond_broadcast(&s->cond);
+        }
+        *len = (uint16_t)chunkSize;
+    } else {
+        if (!s->full[s->head] && !s->atEnd && !s->error) {
+            guestWaits++;
+            while (!s->full[s->head] && !s->atEnd && !s->error)
+                pthread_cond_wait(&s->cond, &s->lock);
+        }
+        uint32_t got = 0;
+        if (s->full[s->head]) {
+            got = s->len[s->head];
+            if (observer)
+                observer(halfAddr, (int)got, 1);
+            memcpy(&memory[halfAddr], s->buf[s->head], got);
+            s->full[s->head] = 0;
+            s->head ^= 1;
+            bytesRead += got;
+            pthread_cond_broadcast(&s->cond);
+        }
+        *len = (uint16_t)got;
+    }
+    int failed = s->error != 0 && (s->writing || *len == 0);
+    pthread_mutex_unlock(&s->lock);
+    if (failed)
+        return -1;
+    s->held = half;
+    *addr = halfAddr;
+    return 0;
+}
+
+uint16_t streamClose(uint16_t handle) {
+    if (handle >= MAX_STREAMS || !streams[handle].inUse)
+        return STREAM_FAILED;
+    Stream *s = &streams[handle];
+    pthread_mutex_lock(&s->lock);
+    s->closing = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    int failed = s->error != 0;
+    if (close(s->fd) != 0 && s->writing)
+        failed = 1;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s->buf[0]);
+    free(s->buf[1]);
+    s->inUse = 0;
+    return failed ? STREAM_FAILED : 0;
+}
+
+void streamShutdown(void) {
+    for (int h = 0; h < MAX_STREAMS; h++)
+        if (streams[h].inUse && streamClose((uint16_t)h) != 0)
+            fprintf(stderr, "stream: I/O error on stream %d\n", h);
+    fprintf(stderr, "stream: %llu opened, %llu bytes read, %llu bytes written, %llu waits for the host\n",
+            (unsigned long long)opened, (unsigned long long)bytesRead,
+            (unsigned long long)bytesWritten, (unsigned long long)guestWaits);
+}
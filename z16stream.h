@@ -0,0 +1,48 @@
+/*
+ * Host file streams for the Z16 simulator: data larger than guest memory
+ * flows through a guest window of two equal halves.
+ *
+ * A read stream hands the guest one half at a time, filled with the next
+ * chunk of the file; a write stream takes the bytes the guest put in its
+ * half and hands out the other one. Behind each stream a host thread keeps
+ * two chunk buffers busy, reading ahead (or writing behind) while the guest
+ * works, so the guest only waits when the disk is slower than it is.
+ *
+ * Chunks are copied into and out of guest memory by the simulating thread
+ * at the ecall, so the window is never written behind the guest's back and
+ * the load/store instrumentation sees every byte.
+ */
+#ifndef Z16STREAM_H
+#define Z16STREAM_H
+
+#include <stdint.h>
+
+#define STREAM_FAILED 0xFFFF
+
+// Reports the window bytes an ecall reads or writes to the load/store
+// instrumentation; called before guest memory changes.
+typedef void (*StreamObserve)(uint16_t addr, int size, int isWrite);
+
+// Parse a spec such as "dir=data,chunk=4096" (or "default") and allow
+// guest programs to open files below that directory. Returns 0 on success.
+int streamInit(const char *spec, StreamObserve observe);
+
+// Open the file named by the guest string at pathAddr with its window of
+// two chunks at `window`. Returns a handle, or STREAM_FAILED.
+uint16_t streamOpen(uint16_t pathAddr, uint16_t window, int writing);
+
+// Read stream: copy the next chunk into the other half of the window and
+// return its address and length (0 at end of file). Write stream: queue
+// the first `produced` bytes of the half the guest holds and return the
+// other half and its capacity. Returns 0, or -1 on a bad handle or an I/O
+// error.
+int streamNext(uint16_t handle, uint16_t produced, uint16_t *addr, uint16_t *len);
+
+// Finish writing, stop the stream's thread and free the handle. Returns 0,
+// or STREAM_FAILED on a bad handle or an I/O error.
+uint16_t streamClose(uint16_t handle);
+
+// Close every stream still open and print the statistics to stderr.
+void streamShutdown(void);
+
+#endif // Z16STREAM_H
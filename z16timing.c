@@ -0,0 +1,260 @@
+/*
+ * Cycle-approximate in-order pipeline timing model for the Z16 simulator.
+ *
+ * Spec syntax (comma separated, any order):
+ *   depth=<n>        pipeline stages (default 5)
+ *   branch=<n>       stage in which branches and register jumps resolve
+ *                    (default 3); a misprediction costs branch-1 cycles
+ *   loaduse=<n>      extra cycles before a loaded value can be forwarded
+ *                    (default 1)
+ *   mul=<n>          M extension multiply latency in cycles (default 3)
+ *   div=<n>          M extension divide/remainder latency (default 12); the
+ *                    divider is not pipelined, so a divide also waits for
+ *                    the one before it
+ *   predictor=static | bimodal[:bits] | gshare[:bits]
+ *                    static is backward-taken/forward-not-taken; table
+ *                    predictors use 2-bit counters (default bimodal:10)
+ *
+ * J/JAL targets are known in decode and cost one bubble; JR/JALR have no
+ * target prediction and always wait for the branch stage.
+ *
+ * The model keeps a ready cycle per register (a scoreboard) rather than
+ * simulating pipeline latches, so it costs a few compares per instruction.
+ */
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16sim.h"
+#include "z16timing.h"
+#include "z16debuginfo.h"
+#include "z16spec.h"
+
+#define TOP_STALL_PCS 10
+
+typedef enum { PRED_STATIC, PRED_BIMODAL, PRED_GSHARE } Predictor;
+
+typedef enum {
+    STALL_LOAD_USE,
+    STALL_LATENCY,
+    STALL_MISPREDICT,
+    STALL_JUMP,
+    STALL_JUMP_REG,
+    NUM_STALL_CAUSES
+} StallCause;
+
+static const char *stallNames[NUM_STALL_CAUSES] = {
+    "load-use", "long latency", "branch mispredict", "jump redirect", "register jump",
+};
+
+static int depth = 5;
+static int branchStage = 3;
+static int loadUse = 1;
+static int mulLatency = 3;
+static int divLatency = 12;
+static Predictor predictor = PRED_BIMODAL;
+static int tableBits = 10;
+
+static uint8_t *counters = NULL;   // 2-bit saturating counters
+static uint32_t history = 0;       // gshare global history
+
+static uint64_t regReady[8];       // first cycle the register can be consumed
+static uint8_t regCause[8];        // stall cause charged when waiting on it
+static uint64_t nextIssue = 0;     // earliest issue cycle of the next instruction
+static uint64_t dividerFree = 0;   // first cycle the divider can start another
+static uint64_t instructions = 0;
+static uint64_t charged = 0;       // of which counted for bulk and accelerator ecalls
+static uint64_t stalls[NUM_STALL_CAUSES];
+static uint64_t branches = 0, mispredicts = 0;
+static uint64_t *pcStalls = NULL;  // [MEM_SIZE / 2]
+
+// The whole value as a parameter; the ranges are checked in timingInit().
+static int intValue(const char *value, int *out) {
+    uint64_t v;
+    if (specNumber(value, &v) != 0 || v > INT_MAX)
+        return -1;
+    *out = (int)v;
+    return 0;
+}
+
+static int timingItem(const char *key, char *value) {
+    if (strcmp(key, "depth") == 0) return intValue(value, &depth);
+    if (strcmp(key, "branch") == 0) return intValue(value, &branchStage);
+    if (strcmp(key, "loaduse") == 0) return intValue(value, &loadUse);
+    if (strcmp(key, "mul") == 0) return intValue(value, &mulLatency);
+    if (strcmp(key, "div") == 0) return intValue(value, &divLatency);
+    if (strcmp(key, "predictor") == 0) {
+        char *colon = strchr(value, ':');
+        if (colon) {
+            *colon = '\0';
+            if (intValue(colon + 1, &tableBits) != 0)
+                return -1;
+        }
+        if (strcmp(value, "static") == 0) predictor = PRED_STATIC;
+        else if (strcmp(value, "bimodal") == 0) predictor = PRED_BIMODAL;
+        else if (strcmp(value, "gshare") == 0) predictor = PRED_GSHARE;
+        else return -1;
+        return 0;
+    }
+    return -1;
+}
+
+int timingInit(const char *spec) {
+    int status = specParse(spec, "depth=5,branch=3,loaduse=1,mul=3,div=12,predictor=bimodal:10",
+                           "timing", timingItem);
+    if (status == 0 && (depth < 2 || branchStage < 2 || branchStage > depth ||
+                        loadUse < 0 || mulLatency < 1 || divLatency < 1 ||
+                        tableBits < 1 || tableBits > 20)) {
+        fprintf(stderr, "Error: timing model needs depth >= 2, 2 <= branch <= depth, "
+                "loaduse >= 0, mul and div >= 1 and 1 <= predictor bits <= 20\n");
+        status = -1;
+    }
+    if (status != 0)
+        return -1;
+
+    counters = (uint8_t *)malloc((size_t)1 << tableBits);
+    pcStalls = (uint64_t *)calloc(MEM_SIZE / 2, sizeof(uint64_t));
+    if (!counters || !pcStalls) { perror("malloc"); exit(1); }
+    memset(counters, 1, (size_t)1 << tableBits); // weakly not-taken
+    return 0;
+}
+
+static void charge(StallCause cause, uint16_t instPc, uint64_t cycles) {
+    stalls[cause] += cycles;
+    pcStalls[instPc >> 1] += cycles;
+}
+
+// Predict and train; returns 1 if the branch was mispredicted.
+static int predictBranch(uint16_t instPc, uint16_t inst, int taken) {
+    int predicted;
+    if (predictor == PRED_STATIC) {
+        predicted = ((inst >> 12) & 0x8) != 0; // negative offset: backward
+    } else {
+        uint32_t mask = (1u << tableBits) - 1;
+        uint32_t index = (uint32_t)(instPc >> 1);
+        if (predictor == PRED_GSHARE)
+            index ^= history;
+        uint8_t *ctr = &counters[index & mask];
+        predicted = *ctr >= 2;
+        if (taken && *ctr < 3) (*ctr)++;
+        if (!taken && *ctr > 0) (*ctr)--;
+        history = ((history << 1) | (uint32_t)taken) & mask;
+    }
+    return predicted != taken;
+}
+
+void timingInstruction(uint16_t instPc, uint16_t inst) {
+    InstInfo info;
+    decodeOperands(inst, &info);
+    instructions++;
+
+    // Data hazards: wait for the latest-ready source register.
+    uint64_t issue = nextIssue;
+    int cause = -1;
+    for (int r = 0; r < 8; r++) {
+        if ((info.srcMask >> r) & 1 && regReady[r] > issue) {
+            issue = regReady[r];
+            cause = regCause[r];
+        }
+    }
+    if (info.kind == KIND_DIV && dividerFree > issue) {
+        issue = dividerFree;
+        cause = STALL_LATENCY;
+    }
+    if (cause >= 0)
+        charge((StallCause)cause, instPc, issue - nextIssue);
+
+    uint64_t latency = 1;
+    uint8_t producerCause = STALL_LATENCY;
+    if (info.kind == KIND_LOAD) {
+        latency = 1 + (uint64_t)loadUse;
+        producerCause = STALL_LOAD_USE;
+    } else if (info.kind == KIND_MUL) {
+        latency = (uint64_t)mulLatency;
+    } else if (info.kind == KIND_DIV) {
+        latency = (uint64_t)divLatency;
+        dividerFree = issue + latency;
+    }
+    for (int r = 0; r < 8; r++) {
+        if ((info.dstMask >> r) & 1) {
+            regReady[r] = issue + latency;
+            regCause[r] = producerCause;
+        }
+    }
+    nextIssue = issue + 1;
+
+    // Control hazards: bubbles before the next instruction can issue.
+    if (info.kind == KIND_BRANCH) {
+        branches++;
+        int taken = pc != (uint16_t)(instPc + 2);
+        if (predictBranch(instPc, inst, taken)) {
+            mispredicts++;
+            nextIssue += branchStage - 1;
+            charge(STALL_MISPREDICT, instPc, branchStage - 1);
+        }
+    } else if (info.kind == KIND_JUMP) {
+        nextIssue += 1;
+        charge(STALL_JUMP, instPc, 1);
+    } else if (info.kind == KIND_JUMP_REG) {
+        nextIssue += branchStage - 1;
+        charge(STALL_JUMP_REG, instPc, branchStage - 1);
+    }
+}
+
+void timingCharge(uint16_t instPc, uint64_t extra) {
+    (void)instPc;
+    instructions += extra;
+    charged += extra;
+    nextIssue += extra;
+}
+
+void timingReport(void) {
+    static const char *predictorNames[] = { "static", "bimodal", "gshare" };
+    uint64_t cycles = instructions ? nextIssue + depth - 1 : 0;
+    uint64_t totalStalls = 0;
+    for (int c = 0; c < NUM_STALL_CAUSES; c++)
+        totalStalls += stalls[c];
+
+    fprintf(stderr, "\n--- Timing Model (depth %d, branch stage %d, load-use %d, mul %d, div %d, %s",
+            depth, branchStage, loadUse, mulLatency, divLatency, predictorNames[predictor]);
+    if (predictor != PRED_STATIC)
+        fprintf(stderr, ":%d", tableBits);
+    fprintf(stderr, ") ---\n");
+    fprintf(stderr, "Instructions: %llu  Cycles: %llu  CPI: %.3f\n",
+            (unsigned long long)instructions, (unsigned long long)cycles,
+            instructions ? (double)cycles / instructions : 0.0);
+    if (charged)
+        fprintf(stderr, "Charged for bulk and accelerator ecalls: %llu instructions\n", (unsigned long long)charged);
+    fprintf(stderr, "Stall cycles: %llu\n", (unsigned long long)totalStalls);
+    for (int c = 0; c < NUM_STALL_CAUSES; c++) {
+        fprintf(stderr, "  %-18s %12llu  (%5.1f%%)\n", stallNames[c], (unsigned long long)stalls[c],
+                totalStalls ? 100.0 * stalls[c] / totalStalls : 0.0);
+    }
+    fprintf(stderr, "Branches: %llu  mispredicted: %llu (%.2f%%)\n",
+            (unsigned long long)branches, (unsigned long long)mispredicts,
+            branches ? 100.0 * mispredicts / branches : 0.0);
+
+    // Top stalling PCs by repeated selection; the table is small.
+    fprintf(stderr, "Top stalling PCs:\n");
+    char disasm[128], where[96];
+    for (int k = 0; k < TOP_STALL_PCS; k++) {
+        int best = -1;
+        for (int i = 0; i < MEM_SIZE / 2; i++) {
+            if (pcStalls[i] && (best < 0 || pcStalls[i] > pcStalls[best]))
+                best = i;
+        }
+        if (best < 0)
+            break;
+        uint16_t instPc = (uint16_t)(best << 1);
+        uint16_t inst = memory[instPc] | (memory[instPc + 1] << 8);
+        disassemble(inst, instPc, disasm, sizeof(disasm));
+        fprintf(stderr, "  0x%04X  %12llu  %-24s %s\n", instPc, (unsigned long long)pcStalls[best], disasm,
+                debugLocation(instPc, where, sizeof(where)));
+        pcStalls[best] = 0;
+    }
+
+    free(counters);
+    free(pcStalls);
+}
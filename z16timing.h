@@ -0,0 +1,30 @@
+/*
+ * Cycle-approximate in-order pipeline timing model for the Z16 simulator.
+ *
+ * A single-issue pipeline with full forwarding: instructions issue one per
+ * cycle unless a source register is not ready yet (load-use or long-latency
+ * producer) or the front end is redirected by a mispredicted branch or a
+ * jump. Hazards are found from decodeOperands(); branch outcomes come from
+ * the PC after execution.
+ */
+#ifndef Z16TIMING_H
+#define Z16TIMING_H
+
+#include <stdint.h>
+
+// Parse a spec such as "depth=5,branch=3,loaduse=1,predictor=gshare:10"
+// (or "default"). Returns 0 on success.
+int timingInit(const char *spec);
+
+// Account one retired instruction; call after executeInstruction(inst).
+void timingInstruction(uint16_t instPc, uint16_t inst);
+
+// The instruction at instPc counts as `extra` more instructions, each
+// taking a cycle (bulk memory and accelerator ecalls); call after
+// timingInstruction().
+void timingCharge(uint16_t instPc, uint64_t extra);
+
+// Print CPI, stall breakdown and the top stalling PCs to stderr.
+void timingReport(void);
+
+#endif // Z16TIMING_H
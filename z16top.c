@@ -0,0 +1,192 @@
+/*
+ * z16top: live view of all running Z16 simulators on this machine.
+ *
+ * Attaches read-only to every metrics segment (layout: z16metrics.h) found in
+ * METRICS_SHM_DIR and refreshes a table of retired instructions, the rate
+ * sampled between refreshes (LIVE), the rate the simulator published (SIM),
+ * the average since start (AVG), the current pc, the busiest ecall services
+ * and the dominant opcode class. Simulators are started with `z16_sim --metrics ...`.
+ *
+ * Usage:
+ *   z16top [-d <seconds>] [-n <refreshes>]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "z16metrics.h"
+
+#define MAX_SIMULATORS 64
+
+typedef struct {
+    int32_t pid;
+    uint64_t instructions;   // at the previous refresh
+    int seen;
+    unsigned generation;     // last refresh that found this simulator
+} History;
+
+static History history[MAX_SIMULATORS];
+static unsigned generation = 0;
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Map one segment read-only; NULL if it is not a compatible, live simulator.
+static const Z16Metrics *attach(const char *name) {
+    char path[300];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    const Z16Metrics *m = (const Z16Metrics *)mmap(NULL, sizeof(Z16Metrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+        return NULL;
+    if (m->magic != METRICS_MAGIC || m->version < METRICS_VERSION || m->size < sizeof(Z16Metrics) ||
+        (kill(m->pid, 0) != 0 && atomic_load_explicit(&m->state, memory_order_relaxed) != METRICS_EXITED)) {
+        munmap((void *)m, sizeof(Z16Metrics));
+        return NULL;
+    }
+    return m;
+}
+
+static History *historyFor(int32_t pid) {
+    History *freeSlot = NULL;
+    for (int i = 0; i < MAX_SIMULATORS; i++) {
+        if (history[i].pid == pid)
+            return &history[i];
+        if (!freeSlot && history[i].pid == 0)
+            freeSlot = &history[i];
+    }
+    if (freeSlot) {
+        freeSlot->pid = pid;
+        freeSlot->seen = 0;
+    }
+    return freeSlot;
+}
+
+static void humanRate(char *buf, size_t size, double rate) {
+    if (rate >= 1e9) snprintf(buf, size, "%.2fG", rate / 1e9);
+    else if (rate >= 1e6) snprintf(buf, size, "%.2fM", rate / 1e6);
+    else if (rate >= 1e3) snprintf(buf, size, "%.1fk", rate / 1e3);
+    else snprintf(buf, size, "%.0f", rate);
+}
+
+static void refresh(double interval) {
+    static const char *opcodeNames[8] = { "R", "I", "B", "S", "L", "J", "U", "SYS" };
+    printf("\033[H\033[J");
+    printf("%-8s %-20s %-7s %16s %10s %10s %10s %7s  %-24s %s\n", "PID", "PROGRAM", "STATE",
+           "INSTRUCTIONS", "LIVE/s", "SIM/s", "AVG/s", "PC", "TOP ECALLS", "MIX");
+    generation++;
+
+    DIR *dir = opendir(METRICS_SHM_DIR);
+    if (!dir) {
+        perror("Error opening " METRICS_SHM_DIR);
+        exit(1);
+    }
+    int shown = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, METRICS_SHM_PREFIX + 1, strlen(METRICS_SHM_PREFIX) - 1) != 0)
+            continue;
+        const Z16Metrics *m = attach(de->d_name);
+        if (!m)
+            continue;
+        uint64_t instructions = atomic_load_explicit(&m->instructions, memory_order_relaxed);
+        uint64_t published = atomic_load_explicit(&m->instructionsPerSecond, memory_order_relaxed);
+        uint32_t state = atomic_load_explicit(&m->state, memory_order_relaxed);
+        uint32_t pc = atomic_load_explicit(&m->pc, memory_order_relaxed);
+
+        History *h = historyFor(m->pid);
+        double live = 0.0;
+        if (h && h->seen && instructions >= h->instructions)
+            live = (instructions - h->instructions) / interval;
+        if (h) {
+            h->instructions = instructions;
+            h->seen = 1;
+            h->generation = generation;
+        }
+
+        // Two busiest ecall services and the dominant opcode class.
+        int top1 = -1, top2 = -1;
+        for (int s = 0; s < 16; s++) {
+            uint64_t c = atomic_load_explicit(&m->ecalls[s], memory_order_relaxed);
+            if (c == 0) continue;
+            if (top1 < 0 || c > atomic_load_explicit(&m->ecalls[top1], memory_order_relaxed)) {
+                top2 = top1;
+                top1 = s;
+            } else if (top2 < 0 || c > atomic_load_explicit(&m->ecalls[top2], memory_order_relaxed)) {
+                top2 = s;
+            }
+        }
+        char ecalls[64] = "-";
+        if (top1 >= 0) {
+            int n = snprintf(ecalls, sizeof(ecalls), "%d:%llu", top1,
+                             (unsigned long long)atomic_load_explicit(&m->ecalls[top1], memory_order_relaxed));
+            if (top2 >= 0)
+                snprintf(ecalls + n, sizeof(ecalls) - n, " %d:%llu", top2,
+                         (unsigned long long)atomic_load_explicit(&m->ecalls[top2], memory_order_relaxed));
+        }
+        int topOp = 0;
+        for (int o = 1; o < 8; o++) {
+            if (atomic_load_explicit(&m->opcodes[o], memory_order_relaxed) >
+                atomic_load_explicit(&m->opcodes[topOp], memory_order_relaxed))
+                topOp = o;
+        }
+        double mix = instructions ?
+            100.0 * atomic_load_explicit(&m->opcodes[topOp], memory_order_relaxed) / instructions : 0.0;
+
+        double elapsed = (monotonicNs() - m->startNs) / 1e9;
+        char liveStr[16], simStr[16], avgStr[16];
+        humanRate(liveStr, sizeof(liveStr), live);
+        humanRate(simStr, sizeof(simStr), (double)published);
+        humanRate(avgStr, sizeof(avgStr), elapsed > 0 ? instructions / elapsed : 0.0);
+        printf("%-8d %-20.20s %-7s %16llu %10s %10s %10s 0x%04X  %-24s %s %.0f%%\n", m->pid, m->program,
+               state == METRICS_RUNNING ? "run" : "exit", (unsigned long long)instructions,
+               liveStr, simStr, avgStr, pc, ecalls, opcodeNames[topOp], mix);
+        shown++;
+        munmap((void *)m, sizeof(Z16Metrics));
+    }
+    closedir(dir);
+    for (int i = 0; i < MAX_SIMULATORS; i++) {
+        if (history[i].pid != 0 && history[i].generation != generation)
+            history[i].pid = 0; // simulator went away
+    }
+    if (shown == 0)
+        printf("(no simulators running with --metrics)\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    double delay = 1.0;
+    long iterations = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            delay = atof(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atol(argv[++i]);
+        else {
+            fprintf(stderr, "Usage: %s [-d <seconds>] [-n <refreshes>]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (delay <= 0)
+        delay = 1.0;
+
+    for (long i = 0; iterations < 0 || i < iterations; i++) {
+        refresh(delay);
+        if (iterations < 0 || i + 1 < iterations)
+            usleep((useconds_t)(delay * 1e6));
+    }
+    return 0;
+}
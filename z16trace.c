@@ -0,0 +1,257 @@
+/*
+ * z16trace: decoder for Z16 binary execution traces (format: z16trace.h).
+ *
+ * Prints one line per retired instruction with the registers and memory it
+ * wrote. The sparse chunk index at the end of the file lets --seek start
+ * decoding at the chunk containing the requested instruction instead of the
+ * beginning of the trace.
+ *
+ * Usage:
+ *   z16trace [--seek <index>] [--count <n>] [--pc-range <lo>:<hi>] [--summary]
+ *            [--debug-info <dbg_file>] <trace_file>
+ *
+ * With --debug-info (the assembler's -g output) every line also shows the
+ * source file:line of its instruction.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z16trace.h"
+#include "z16debuginfo.h"
+
+#define MEM_SIZE 65536
+
+static const char *regNames[8] = {"t0", "ra", "sp", "s0", "s1", "t1", "a0", "a1"};
+
+typedef struct {
+    uint64_t firstIndex;
+    uint64_t offset;
+} IndexEntry;
+
+// Decoder state carried from record to record within a chunk
+static uint16_t lastInst[MEM_SIZE / 2];
+static uint32_t lastInstChunk[MEM_SIZE / 2];
+
+static void fail(const char *msg) {
+    fprintf(stderr, "Error: %s\n", msg);
+    exit(1);
+}
+
+// Largest chunk whose first instruction index is <= target.
+static uint32_t findChunk(const IndexEntry *index, uint32_t count, uint64_t target) {
+    uint32_t lo = 0, hi = count;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index[mid].firstIndex <= target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int main(int argc, char **argv) {
+    char *filename = NULL;
+    uint64_t seek = 0;
+    uint64_t count = UINT64_MAX;
+    unsigned long pcLo = 0, pcHi = 0xFFFF;
+    int summaryOnly = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc)
+            seek = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--pc-range") == 0 && i + 1 < argc) {
+            char *colon;
+            pcLo = strtoul(argv[++i], &colon, 0);
+            if (*colon != ':') {
+                fprintf(stderr, "Error: --pc-range expects <lo>:<hi>\n");
+                exit(1);
+            }
+            pcHi = strtoul(colon + 1, NULL, 0);
+        }
+        else if (strcmp(argv[i], "--summary") == 0)
+            summaryOnly = 1;
+        else if (strcmp(argv[i], "--debug-info") == 0 && i + 1 < argc) {
+            if (debugInfoOpen(argv[++i], 0) != 0)
+                exit(1);
+        }
+        else if (filename == NULL)
+            filename = argv[i];
+    }
+    if (filename == NULL) {
+        fprintf(stderr, "Usage: %s [--seek <index>] [--count <n>] [--pc-range <lo>:<hi>] [--summary]\n"
+                "          [--debug-info <dbg_file>] <trace_file>\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        perror("Error opening trace file");
+        exit(1);
+    }
+    unsigned char header[TRACE_HEADER_BYTES];
+    if (fread(header, 1, TRACE_HEADER_BYTES, fp) != TRACE_HEADER_BYTES ||
+        memcmp(header, TRACE_MAGIC, 8) != 0)
+        fail("not a Z16 binary trace");
+    if (traceGet16(&header[8]) != TRACE_VERSION)
+        fail("unsupported trace version");
+
+    unsigned char footer[TRACE_FOOTER_BYTES];
+    if (fseek(fp, -TRACE_FOOTER_BYTES, SEEK_END) != 0 ||
+        fread(footer, 1, TRACE_FOOTER_BYTES, fp) != TRACE_FOOTER_BYTES ||
+        traceGet32(&footer[12]) != TRACE_INDEX_MAGIC)
+        fail("trace index missing (simulator did not finish writing the trace)");
+    uint64_t indexOffset = traceGet64(&footer[0]);
+    uint32_t chunkCount = traceGet32(&footer[8]);
+
+    IndexEntry *index = (IndexEntry *)malloc((chunkCount ? chunkCount : 1) * sizeof(IndexEntry));
+    if (!index) { perror("malloc"); exit(1); }
+    fseek(fp, (long)indexOffset, SEEK_SET);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        unsigned char entry[16];
+        if (fread(entry, 1, sizeof(entry), fp) != sizeof(entry))
+            fail("truncated trace index");
+        index[i].firstIndex = traceGet64(&entry[0]);
+        index[i].offset = traceGet64(&entry[8]);
+    }
+
+    uint32_t firstChunk = (chunkCount && seek) ? findChunk(index, chunkCount, seek) : 0;
+    unsigned char *payload = NULL;
+    size_t payloadCapacity = 0;
+    uint64_t printed = 0, decoded = 0, instructions = 0;
+    char line[256], where[96];
+
+    for (uint32_t ci = firstChunk; ci < chunkCount && printed < count; ci++) {
+        unsigned char ch[TRACE_CHUNK_HEADER_BYTES];
+        fseek(fp, (long)index[ci].offset, SEEK_SET);
+        if (fread(ch, 1, sizeof(ch), fp) != sizeof(ch) || traceGet32(&ch[0]) != TRACE_CHUNK_MAGIC)
+            fail("corrupt chunk header");
+        uint32_t records = traceGet32(&ch[4]);
+        uint32_t bytes = traceGet32(&ch[8]);
+        uint64_t insnIndex = traceGet64(&ch[12]);
+        uint16_t pc = traceGet16(&ch[20]);
+        uint16_t regs[8];
+        for (int r = 0; r < 8; r++)
+            regs[r] = traceGet16(&ch[22 + 2 * r]);
+        uint16_t memAddr = 0;
+        if (bytes > payloadCapacity) {
+            payloadCapacity = bytes;
+            payload = (unsigned char *)realloc(payload, payloadCapacity);
+            if (!payload) { perror("realloc"); exit(1); }
+        }
+        if (fread(payload, 1, bytes, fp) != bytes)
+            fail("truncated chunk payload");
+
+        const unsigned char *p = payload, *end = payload + bytes;
+        for (uint32_t rec = 0; rec < records && printed < count; rec++) {
+            uint64_t v;
+            size_t n;
+            if (p >= end) fail("corrupt record");
+            unsigned char tag = *p++;
+
+            pc = (uint16_t)(pc + 2);
+            if (tag & TAG_PC_JUMP) {
+                if (!(n = traceGetVarint(p, end, &v))) fail("corrupt record");
+                p += n;
+                pc = (uint16_t)(pc + traceUnzigzag(v));
+            }
+            uint32_t slot = pc >> 1;
+            if (tag & TAG_INST) {
+                if (p + 2 > end) fail("corrupt record");
+                lastInst[slot] = traceGet16(p);
+                lastInstChunk[slot] = ci + 1;
+                p += 2;
+            } else if (lastInstChunk[slot] != ci + 1) {
+                fail("record refers to an instruction word not in its chunk");
+            }
+            uint64_t retired = 1;
+            if (tag & TAG_GAP) {
+                if (!(n = traceGetVarint(p, end, &v))) fail("corrupt record");
+                p += n;
+                retired += v;
+            }
+
+            int show = insnIndex >= seek && pc >= pcLo && pc <= pcHi && !summaryOnly;
+            int len = 0;
+            if (show)
+                len = snprintf(line, sizeof(line), "#%-10llu 0x%04X  %04X ",
+                               (unsigned long long)insnIndex, pc, lastInst[slot]);
+
+            int regField = (tag & TAG_REG_COUNT) >> TAG_REG_SHIFT;
+            uint8_t mask = 0;
+            int explicitRegs = 0;
+            if (regField == TAG_REG_MASK) {
+                if (p >= end) fail("corrupt record");
+                mask = *p++;
+            } else {
+                explicitRegs = regField;
+            }
+            for (int k = 0; k < 8; k++) {
+                int r;
+                if (explicitRegs) {
+                    if (k >= explicitRegs) break;
+                    if (p >= end) fail("corrupt record");
+                    r = *p++ & 0x7;
+                } else {
+                    if (!((mask >> k) & 1)) continue;
+                    r = k;
+                }
+                if (!(n = traceGetVarint(p, end, &v))) fail("corrupt record");
+                p += n;
+                regs[r] = (uint16_t)(regs[r] + traceUnzigzag(v));
+                if (show && len < (int)sizeof(line))
+                    len += snprintf(line + len, sizeof(line) - len, " %s=0x%04X", regNames[r], regs[r]);
+            }
+
+            if (tag & TAG_MEM) {
+                uint64_t writes;
+                if (!(n = traceGetVarint(p, end, &writes))) fail("corrupt record");
+                p += n;
+                for (uint64_t w = 0; w < writes; w++) {
+                    uint64_t size;
+                    if (!(n = traceGetVarint(p, end, &v))) fail("corrupt record");
+                    p += n;
+                    memAddr = (uint16_t)(memAddr + traceUnzigzag(v));
+                    if (!(n = traceGetVarint(p, end, &size))) fail("corrupt record");
+                    p += n;
+                    if (p + size > end) fail("corrupt record");
+                    if (show && len < (int)sizeof(line)) {
+                        len += snprintf(line + len, sizeof(line) - len, " [0x%04X]=", memAddr);
+                        for (uint64_t b = 0; b < size && b < 8 && len < (int)sizeof(line); b++)
+                            len += snprintf(line + len, sizeof(line) - len, "%02X", p[b]);
+                        if (size > 8 && len < (int)sizeof(line))
+                            len += snprintf(line + len, sizeof(line) - len, "..(%llu bytes)",
+                                            (unsigned long long)size);
+                    }
+                    p += size;
+                }
+            }
+
+            if (show) {
+                if (debugInfoLoaded() && len < (int)sizeof(line))
+                    snprintf(line + len, sizeof(line) - len, "  ; %s", debugLocation(pc, where, sizeof(where)));
+                puts(line);
+                printed++;
+            }
+            decoded++;
+            instructions += retired;
+            insnIndex += retired;
+        }
+    }
+
+    if (summaryOnly) {
+        fseek(fp, 0, SEEK_END);
+        printf("Trace %s: %u chunks, %llu records, %llu instructions from index %llu, %ld bytes\n",
+               filename, chunkCount, (unsigned long long)decoded, (unsigned long long)instructions,
+               (unsigned long long)(chunkCount ? index[firstChunk].firstIndex : 0), ftell(fp));
+    }
+    free(payload);
+    free(index);
+    debugInfoClose();
+    fclose(fp);
+    return 0;
+}
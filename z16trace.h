@@ -0,0 +1,128 @@
+/*
+ * Z16 binary execution trace format (.z16t), shared by the simulator's trace
+ * writer and the z16trace decoder.
+ *
+ * All integers are little-endian.
+ *
+ *   File header (16 bytes)
+ *     "Z16TRACE"         magic
+ *     u16 version        TRACE_VERSION
+ *     u16 reserved
+ *     u32 chunkBytes     payload capacity the writer used
+ *
+ *   Chunk (repeated)
+ *     u32 magic          TRACE_CHUNK_MAGIC
+ *     u32 records        number of records in the payload
+ *     u32 payloadBytes
+ *     u64 firstIndex     instruction index of the first record
+ *     u16 basePc         pc the first record's delta is taken against
+ *     u16 regs[8]        register file before the first record
+ *     payload
+ *
+ *   Index (at indexOffset): chunkCount x { u64 firstIndex, u64 fileOffset }
+ *   Footer (last 16 bytes): u64 indexOffset, u32 chunkCount, u32 TRACE_INDEX_MAGIC
+ *
+ * Every chunk restarts the delta state, so a reader can start decoding at
+ * any chunk found through the index.
+ *
+ * Record layout: a tag byte followed by the fields its bits select.
+ *   TAG_PC_JUMP     zigzag varint: pc - (previous pc + 2); absent when the
+ *                   record follows sequentially
+ *   TAG_INST        u16 instruction word; absent when it equals the word last
+ *                   recorded for this pc in the current chunk
+ *   TAG_GAP         varint: instructions retired beyond 1 (bulk operations
+ *                   that are charged as several instructions)
+ *   TAG_REG_COUNT   2-bit field for changed registers. 1 or 2: that many
+ *                   entries of a register-number byte and a zigzag varint
+ *                   delta from the register's previous value. 3: a byte mask
+ *                   of changed registers followed by one delta per set bit
+ *   TAG_MEM         varint count of memory writes; each is a zigzag varint
+ *                   address delta from the previous write's address, a varint
+ *                   length and the written bytes
+ */
+#ifndef Z16TRACE_H
+#define Z16TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRACE_MAGIC         "Z16TRACE"
+#define TRACE_VERSION       1
+#define TRACE_HEADER_BYTES  16
+#define TRACE_CHUNK_MAGIC   0x4B4E4843u // "CHNK"
+#define TRACE_CHUNK_HEADER_BYTES 38
+#define TRACE_INDEX_MAGIC   0x58444E49u // "INDX"
+#define TRACE_FOOTER_BYTES  16
+
+#define TAG_PC_JUMP   0x01
+#define TAG_INST      0x02
+#define TAG_GAP       0x04
+#define TAG_MEM       0x08
+#define TAG_REG_SHIFT 4
+#define TAG_REG_COUNT 0x30
+#define TAG_REG_MASK  3      // TAG_REG_COUNT value meaning "mask byte follows"
+
+static inline size_t tracePutVarint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+static inline size_t traceGetVarint(const unsigned char *p, const unsigned char *end, uint64_t *v) {
+    uint64_t result = 0;
+    size_t n = 0;
+    int shift = 0;
+    while (p + n < end && shift < 64) {
+        unsigned char b = p[n++];
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return n;
+        }
+        shift += 7;
+    }
+    return 0; // truncated
+}
+
+static inline uint64_t traceZigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t traceUnzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline void tracePut16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline void tracePut32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline void tracePut64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static inline uint16_t traceGet16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t traceGet32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t traceGet64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+#endif // Z16TRACE_H
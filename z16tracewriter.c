@@ -0,0 +1,296 @@
+/*
+ * Binary execution trace writer for the Z16 simulator (format: z16trace.h).
+ *
+ * TRACE_BUFFERS chunk buffers form a ring. The simulating thread encodes
+ * records into the current buffer; when it is full the buffer is handed to
+ * the writer thread and encoding continues in the next one. The writer
+ * appends each chunk to the file and remembers its offset for the sparse
+ * index written by traceClose().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "z16sim.h"
+#include "z16trace.h"
+#include "z16tracewriter.h"
+
+#define TRACE_BUFFERS 4
+#define TRACE_CHUNK_BYTES (256 * 1024)
+#define MAX_PENDING_WRITES 8
+// Worst case for one record on top of a full chunk: tag, pc, inst, gap,
+// register mask and deltas, and every pending write (bytes capped at MEM_SIZE).
+#define RECORD_SLACK (64 + MAX_PENDING_WRITES * 24 + MEM_SIZE)
+
+typedef struct {
+    unsigned char header[TRACE_CHUNK_HEADER_BYTES];
+    unsigned char *data;
+    size_t used;
+    uint32_t records;
+    int full;           // handed to the writer, not yet written
+} Chunk;
+
+typedef struct {
+    uint64_t firstIndex;
+    uint64_t offset;
+} IndexEntry;
+
+static FILE *traceFile = NULL;
+static Chunk chunks[TRACE_BUFFERS];
+static int fillIndex = 0;    // chunk the simulator encodes into
+static int writeIndex = 0;   // next chunk the writer thread expects
+static int closing = 0;
+static pthread_t writerThread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static IndexEntry *chunkIndex = NULL;  // owned by the writer thread until join
+static uint32_t indexCount = 0;
+static uint32_t indexCapacity = 0;
+static uint64_t fileOffset = 0;
+static int writeFailed = 0;
+
+// Delta state of the chunk being encoded (simulator thread only)
+static uint64_t nextIndex = 0;     // instruction index of the next record
+static uint16_t prevPc = 0;
+static uint16_t prevRegs[8];
+static uint16_t prevMemAddr = 0;
+static uint16_t lastInst[MEM_SIZE / 2];
+static uint32_t lastInstChunk[MEM_SIZE / 2]; // chunkSerial that recorded lastInst
+static uint32_t chunkSerial = 0;
+
+static uint16_t pendingAddr[MAX_PENDING_WRITES];
+static uint32_t pendingSize[MAX_PENDING_WRITES];
+static int pendingCount = 0;
+
+static uint64_t recordsWritten = 0;
+static uint64_t bytesEncoded = 0;
+static uint64_t producerWaits = 0;
+
+static void *writerMain(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (!chunks[writeIndex].full && !closing)
+            pthread_cond_wait(&cond, &lock);
+        if (!chunks[writeIndex].full) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        Chunk *c = &chunks[writeIndex];
+        pthread_mutex_unlock(&lock);
+
+        if (indexCount == indexCapacity) {
+            indexCapacity = indexCapacity ? indexCapacity * 2 : 64;
+            chunkIndex = (IndexEntry *)realloc(chunkIndex, indexCapacity * sizeof(IndexEntry));
+            if (!chunkIndex) { perror("realloc"); exit(1); }
+        }
+        chunkIndex[indexCount].firstIndex = traceGet64(&c->header[12]);
+        chunkIndex[indexCount].offset = fileOffset;
+        indexCount++;
+        if (fwrite(c->header, 1, TRACE_CHUNK_HEADER_BYTES, traceFile) != TRACE_CHUNK_HEADER_BYTES ||
+            fwrite(c->data, 1, c->used, traceFile) != c->used)
+            writeFailed = 1;
+        fileOffset += TRACE_CHUNK_HEADER_BYTES + c->used;
+
+        pthread_mutex_lock(&lock);
+        c->full = 0;
+        writeIndex = (writeIndex + 1) % TRACE_BUFFERS;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+// Start a new chunk in the current fill buffer with a fresh delta base:
+// the first record at `firstPc` sees `baseRegs` as the previous state.
+static void beginChunk(uint16_t firstPc, const uint16_t *baseRegs) {
+    Chunk *c = &chunks[fillIndex];
+    c->used = 0;
+    c->records = 0;
+    chunkSerial++;
+    prevPc = (uint16_t)(firstPc - 2);
+    prevMemAddr = 0;
+    memcpy(prevRegs, baseRegs, sizeof(prevRegs));
+    tracePut64(&c->header[12], nextIndex);
+    tracePut16(&c->header[20], prevPc);
+    for (int r = 0; r < 8; r++)
+        tracePut16(&c->header[22 + 2 * r], prevRegs[r]);
+}
+
+static void submitChunk(void) {
+    Chunk *c = &chunks[fillIndex];
+    tracePut32(&c->header[0], TRACE_CHUNK_MAGIC);
+    tracePut32(&c->header[4], c->records);
+    tracePut32(&c->header[8], (uint32_t)c->used);
+    pthread_mutex_lock(&lock);
+    c->full = 1;
+    pthread_cond_broadcast(&cond);
+    fillIndex = (fillIndex + 1) % TRACE_BUFFERS;
+    if (chunks[fillIndex].full) {
+        producerWaits++;
+        while (chunks[fillIndex].full)
+            pthread_cond_wait(&cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+int traceOpen(const char *filename) {
+    traceFile = fopen(filename, "wb");
+    if (!traceFile) {
+        perror("Error opening trace file");
+        return -1;
+    }
+    unsigned char header[TRACE_HEADER_BYTES];
+    memcpy(header, TRACE_MAGIC, 8);
+    tracePut16(&header[8], TRACE_VERSION);
+    tracePut16(&header[10], 0);
+    tracePut32(&header[12], TRACE_CHUNK_BYTES);
+    fwrite(header, 1, TRACE_HEADER_BYTES, traceFile);
+    fileOffset = TRACE_HEADER_BYTES;
+
+    for (int i = 0; i < TRACE_BUFFERS; i++) {
+        chunks[i].data = (unsigned char *)malloc(TRACE_CHUNK_BYTES + RECORD_SLACK);
+        if (!chunks[i].data) { perror("malloc"); exit(1); }
+        chunks[i].full = 0;
+    }
+    fillIndex = writeIndex = 0;
+    closing = 0;
+    beginChunk(pc, regs);
+    if (pthread_create(&writerThread, NULL, writerMain, NULL) != 0) {
+        fprintf(stderr, "Error: cannot start trace writer thread\n");
+        return -1;
+    }
+    return 0;
+}
+
+void traceMemWrite(uint16_t addr, int size) {
+    if (pendingCount < MAX_PENDING_WRITES) {
+        pendingAddr[pendingCount] = addr;
+        pendingSize[pendingCount] = (uint32_t)size;
+        pendingCount++;
+    } else {
+        // Too many ranges for one record: fold them into a whole-memory write.
+        pendingAddr[0] = 0;
+        pendingSize[0] = MEM_SIZE;
+        pendingCount = 1;
+    }
+}
+
+void traceRecord(uint16_t instPc, uint16_t inst, const uint16_t *regsBefore, uint64_t retired) {
+    Chunk *c = &chunks[fillIndex];
+    if (c->used >= TRACE_CHUNK_BYTES) {
+        submitChunk();
+        beginChunk(instPc, regsBefore);
+        c = &chunks[fillIndex];
+    }
+
+    unsigned char *start = c->data + c->used;
+    unsigned char *p = start + 1;
+    unsigned char tag = 0;
+
+    if (instPc != (uint16_t)(prevPc + 2)) {
+        tag |= TAG_PC_JUMP;
+        p += tracePutVarint(p, traceZigzag((int16_t)(uint16_t)(instPc - (uint16_t)(prevPc + 2))));
+    }
+    uint32_t slot = instPc >> 1;
+    if (lastInstChunk[slot] != chunkSerial || lastInst[slot] != inst) {
+        tag |= TAG_INST;
+        tracePut16(p, inst);
+        p += 2;
+        lastInst[slot] = inst;
+        lastInstChunk[slot] = chunkSerial;
+    }
+    if (retired > 1) {
+        tag |= TAG_GAP;
+        p += tracePutVarint(p, retired - 1);
+    }
+
+    uint8_t changed = 0;
+    int changedCount = 0;
+    for (int r = 0; r < 8; r++) {
+        if (regs[r] != prevRegs[r]) {
+            changed |= (uint8_t)(1 << r);
+            changedCount++;
+        }
+    }
+    if (changedCount > 0) {
+        if (changedCount <= 2) {
+            tag |= (unsigned char)(changedCount << TAG_REG_SHIFT);
+        } else {
+            tag |= (unsigned char)(TAG_REG_MASK << TAG_REG_SHIFT);
+            *p++ = changed;
+        }
+        for (int r = 0; r < 8; r++) {
+            if (!((changed >> r) & 1))
+                continue;
+            if (changedCount <= 2)
+                *p++ = (unsigned char)r;
+            p += tracePutVarint(p, traceZigzag((int16_t)(uint16_t)(regs[r] - prevRegs[r])));
+            prevRegs[r] = regs[r];
+        }
+    }
+
+    if (pendingCount > 0) {
+        tag |= TAG_MEM;
+        p += tracePutVarint(p, (uint64_t)pendingCount);
+        for (int i = 0; i < pendingCount; i++) {
+            p += tracePutVarint(p, traceZigzag((int16_t)(uint16_t)(pendingAddr[i] - prevMemAddr)));
+            p += tracePutVarint(p, pendingSize[i]);
+            for (uint32_t b = 0; b < pendingSize[i]; b++)
+                *p++ = memory[(uint16_t)(pendingAddr[i] + b)];
+            prevMemAddr = pendingAddr[i];
+        }
+        pendingCount = 0;
+    }
+
+    *start = tag;
+    c->used = (size_t)(p - c->data);
+    c->records++;
+    prevPc = instPc;
+    nextIndex += retired;
+    recordsWritten++;
+    bytesEncoded += (uint64_t)(p - start);
+}
+
+void traceClose(void) {
+    if (!traceFile)
+        return;
+    if (chunks[fillIndex].records > 0)
+        submitChunk();
+    pthread_mutex_lock(&lock);
+    closing = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writerThread, NULL);
+
+    uint64_t indexOffset = fileOffset;
+    unsigned char entry[16];
+    for (uint32_t i = 0; i < indexCount; i++) {
+        tracePut64(&entry[0], chunkIndex[i].firstIndex);
+        tracePut64(&entry[8], chunkIndex[i].offset);
+        fwrite(entry, 1, sizeof(entry), traceFile);
+    }
+    unsigned char footer[TRACE_FOOTER_BYTES];
+    tracePut64(&footer[0], indexOffset);
+    tracePut32(&footer[8], indexCount);
+    tracePut32(&footer[12], TRACE_INDEX_MAGIC);
+    fwrite(footer, 1, TRACE_FOOTER_BYTES, traceFile);
+    if (fclose(traceFile) != 0 || writeFailed)
+        fprintf(stderr, "Error: writing the binary trace failed\n");
+
+    fprintf(stderr, "Binary trace: %llu records, %llu bytes (%.2f bytes/instruction), %u chunks",
+            (unsigned long long)recordsWritten, (unsigned long long)bytesEncoded,
+            recordsWritten ? (double)bytesEncoded / recordsWritten : 0.0, indexCount);
+    if (producerWaits)
+        fprintf(stderr, ", simulator waited for the writer %llu times", (unsigned long long)producerWaits);
+    fprintf(stderr, "\n");
+
+    for (int i = 0; i < TRACE_BUFFERS; i++)
+        free(chunks[i].data);
+    free(chunkIndex);
+    chunkIndex = NULL;
+    traceFile = NULL;
+}
@@ -0,0 +1,26 @@
+/*
+ * Binary execution trace writer for the Z16 simulator (format: z16trace.h).
+ *
+ * The simulating thread encodes records into chunk buffers; a background
+ * thread writes full chunks to the file, so the interpreter only touches a
+ * lock once per chunk and never waits on I/O unless every buffer is full.
+ */
+#ifndef Z16TRACEWRITER_H
+#define Z16TRACEWRITER_H
+
+#include <stdint.h>
+
+// Open the trace file and start the writer thread. Returns 0 on success.
+int traceOpen(const char *filename);
+
+// Note a memory write made by the instruction being executed.
+void traceMemWrite(uint16_t addr, int size);
+
+// Encode the instruction just executed; `regsBefore` is the register file
+// before it ran and `retired` the number of instructions it counts as.
+void traceRecord(uint16_t instPc, uint16_t inst, const uint16_t *regsBefore, uint64_t retired);
+
+// Flush the last chunk, write the index and footer, and stop the thread.
+void traceClose(void);
+
+#endif // Z16TRACEWRITER_H